@@ -228,6 +228,49 @@ static int turn_it_to_11(cls_method_context_t hctx, bufferlist *in, bufferlist *
   return 0;
 }
 
+/**
+ * look up several omap keys at once
+ *
+ * Takes an encoded set<string> of keys and returns an encoded
+ * map<string,bufferlist> of those that exist.  All of them are read
+ * with a single omap lookup.
+ */
+static int get_keys(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  set<string> keys;
+  try {
+    bufferlist::iterator p = in->begin();
+    ::decode(keys, p);
+  } catch (buffer::error& e) {
+    return -EINVAL;
+  }
+
+  map<string, bufferlist> vals;
+  int r = cls_cxx_map_get_vals_by_keys(hctx, keys, &vals);
+  if (r < 0)
+    return r;
+  ::encode(vals, *out);
+  return 0;
+}
+
+/**
+ * remove several omap keys at once
+ *
+ * Takes an encoded set<string>.  Keys that do not exist are ignored.
+ */
+static int remove_keys(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  set<string> keys;
+  try {
+    bufferlist::iterator p = in->begin();
+    ::decode(keys, p);
+  } catch (buffer::error& e) {
+    return -EINVAL;
+  }
+
+  return cls_cxx_map_remove_keys(hctx, keys);
+}
+
 /**
  * example method that does not behave
  *
@@ -301,6 +344,8 @@ CLS_INIT(hello)
   cls_method_handle_t h_replay;
   cls_method_handle_t h_writes_dont_return_data;
   cls_method_handle_t h_turn_it_to_11;
+  cls_method_handle_t h_get_keys;
+  cls_method_handle_t h_remove_keys;
   cls_method_handle_t h_bad_reader;
   cls_method_handle_t h_bad_writer;
 
@@ -333,6 +378,14 @@ CLS_INIT(hello)
 			  CLS_METHOD_RD | CLS_METHOD_WR | CLS_METHOD_PROMOTE,
 			  turn_it_to_11, &h_turn_it_to_11);
 
+  // omap, several keys at a time
+  cls_register_cxx_method(h_class, "get_keys",
+			  CLS_METHOD_RD,
+			  get_keys, &h_get_keys);
+  cls_register_cxx_method(h_class, "remove_keys",
+			  CLS_METHOD_WR,
+			  remove_keys, &h_remove_keys);
+
   // counter-examples
   cls_register_cxx_method(h_class, "bad_reader", CLS_METHOD_WR,
 			  bad_reader, &h_bad_reader);
@@ -909,6 +909,7 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
   }
 
   list<cls_rgw_obj_key>::iterator remove_iter;
+  set<string> remove_idx;
   CLS_LOG(20, "rgw_bucket_complete_op(): remove_objs.size()=%d\n", (int)op.remove_objs.size());
   for (remove_iter = op.remove_objs.begin(); remove_iter != op.remove_objs.end(); ++remove_iter) {
     cls_rgw_obj_key& remove_key = *remove_iter;
@@ -933,10 +934,13 @@ int rgw_bucket_complete_op(cls_method_context_t hctx, bufferlist *in, bufferlist
         continue;
     }
 
-    ret = cls_cxx_map_remove_key(hctx, k);
+    remove_idx.insert(k);
+  }
+
+  if (!remove_idx.empty()) {
+    int ret = cls_cxx_map_remove_keys(hctx, remove_idx);
     if (ret < 0) {
-      CLS_LOG(1, "rgw_bucket_complete_op(): cls_cxx_map_remove_key, failed to remove entry, name=%s instance=%s read_index_entry ret=%d\n", remove_key.name.c_str(), remove_key.instance.c_str(), rc);
-      continue;
+      CLS_LOG(1, "rgw_bucket_complete_op(): cls_cxx_map_remove_keys, failed to remove %d entries ret=%d\n", (int)remove_idx.size(), ret);
     }
   }
 
@@ -1872,24 +1876,50 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
 
   bufferlist::iterator in_iter = in->begin();
 
-  while (!in_iter.end()) {
+  // decode all the changes up front so that the entries they refer to
+  // can be read with a single omap lookup
+  struct suggested_change {
     __u8 op;
-    rgw_bucket_dir_entry cur_change;
-    rgw_bucket_dir_entry cur_disk;
+    rgw_bucket_dir_entry entry;
+    string key;
+  };
+  list<suggested_change> changes;
+  set<string> change_keys;
+  while (!in_iter.end()) {
+    changes.push_back(suggested_change());
+    suggested_change& c = changes.back();
     try {
-      ::decode(op, in_iter);
-      ::decode(cur_change, in_iter);
+      ::decode(c.op, in_iter);
+      ::decode(c.entry, in_iter);
     } catch (buffer::error& err) {
       CLS_LOG(1, "ERROR: rgw_dir_suggest_changes(): failed to decode request\n");
       return -EINVAL;
     }
+    encode_obj_index_key(c.entry.key, &c.key);
+    change_keys.insert(c.key);
+  }
+
+  map<string, bufferlist> disk_entries;
+  int ret = cls_cxx_map_get_vals_by_keys(hctx, change_keys, &disk_entries);
+  if (ret < 0)
+    return -EINVAL;
+
+  // index updates, applied together once every change is processed; a
+  // later change to the same key supersedes an earlier one, and sees the
+  // entry as the earlier one left it in disk_entries
+  set<string> keys_to_remove;
+  map<string, bufferlist> keys_to_set;
+
+  for (auto& c : changes) {
+    __u8 op = c.op;
+    rgw_bucket_dir_entry& cur_change = c.entry;
+    rgw_bucket_dir_entry cur_disk;
+    const string& cur_change_key = c.key;
 
     bufferlist cur_disk_bl;
-    string cur_change_key;
-    encode_obj_index_key(cur_change.key, &cur_change_key);
-    int ret = cls_cxx_map_get_val(hctx, cur_change_key, &cur_disk_bl);
-    if (ret < 0 && ret != -ENOENT)
-      return -EINVAL;
+    auto disk_iter = disk_entries.find(cur_change_key);
+    if (disk_iter != disk_entries.end())
+      cur_disk_bl = disk_iter->second;
 
     if (cur_disk_bl.length()) {
       bufferlist::iterator cur_disk_iter = cur_disk_bl.begin();
@@ -1932,9 +1962,9 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
       switch(op) {
       case CEPH_RGW_REMOVE:
         CLS_LOG(10, "CEPH_RGW_REMOVE name=%s instance=%s\n", cur_change.key.name.c_str(), cur_change.key.instance.c_str());
-	ret = cls_cxx_map_remove_key(hctx, cur_change_key);
-	if (ret < 0)
-	  return ret;
+        keys_to_set.erase(cur_change_key);
+        keys_to_remove.insert(cur_change_key);
+        disk_entries.erase(cur_change_key);
         if (log_op && cur_disk.exists) {
           ret = log_index_operation(hctx, cur_disk.key, CLS_RGW_OP_DEL, cur_disk.tag, cur_disk.meta.mtime,
                                     cur_disk.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, 0, NULL, NULL);
@@ -1953,11 +1983,10 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
         stats.actual_size += cur_change.meta.size;
         header_changed = true;
         cur_change.index_ver = header.ver;
-        bufferlist cur_state_bl;
-        ::encode(cur_change, cur_state_bl);
-        ret = cls_cxx_map_set_val(hctx, cur_change_key, &cur_state_bl);
-        if (ret < 0)
-	  return ret;
+        keys_to_remove.erase(cur_change_key);
+        keys_to_set[cur_change_key].clear();
+        ::encode(cur_change, keys_to_set[cur_change_key]);
+        disk_entries[cur_change_key] = keys_to_set[cur_change_key];
         if (log_op) {
           ret = log_index_operation(hctx, cur_change.key, CLS_RGW_OP_ADD, cur_change.tag, cur_change.meta.mtime,
                                     cur_change.ver, CLS_RGW_STATE_COMPLETE, header.ver, header.max_marker, 0, NULL, NULL);
@@ -1972,6 +2001,17 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
 
   }
 
+  if (!keys_to_remove.empty()) {
+    ret = cls_cxx_map_remove_keys(hctx, keys_to_remove);
+    if (ret < 0)
+      return ret;
+  }
+  if (!keys_to_set.empty()) {
+    ret = cls_cxx_map_set_vals(hctx, &keys_to_set);
+    if (ret < 0)
+      return ret;
+  }
+
   if (header_changed) {
     return write_bucket_header(hctx, &header);
   }
@@ -0,0 +1,88 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMMON_MPSCINBOX_H
+#define CEPH_COMMON_MPSCINBOX_H
+
+#include <atomic>
+#include <utility>
+
+/**
+ * Lock-free multi-producer, single-consumer inbox.
+ *
+ * Producers push with a single compare-and-swap.  The consumer takes
+ * everything that has been pushed so far at once and gets it back in
+ * push order (as seen per producer), so a producer's items are never
+ * reordered with respect to each other.
+ *
+ * Only one thread may call take_all() at a time; callers that share
+ * the consumer side must serialize it themselves.  push() and empty()
+ * are sequentially consistent, so a consumer that publishes "I am going
+ * to sleep" and then checks empty() cannot miss a producer that pushes
+ * and then checks for a sleeping consumer.
+ */
+template <typename T>
+class MPSCInbox {
+  struct Node {
+    T item;
+    Node *next;
+    Node(T&& i) : item(std::move(i)), next(nullptr) {}
+  };
+  std::atomic<Node*> head;
+
+public:
+  MPSCInbox() : head(nullptr) {}
+  MPSCInbox(const MPSCInbox&) = delete;
+  MPSCInbox& operator=(const MPSCInbox&) = delete;
+  ~MPSCInbox() {
+    take_all([](T&&) {});
+  }
+
+  /// @return true if the inbox was empty before this push
+  bool push(T item) {
+    Node *n = new Node(std::move(item));
+    Node *old = head.load(std::memory_order_relaxed);
+    do {
+      n->next = old;
+    } while (!head.compare_exchange_weak(old, n));
+    return old == nullptr;
+  }
+
+  bool empty() const {
+    return head.load() == nullptr;
+  }
+
+  /// hand every queued item to f, oldest first; @return number of items
+  template <typename F>
+  unsigned take_all(F&& f) {
+    Node *n = head.exchange(nullptr, std::memory_order_acquire);
+    // the stack is newest first; reverse it
+    Node *fifo = nullptr;
+    while (n) {
+      Node *next = n->next;
+      n->next = fifo;
+      fifo = n;
+      n = next;
+    }
+    unsigned count = 0;
+    while (fifo) {
+      Node *next = fifo->next;
+      f(std::move(fifo->item));
+      delete fifo;
+      fifo = next;
+      ++count;
+    }
+    return count;
+  }
+};
+
+#endif
@@ -52,6 +52,9 @@ class OpQueue {
     virtual void enqueue_front(K cl, unsigned priority, unsigned cost, T item) = 0;
     // Returns if the queue is empty
     virtual bool empty() const = 0;
+    // Seconds until an op can be dequeued without exceeding a rate
+    // limit; queues that don't enforce limits are always ready
+    virtual double ready_in() const { return 0; }
     // Return an op to be dispatch
     virtual T dequeue() = 0;
     // Formatted output of the queue
@@ -31,6 +31,17 @@ enum {
   l_throttle_last,
 };
 
+enum {
+  l_adaptive_throttle_first = 532460,
+  l_adaptive_throttle_scale,
+  l_adaptive_throttle_lat,
+  l_adaptive_throttle_samples,
+  l_adaptive_throttle_grow,
+  l_adaptive_throttle_shrink,
+  l_adaptive_throttle_hold,
+  l_adaptive_throttle_last,
+};
+
 Throttle::Throttle(CephContext *cct, const std::string& n, int64_t m, bool _use_perf)
   : cct(cct), name(n), logger(NULL),
     max(m),
@@ -435,6 +446,93 @@ uint64_t BackoffThrottle::get_max()
   return max;
 }
 
+AdaptiveThrottle::AdaptiveThrottle(CephContext *cct, const std::string& n,
+				   double target_latency, double tolerance,
+				   double min_scale)
+  : cct(cct), name(n), target(target_latency), tolerance(tolerance),
+    min_scale(min_scale)
+{
+  assert(target > 0);
+  assert(min_scale > 0 && min_scale <= 1.0);
+
+  PerfCountersBuilder b(cct, string("adaptive-throttle-") + name,
+			l_adaptive_throttle_first, l_adaptive_throttle_last);
+  b.add_u64(l_adaptive_throttle_scale, "scale",
+	    "Current fraction of the configured max, in thousandths");
+  b.add_time_avg(l_adaptive_throttle_lat, "lat",
+		 "Observed latency behind the throttle");
+  b.add_u64_counter(l_adaptive_throttle_samples, "samples",
+		    "Latency samples");
+  b.add_u64_counter(l_adaptive_throttle_grow, "grow",
+		    "Updates that raised the admission limit");
+  b.add_u64_counter(l_adaptive_throttle_shrink, "shrink",
+		    "Updates that lowered the admission limit");
+  b.add_u64_counter(l_adaptive_throttle_hold, "hold",
+		    "Updates that kept the admission limit");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+  logger->set(l_adaptive_throttle_scale, 1000);
+}
+
+AdaptiveThrottle::~AdaptiveThrottle()
+{
+  // leave the throttles the way we found them
+  scale = 1.0;
+  _apply();
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+}
+
+void AdaptiveThrottle::add_throttle(Throttle *t)
+{
+  if (!t->get_max())
+    return;  // unlimited, nothing to adapt
+  throttles.push_back(throttle_t{t, t->get_max()});
+  _apply();
+}
+
+void AdaptiveThrottle::_apply()
+{
+  for (auto& t : throttles) {
+    int64_t m = std::max<int64_t>(1, t.configured_max * scale);
+    t.throttle->reset_max(m);
+  }
+}
+
+void AdaptiveThrottle::update()
+{
+  uint64_t count = sample_count.exchange(0);
+  uint64_t sum = sample_sum_ns.exchange(0);
+  utime_t lat;
+  if (count) {
+    lat.set_from_double((double)sum / count / 1000000000.0);
+    logger->tinc(l_adaptive_throttle_lat, lat);
+    logger->inc(l_adaptive_throttle_samples, count);
+  } else if (!grow_when_idle) {
+    return;  // idle, nothing to learn from
+  }
+
+  double l = lat;
+  double old = scale;
+  if (l > target * (1.0 + tolerance)) {
+    scale = std::max(min_scale, scale * backoff);
+    if (scale != old)
+      logger->inc(l_adaptive_throttle_shrink);
+  } else if (l < target * (1.0 - tolerance)) {
+    scale = std::min(1.0, scale + step);
+    if (scale != old)
+      logger->inc(l_adaptive_throttle_grow);
+  }
+  if (scale == old) {
+    logger->inc(l_adaptive_throttle_hold);
+    return;
+  }
+  ldout(cct, 10) << __func__ << " lat " << lat << " target " << target
+		 << " scale " << old << " -> " << scale << dendl;
+  logger->set(l_adaptive_throttle_scale, scale * 1000);
+  _apply();
+}
+
 SimpleThrottle::SimpleThrottle(uint64_t max, bool ignore_enoent)
   : m_lock("SimpleThrottle"),
     m_max(max),
@@ -8,11 +8,14 @@
 #include "Cond.h"
 #include <list>
 #include <map>
+#include <vector>
 #include <iostream>
 #include <condition_variable>
 #include <chrono>
+#include <atomic>
 #include "include/atomic.h"
 #include "include/Context.h"
+#include "include/utime.h"
 
 class CephContext;
 class PerfCounters;
@@ -219,6 +222,72 @@ public:
 };
 
 
+/**
+ * AdaptiveThrottle
+ *
+ * Adjusts the max of one or more Throttles from latency feedback instead
+ * of leaving them at a static value.  Callers report the latency observed
+ * downstream of the throttle (e.g. time spent in the op queue) with
+ * add_sample(), and call update() periodically.  Each update compares the
+ * mean latency of the last interval with the target:
+ *
+ * above target * (1 + tolerance): scale = max(min_scale, scale * backoff)
+ * below target * (1 - tolerance): scale = min(1, scale + step)
+ * otherwise:                      scale unchanged
+ *
+ * and sets each throttle's max to configured_max * scale.  This is
+ * additive increase, multiplicative decrease, the same shape TCP uses to
+ * find the knee of a queue without oscillating around it.
+ */
+class AdaptiveThrottle {
+  CephContext *cct;
+  const std::string name;
+  PerfCounters *logger = nullptr;
+
+  struct throttle_t {
+    Throttle *throttle;
+    int64_t configured_max;
+  };
+  std::vector<throttle_t> throttles;
+
+  double target;      ///< target latency in seconds
+  double tolerance;   ///< relative dead band around target
+  double min_scale;   ///< lower bound for scale
+  double backoff = 0.8;
+  double step = 0.05;
+  double scale = 1.0;
+  bool grow_when_idle = false;
+
+  std::atomic<uint64_t> sample_sum_ns = {0};
+  std::atomic<uint64_t> sample_count = {0};
+
+  void _apply();
+
+public:
+  AdaptiveThrottle(CephContext *cct, const std::string& n,
+		   double target_latency, double tolerance, double min_scale);
+  ~AdaptiveThrottle();
+
+  /// start managing t; its current max is taken as the upper bound
+  void add_throttle(Throttle *t);
+
+  /// report one latency sample, safe to call from any thread
+  void add_sample(utime_t lat) {
+    sample_sum_ns += lat.to_nsec();
+    ++sample_count;
+  }
+
+  /// treat an interval without samples as zero latency instead of no data
+  void set_grow_when_idle(bool b) {
+    grow_when_idle = b;
+  }
+
+  /// adjust the throttles from the samples seen since the last update
+  void update();
+
+  double get_scale() const { return scale; }
+};
+
 /**
  * @class SimpleThrottle
  * This is a simple way to bound the number of concurrent operations.
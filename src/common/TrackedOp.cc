@@ -14,6 +14,7 @@
 #include "common/Formatter.h"
 #include <iostream>
 #include <vector>
+#include <thread>
 #include "common/debug.h"
 #include "common/config.h"
 #include "msg/Message.h"
@@ -29,58 +30,103 @@ static ostream& _prefix(std::ostream* _dout)
   return *_dout << "-- op tracker -- ";
 }
 
-void OpHistory::on_shutdown()
+OpHistory::OpHistory(uint32_t num_shards)
+  : shutdown(false), history_size(0), history_duration(0)
 {
-  Mutex::Locker history_lock(ops_history_lock);
-  arrived.clear();
-  duration.clear();
-  shutdown = true;
+  for (uint32_t i = 0; i < num_shards; i++) {
+    shards.push_back(new Shard("OpHistory::Lock"));
+  }
 }
 
-void OpHistory::insert(utime_t now, TrackedOpRef op)
+OpHistory::~OpHistory()
 {
-  Mutex::Locker history_lock(ops_history_lock);
-  if (shutdown)
-    return;
-  duration.insert(make_pair(op->get_duration(), op));
-  arrived.insert(make_pair(op->get_initiated(), op));
-  cleanup(now);
+  for (auto s : shards) {
+    assert(s->ops.empty());
+    delete s;
+  }
 }
 
-void OpHistory::cleanup(utime_t now)
+void OpHistory::on_shutdown()
 {
-  while (arrived.size() &&
-	 (now - arrived.begin()->first >
-	  (double)(history_duration))) {
-    duration.erase(make_pair(
-	arrived.begin()->second->get_duration(),
-	arrived.begin()->second));
-    arrived.erase(arrived.begin());
+  shutdown = true;
+  for (auto s : shards) {
+    Mutex::Locker history_lock(s->lock);
+    s->ops.clear();
   }
+}
 
-  while (duration.size() > history_size) {
-    arrived.erase(make_pair(
-	duration.begin()->second->get_initiated(),
-	duration.begin()->second));
-    duration.erase(duration.begin());
+void OpHistory::set_size_and_duration(uint32_t new_size, uint32_t new_duration)
+{
+  history_size = new_size;
+  history_duration = new_duration;
+}
+
+void OpHistory::insert(utime_t now, TrackedOpRef op)
+{
+  if (shutdown)
+    return;
+  double duration = op->get_duration();
+  // any of the slowest history_size ops may land in the same shard, so
+  // each shard keeps that many and dump_ops picks the slowest overall
+  uint32_t slots = history_size;
+  Shard *s = shards[op->seq % shards.size()];
+  Mutex::Locker history_lock(s->lock);
+  if (shutdown)
+    return;
+  // the victim is a slot that has expired, is free, or holds the
+  // fastest op, if that is faster than this one
+  size_t victim = s->ops.size();
+  double victim_duration = duration;
+  bool full = s->ops.size() >= slots;
+  for (size_t i = 0; i < s->ops.size(); ++i) {
+    if (now - s->ops[i]->get_initiated() > (double)history_duration) {
+      victim = i;
+      break;
+    }
+    double d = s->ops[i]->get_duration();
+    if (full && d < victim_duration) {
+      victim = i;
+      victim_duration = d;
+    }
   }
+  if (victim < s->ops.size())
+    s->ops[victim] = op;
+  else if (s->ops.size() < slots)
+    s->ops.push_back(op);
+  while (s->ops.size() > slots)
+    s->ops.pop_back();
 }
 
 void OpHistory::dump_ops(utime_t now, Formatter *f)
 {
-  Mutex::Locker history_lock(ops_history_lock);
-  cleanup(now);
+  vector<TrackedOpRef> ops;
+  for (auto s : shards) {
+    Mutex::Locker history_lock(s->lock);
+    for (auto& op : s->ops) {
+      if (now - op->get_initiated() <= (double)history_duration)
+	ops.push_back(op);
+    }
+  }
+  // keep the slowest history_size, in order of arrival
+  if (ops.size() > history_size) {
+    std::sort(ops.begin(), ops.end(),
+	      [](const TrackedOpRef& a, const TrackedOpRef& b) {
+		return a->get_duration() > b->get_duration();
+	      });
+    ops.resize(history_size);
+  }
+  std::sort(ops.begin(), ops.end(),
+	    [](const TrackedOpRef& a, const TrackedOpRef& b) {
+	      return a->get_initiated() < b->get_initiated();
+	    });
   f->open_object_section("OpHistory");
   f->dump_int("num to keep", history_size);
   f->dump_int("duration to keep", history_duration);
   {
     f->open_array_section("Ops");
-    for (set<pair<utime_t, TrackedOpRef> >::const_iterator i =
-	   arrived.begin();
-	 i != arrived.end();
-	 ++i) {
+    for (auto& op : ops) {
       f->open_object_section("Op");
-      i->second->dump(now, f);
+      op->dump(now, f);
       f->close_section();
     }
     f->close_section();
@@ -88,38 +134,131 @@ void OpHistory::dump_ops(utime_t now, Formatter *f)
   f->close_section();
 }
 
+/**
+ * the ops in flight in one shard
+ *
+ * Ops take a free slot with a compare-and-swap and clear it when they
+ * are done, so registering and unregistering take no lock.  Slots come
+ * in chunks that are added as needed and only freed with the tracker.
+ *
+ * Readers walk the slots with readers raised.  An op clears its slot
+ * before looking at readers, so a reader that starts later will not
+ * see it; if readers is raised, the op waits for the walk to finish
+ * before it can be freed.
+ */
 struct ShardedTrackingData {
-  Mutex ops_in_flight_lock_sharded;
-  xlist<TrackedOp *> ops_in_flight_sharded;
-  explicit ShardedTrackingData(string lock_name):
-      ops_in_flight_lock_sharded(lock_name.c_str()) {}
+  struct Chunk {
+    static const unsigned SLOTS = 64;
+    std::atomic<TrackedOp*> slots[SLOTS];
+    Chunk *next;
+    Chunk() : next(nullptr) {
+      for (unsigned i = 0; i < SLOTS; ++i)
+	slots[i] = nullptr;
+    }
+  };
+  std::atomic<Chunk*> chunks;
+  std::atomic<unsigned> readers;
+
+  ShardedTrackingData() : chunks(nullptr), readers(0) {}
+  ~ShardedTrackingData() {
+    Chunk *c = chunks;
+    while (c) {
+      Chunk *next = c->next;
+      for (unsigned i = 0; i < Chunk::SLOTS; ++i)
+	assert(c->slots[i] == nullptr);
+      delete c;
+      c = next;
+    }
+  }
+
+  void add(TrackedOp *op) {
+    for (Chunk *c = chunks; c; c = c->next) {
+      for (unsigned i = 0; i < Chunk::SLOTS; ++i) {
+	TrackedOp *expected = nullptr;
+	if (c->slots[i].load(std::memory_order_relaxed) == nullptr &&
+	    c->slots[i].compare_exchange_strong(expected, op)) {
+	  op->inflight_slot = &c->slots[i];
+	  return;
+	}
+      }
+    }
+    Chunk *c = new Chunk;
+    c->slots[0] = op;
+    op->inflight_slot = &c->slots[0];
+    Chunk *head = chunks.load();
+    do {
+      c->next = head;
+    } while (!chunks.compare_exchange_weak(head, c));
+  }
+
+  void remove(TrackedOp *op) {
+    assert(op->inflight_slot);
+    assert(*op->inflight_slot == op);
+    op->inflight_slot->store(nullptr);
+    op->inflight_slot = nullptr;
+    while (readers.load())
+      std::this_thread::yield();
+  }
+
+  template <typename F>
+  void for_each(F&& f) {
+    for (Chunk *c = chunks; c; c = c->next) {
+      for (unsigned i = 0; i < Chunk::SLOTS; ++i) {
+	TrackedOp *op = c->slots[i];
+	if (op)
+	  f(op);
+      }
+    }
+  }
 };
 
 OpTracker::OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards):
   seq(0),
   num_optracker_shards(num_shards),
+  history(num_shards),
   complaint_time(0), log_threshold(0),
   tracking_enabled(tracking),
-  lock("OpTracker::lock"), cct(cct_) {
+  cct(cct_) {
     for (uint32_t i = 0; i < num_optracker_shards; i++) {
-      char lock_name[32] = {0};
-      snprintf(lock_name, sizeof(lock_name), "%s:%d", "OpTracker::ShardedLock", i);
-      ShardedTrackingData* one_shard = new ShardedTrackingData(lock_name);
+      ShardedTrackingData* one_shard = new ShardedTrackingData;
       sharded_in_flight_list.push_back(one_shard);
     }
 }
 
 OpTracker::~OpTracker() {
   while (!sharded_in_flight_list.empty()) {
-    assert((sharded_in_flight_list.back())->ops_in_flight_sharded.empty());
     delete sharded_in_flight_list.back();
     sharded_in_flight_list.pop_back();
   }
 }
 
+template <typename F>
+void OpTracker::visit_ops_in_flight(F&& f)
+{
+  for (auto sdata : sharded_in_flight_list)
+    ++sdata->readers;
+  vector<TrackedOp*> ops;
+  for (auto sdata : sharded_in_flight_list) {
+    sdata->for_each([&ops](TrackedOp *op) {
+	// skip ops still being registered
+	if (op->is_tracked)
+	  ops.push_back(op);
+      });
+  }
+  std::sort(ops.begin(), ops.end(),
+	    [](const TrackedOp *a, const TrackedOp *b) {
+	      return a->get_initiated() < b->get_initiated();
+	    });
+  for (auto op : ops) {
+    if (!f(op))
+      break;
+  }
+  for (auto sdata : sharded_in_flight_list)
+    --sdata->readers;
+}
+
 bool OpTracker::dump_historic_ops(Formatter *f)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
@@ -130,7 +269,6 @@ bool OpTracker::dump_historic_ops(Formatter *f)
 
 bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
@@ -138,19 +276,15 @@ bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked)
   uint64_t total_ops_in_flight = 0;
   f->open_array_section("ops"); // list of TrackedOps
   utime_t now = ceph_clock_now();
-  for (uint32_t i = 0; i < num_optracker_shards; i++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[i];
-    assert(NULL != sdata); 
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    for (xlist<TrackedOp*>::iterator p = sdata->ops_in_flight_sharded.begin(); !p.end(); ++p) {
-      if (print_only_blocked && (now - (*p)->get_initiated() <= complaint_time))
-	break;
+  visit_ops_in_flight([&](TrackedOp *op) {
+      if (print_only_blocked && (now - op->get_initiated() <= complaint_time))
+	return false;
       f->open_object_section("op");
-      (*p)->dump(now, f);
+      op->dump(now, f);
       f->close_section(); // this TrackedOp
       total_ops_in_flight++;
-    }
-  }
+      return true;
+    });
   f->close_section(); // list of TrackedOps
   if (print_only_blocked) {
     f->dump_float("complaint_time", complaint_time);
@@ -161,9 +295,8 @@ bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked)
   return true;
 }
 
-bool OpTracker::register_inflight_op(xlist<TrackedOp*>::item *i)
+bool OpTracker::register_inflight_op(TrackedOp *i)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
@@ -171,11 +304,8 @@ bool OpTracker::register_inflight_op(xlist<TrackedOp*>::item *i)
   uint32_t shard_index = current_seq % num_optracker_shards;
   ShardedTrackingData* sdata = sharded_in_flight_list[shard_index];
   assert(NULL != sdata);
-  {
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    sdata->ops_in_flight_sharded.push_back(i);
-    sdata->ops_in_flight_sharded.back()->seq = current_seq;
-  }
+  i->seq = current_seq;
+  sdata->add(i);
   return true;
 }
 
@@ -187,14 +317,9 @@ void OpTracker::unregister_inflight_op(TrackedOp *i)
   uint32_t shard_index = i->seq % num_optracker_shards;
   ShardedTrackingData* sdata = sharded_in_flight_list[shard_index];
   assert(NULL != sdata);
-  {
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    assert(i->xitem.get_list() == &sdata->ops_in_flight_sharded);
-    i->xitem.remove_myself();
-  }
+  sdata->remove(i);
   i->_unregistered();
 
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     delete i;
   else {
@@ -205,44 +330,12 @@ void OpTracker::unregister_inflight_op(TrackedOp *i)
 
 bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector, int *slow)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
   utime_t now = ceph_clock_now();
   utime_t too_old = now;
   too_old -= complaint_time;
-  utime_t oldest_op = now;
-  uint64_t total_ops_in_flight = 0;
-
-  for (uint32_t i = 0; i < num_optracker_shards; i++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[i];
-    assert(NULL != sdata);
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    if (!sdata->ops_in_flight_sharded.empty()) {
-      utime_t oldest_op_tmp = sdata->ops_in_flight_sharded.front()->get_initiated();
-      if (oldest_op_tmp < oldest_op) {
-        oldest_op = oldest_op_tmp;
-      }
-    }
-    total_ops_in_flight += sdata->ops_in_flight_sharded.size();
-  }
-
-  if (0 == total_ops_in_flight)
-    return false;
-
-  utime_t oldest_secs = now - oldest_op;
-
-  dout(10) << "ops_in_flight.size: " << total_ops_in_flight
-           << "; oldest is " << oldest_secs
-           << " seconds old" << dendl;
-
-  if (oldest_secs < complaint_time)
-    return false;
-
-  warning_vector.reserve(log_threshold + 1);
-  //store summary message
-  warning_vector.push_back("");
 
   int _slow = 0;    // total slow
   if (!slow)
@@ -250,37 +343,43 @@ bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector, int *sl
   else
     *slow = _slow;  // start from 0 anyway
   int warned = 0;   // total logged
-  for (uint32_t iter = 0; iter < num_optracker_shards; iter++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[iter];
-    assert(NULL != sdata);
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    if (sdata->ops_in_flight_sharded.empty())
-      continue;
-    xlist<TrackedOp*>::iterator i = sdata->ops_in_flight_sharded.begin();    
-    while (!i.end() && (*i)->get_initiated() < too_old) {
+  uint64_t total_ops_in_flight = 0;
+  utime_t oldest_secs;
+  vector<string> warnings;
+  visit_ops_in_flight([&](TrackedOp *op) {
+      if (total_ops_in_flight++ == 0)
+	oldest_secs = now - op->get_initiated();
+      if (op->get_initiated() >= too_old)
+	return true;  // keep counting
       (*slow)++;
 
       // exponential backoff of warning intervals
       if (warned < log_threshold &&
-         ((*i)->get_initiated() + (complaint_time * (*i)->warn_interval_multiplier)) < now) {
+	  (op->get_initiated() + (complaint_time * op->warn_interval_multiplier)) < now) {
         // will warn, increase counter
         warned++;
 
-        utime_t age = now - (*i)->get_initiated();
+        utime_t age = now - op->get_initiated();
         stringstream ss;
         ss << "slow request " << age << " seconds old, received at "
-           << (*i)->get_initiated() << ": ";
-        (*i)->_dump_op_descriptor_unlocked(ss);
-        ss << " currently "
-	   << ((*i)->current.size() ? (*i)->current : (*i)->state_string());
-        warning_vector.push_back(ss.str());
+           << op->get_initiated() << ": ";
+        op->_dump_op_descriptor_unlocked(ss);
+	const char *current = op->current;
+        ss << " currently " << (current ? current : op->state_string());
+        warnings.push_back(ss.str());
 
         // only those that have been shown will backoff
-        (*i)->warn_interval_multiplier *= 2;
+        op->warn_interval_multiplier *= 2;
       }
-      ++i;
-    }
-  }
+      return true;
+    });
+
+  if (0 == total_ops_in_flight)
+    return false;
+
+  dout(10) << "ops_in_flight.size: " << total_ops_in_flight
+           << "; oldest is " << oldest_secs
+           << " seconds old" << dendl;
 
   // only summarize if we warn about any.  if everything has backed
   // off, we will stay silent.
@@ -288,7 +387,10 @@ bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector, int *sl
     stringstream ss;
     ss << *slow << " slow requests, " << warned << " included below; oldest blocked for > "
        << oldest_secs << " secs";
-    warning_vector[0] = ss.str();
+    warning_vector.reserve(warnings.size() + 1);
+    warning_vector.push_back(ss.str());
+    warning_vector.insert(warning_vector.end(), warnings.begin(),
+			  warnings.end());
   }
 
   return warned > 0;
@@ -299,28 +401,22 @@ void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
   h->clear();
   utime_t now = ceph_clock_now();
 
-  for (uint32_t iter = 0; iter < num_optracker_shards; iter++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[iter];
-    assert(NULL != sdata);
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-
-    for (xlist<TrackedOp*>::iterator i = sdata->ops_in_flight_sharded.begin();
-                                                               !i.end(); ++i) {
-      utime_t age = now - (*i)->get_initiated();
+  visit_ops_in_flight([&](TrackedOp *op) {
+      utime_t age = now - op->get_initiated();
       uint32_t ms = (long)(age * 1000.0);
       h->add(ms);
-    }
-  }
+      return true;
+    });
 }
 
-void OpTracker::mark_event(TrackedOp *op, const string &dest, utime_t time)
+void OpTracker::mark_event(TrackedOp *op, const char *dest, utime_t time)
 {
   if (!op->is_tracked)
     return;
   return _mark_event(op, dest, time);
 }
 
-void OpTracker::_mark_event(TrackedOp *op, const string &evt,
+void OpTracker::_mark_event(TrackedOp *op, const char *evt,
 			    utime_t time)
 {
   dout(5);
@@ -343,18 +439,98 @@ void OpTracker::RemoveOnDelete::operator()(TrackedOp *op) {
   // Do not delete op, unregister_inflight_op took control
 }
 
-void TrackedOp::mark_event(const string &event)
+const unsigned TrackedOp::NUM_EVENTS;
+
+void TrackedOp::_add_event(utime_t stamp, const char *str)
+{
+  unsigned i = num_events++;
+  if (i < NUM_EVENTS) {
+    events[i].stamp = stamp;
+    events[i].str.store(str, std::memory_order_release);
+  } else {
+    Mutex::Locker l(lock);
+    more_events.push_back(make_pair(stamp, str));
+  }
+}
+
+const char *TrackedOp::_get_last_event(utime_t *stamp) const
+{
+  unsigned n = num_events;
+  if (n > NUM_EVENTS) {
+    Mutex::Locker l(lock);
+    if (!more_events.empty()) {
+      if (stamp)
+	*stamp = more_events.back().first;
+      return more_events.back().second;
+    }
+    n = NUM_EVENTS;
+  }
+  if (n == 0)
+    return nullptr;
+  const char *s = events[n - 1].str.load(std::memory_order_acquire);
+  if (s && stamp)
+    *stamp = events[n - 1].stamp;
+  return s;
+}
+
+double TrackedOp::get_duration() const
+{
+  utime_t stamp;
+  const char *last = _get_last_event(&stamp);
+  if (last && strcmp(last, "done") == 0)
+    return stamp - get_initiated();
+  else
+    return ceph_clock_now() - get_initiated();
+}
+
+void TrackedOp::mark_event(const char *event, utime_t stamp)
 {
   if (!is_tracked)
     return;
 
-  utime_t now = ceph_clock_now();
+  _add_event(stamp, event);
+  tracker->mark_event(this, event, stamp);
+  _event_marked();
+}
+
+const char *TrackedOp::mark_event(const string &event, utime_t stamp)
+{
+  if (!is_tracked)
+    return nullptr;
+
+  const char *s;
   {
     Mutex::Locker l(lock);
-    events.push_back(make_pair(now, event));
+    event_strings.push_back(event);
+    s = event_strings.back().c_str();
   }
-  tracker->mark_event(this, event);
-  _event_marked();
+  mark_event(s, stamp);
+  return s;
+}
+
+void TrackedOp::dump_events(Formatter *f) const
+{
+  f->open_array_section("events");
+  unsigned n = MIN(num_events.load(), NUM_EVENTS);
+  for (unsigned i = 0; i < n; ++i) {
+    const char *s = events[i].str.load(std::memory_order_acquire);
+    if (!s)
+      continue;  // being marked right now
+    f->open_object_section("event");
+    f->dump_stream("time") << events[i].stamp;
+    f->dump_string("event", s);
+    f->close_section();
+  }
+  {
+    Mutex::Locker l(lock);
+    for (auto& e : more_events) {
+      f->open_object_section("event");
+      f->dump_stream("time") << e.first;
+      f->dump_string("event", e.second);
+      f->close_section();
+    }
+  }
+  f->close_section();
 }
 
 void TrackedOp::dump(utime_t now, Formatter *f) const
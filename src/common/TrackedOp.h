@@ -18,7 +18,6 @@
 #include <include/utime.h>
 #include "common/Mutex.h"
 #include "common/histogram.h"
-#include "include/xlist.h"
 #include "msg/Message.h"
 #include "include/memory.h"
 #include "common/RWLock.h"
@@ -27,29 +26,33 @@
 class TrackedOp;
 typedef ceph::shared_ptr<TrackedOp> TrackedOpRef;
 
+/**
+ * completed ops, kept for dump_historic_ops
+ *
+ * Keeps the slowest ops that completed in the last history_duration
+ * seconds.  Ops are spread over shards, each with a small fixed number
+ * of slots and its own lock, so recording a completed op costs an
+ * uncontended lock and a scan of a few slots instead of two set
+ * inserts under a lock shared by every op.
+ */
 class OpHistory {
-  set<pair<utime_t, TrackedOpRef> > arrived;
-  set<pair<double, TrackedOpRef> > duration;
-  Mutex ops_history_lock;
-  void cleanup(utime_t now);
-  bool shutdown;
-  uint32_t history_size;
-  uint32_t history_duration;
+  struct Shard {
+    Mutex lock;
+    vector<TrackedOpRef> ops;  ///< the slowest recent ops, up to history_size
+    explicit Shard(const char *name) : lock(name) {}
+  };
+  vector<Shard*> shards;
+  std::atomic<bool> shutdown;
+  std::atomic<uint32_t> history_size;
+  std::atomic<uint32_t> history_duration;
 
 public:
-  OpHistory() : ops_history_lock("OpHistory::Lock"), shutdown(false),
-  history_size(0), history_duration(0) {}
-  ~OpHistory() {
-    assert(arrived.empty());
-    assert(duration.empty());
-  }
+  explicit OpHistory(uint32_t num_shards = 1);
+  ~OpHistory();
   void insert(utime_t now, TrackedOpRef op);
   void dump_ops(utime_t now, Formatter *f);
   void on_shutdown();
-  void set_size_and_duration(uint32_t new_size, uint32_t new_duration) {
-    history_size = new_size;
-    history_duration = new_duration;
-  }
+  void set_size_and_duration(uint32_t new_size, uint32_t new_duration);
 };
 
 struct ShardedTrackingData;
@@ -68,9 +71,12 @@ class OpTracker {
   OpHistory history;
   float complaint_time;
   int log_threshold;
-  void _mark_event(TrackedOp *op, const string &evt, utime_t now);
-  bool tracking_enabled;
-  RWLock       lock;
+  void _mark_event(TrackedOp *op, const char *evt, utime_t now);
+  std::atomic<bool> tracking_enabled;
+
+  /// call f on every op in flight, oldest first
+  template <typename F>
+  void visit_ops_in_flight(F&& f);
 
 public:
   CephContext *cct;
@@ -84,12 +90,11 @@ public:
     history.set_size_and_duration(new_size, new_duration);
   }
   void set_tracking(bool enable) {
-    RWLock::WLocker l(lock);
     tracking_enabled = enable;
   }
   bool dump_ops_in_flight(Formatter *f, bool print_only_blocked=false);
   bool dump_historic_ops(Formatter *f);
-  bool register_inflight_op(xlist<TrackedOp*>::item *i);
+  bool register_inflight_op(TrackedOp *i);
   void unregister_inflight_op(TrackedOp *i);
 
   void get_age_ms_histogram(pow2_hist_t *h);
@@ -103,7 +108,8 @@ public:
    * @return True if there are any Ops to warn on, false otherwise.
    */
   bool check_ops_in_flight(std::vector<string> &warning_strings, int *slow = NULL);
-  void mark_event(TrackedOp *op, const string &evt,
+  /// log an event; evt must be a literal (see TrackedOp::mark_event)
+  void mark_event(TrackedOp *op, const char *evt,
 		  utime_t time = ceph_clock_now());
 
   void on_shutdown() {
@@ -125,28 +131,52 @@ class TrackedOp {
 private:
   friend class OpHistory;
   friend class OpTracker;
-  xlist<TrackedOp*>::item xitem;
+  friend struct ShardedTrackingData;
+  /// our slot in the OpTracker's in flight table, while registered
+  std::atomic<TrackedOp*> *inflight_slot;
+
+  static const unsigned NUM_EVENTS = 16;
+  struct Event {
+    utime_t stamp;
+    std::atomic<const char*> str;  ///< set last, once stamp is valid
+  };
+  /// the first NUM_EVENTS events, appended to without locking
+  Event events[NUM_EVENTS];
+  std::atomic<unsigned> num_events;
+  /// events after the first NUM_EVENTS; protected by lock
+  list<pair<utime_t, const char*> > more_events;
+  /// copies of the event names that were passed as strings
+  list<string> event_strings;
+
+  void _add_event(utime_t stamp, const char *str);
+  const char *_get_last_event(utime_t *stamp) const;
+
 protected:
   OpTracker *tracker; /// the tracker we are associated with
 
   utime_t initiated_at;
-  list<pair<utime_t, string> > events; /// list of events and their times
-  mutable Mutex lock; /// to protect the events list
-  string current; /// the current state the event is in
+  mutable Mutex lock; /// to protect more_events and event_strings
+  /// the current state the event is in, if set; valid for the op's life
+  std::atomic<const char*> current;
   uint64_t seq; /// a unique value set by the OpTracker
 
   uint32_t warn_interval_multiplier; // limits output of a given op warning
   // Transitions from false -> true without locks being held
   atomic<bool> is_tracked; //whether in tracker and out of constructor
   TrackedOp(OpTracker *_tracker, const utime_t& initiated) :
-    xitem(this),
+    inflight_slot(nullptr),
+    num_events(0),
     tracker(_tracker),
     initiated_at(initiated),
     lock("TrackedOp::lock"),
+    current(nullptr),
     seq(0),
     warn_interval_multiplier(1),
     is_tracked(false)
-  { }
+  {
+    for (unsigned i = 0; i < NUM_EVENTS; ++i)
+      events[i].str = nullptr;
+  }
 
   /// output any type-specific data you want to get when dump() is called
   virtual void _dump(Formatter *f) const {}
@@ -157,6 +187,9 @@ protected:
   /// called when the last non-OpTracker reference is dropped
   virtual void _unregistered() {};
 
+  /// dump the events marked so far as an "events" array section
+  void dump_events(Formatter *f) const;
+
 public:
   virtual ~TrackedOp() {}
 
@@ -164,23 +197,31 @@ public:
     return initiated_at;
   }
 
-  double get_duration() const {
-    Mutex::Locker l(lock);
-    if (!events.empty() && events.rbegin()->second.compare("done") == 0)
-      return events.rbegin()->first - get_initiated();
-    else
-      return ceph_clock_now() - get_initiated();
-  }
+  double get_duration() const;
 
-  void mark_event(const string &event);
+  /**
+   * record an event
+   *
+   * The name is not copied, so it must outlive the op; in practice it
+   * is a literal.  Use the string variant for names built at runtime.
+   */
+  void mark_event(const char *event, utime_t stamp = ceph_clock_now());
+  /**
+   * record an event with a name built at runtime
+   *
+   * @return the op's copy of the name, valid for the op's life, or
+   *         nullptr if the op is not tracked
+   */
+  const char *mark_event(const string &event,
+			 utime_t stamp = ceph_clock_now());
   virtual const char *state_string() const {
-    Mutex::Locker l(lock);
-    return events.rbegin()->second.c_str();
+    const char *s = _get_last_event(nullptr);
+    return s ? s : "";
   }
   void dump(utime_t now, Formatter *f) const;
   void tracking_start() {
-    if (tracker->register_inflight_op(&xitem)) {
-      events.push_back(make_pair(initiated_at, "initiated"));
+    if (tracker->register_inflight_op(this)) {
+      _add_event(initiated_at, "initiated");
       is_tracked = true;
     }
   }
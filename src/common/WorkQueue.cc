@@ -372,6 +372,8 @@ void ShardedThreadPool::start_threads()
     WorkThreadSharded *wt = new WorkThreadSharded(this, thread_index);
     ldout(cct, 10) << "start_threads creating and starting " << wt << dendl;
     threads_shardedpool.push_back(wt);
+    if (!thread_cpus.empty())
+      wt->set_affinity(thread_cpus[thread_index % thread_cpus.size()]);
     wt->create(thread_name.c_str());
     thread_index++;
   }
@@ -628,6 +628,7 @@ class ShardedThreadPool {
   atomic_t drain_threads;
   uint32_t num_paused;
   uint32_t num_drained;
+  vector<int> thread_cpus;
 
 public:
 
@@ -702,6 +703,10 @@ public:
 
   ~ShardedThreadPool(){};
 
+  /// pin thread i to cpus[i % cpus.size()]; must be called before start()
+  void set_thread_cpus(const vector<int>& cpus) {
+    thread_cpus = cpus;
+  }
   /// start thread pool thread
   void start();
   /// stop thread pool thread
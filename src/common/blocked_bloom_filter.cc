@@ -0,0 +1,125 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <cmath>
+
+#include "include/types.h"
+#include "common/blocked_bloom_filter.hpp"
+
+// values hashed and prefetched ahead of testing in a batched lookup
+static const size_t BATCH = 16;
+
+const unsigned blocked_bloom_filter::BLOCK_WORDS;
+const unsigned blocked_bloom_filter::BLOCK_BITS;
+const unsigned blocked_bloom_filter::MAX_PROBES;
+
+void blocked_bloom_filter::init(uint64_t predicted_element_count, double fpp)
+{
+  // the textbook optimum is k = log2(1/fpp) probes at k / ln 2 bits per
+  // element.  packing the probes into one block makes busy blocks
+  // fill up faster than the table as a whole, which hurts more the
+  // more probes there are; k/40 more bits keeps the false positive
+  // rate at or under what was asked for.
+  double k = std::max(1.0, std::round(-std::log2(fpp)));
+  probe_count_ = std::max(1u, std::min(MAX_PROBES, (unsigned)k));
+  double bits = (double)std::max<uint64_t>(predicted_element_count, 1) *
+    probe_count_ / M_LN2 * (1.0 + probe_count_ / 40.0);
+  uint64_t blocks = std::ceil(bits / BLOCK_BITS);
+  alloc(std::max<uint64_t>(1, std::min<uint64_t>(blocks, UINT32_MAX)));
+}
+
+void blocked_bloom_filter::contains(const uint32_t *vals, size_t n,
+				    bool *out) const
+{
+  if (!block_count_) {
+    std::fill(out, out + n, false);
+    return;
+  }
+  const uint64_t *b = blocks();
+  uint64_t h[BATCH];
+  for (size_t i = 0; i < n; i += BATCH) {
+    size_t m = std::min(BATCH, n - i);
+    for (size_t j = 0; j < m; ++j) {
+      h[j] = hash(vals[i + j]);
+      __builtin_prefetch(b + block_of(h[j]) * BLOCK_WORDS);
+    }
+    for (size_t j = 0; j < m; ++j)
+      out[i + j] = test(h[j]);
+  }
+}
+
+double blocked_bloom_filter::density() const
+{
+  if (!block_count_)
+    return 0.0;
+  const uint64_t *b = blocks();
+  uint64_t set = 0;
+  for (size_t i = 0; i < (size_t)block_count_ * BLOCK_WORDS; ++i)
+    set += __builtin_popcountll(b[i]);
+  return (double)set / (double)((uint64_t)block_count_ * BLOCK_BITS);
+}
+
+double blocked_bloom_filter::approx_unique_element_count() const
+{
+  // each insert sets (up to) k of m bits, so after n distinct inserts
+  // the expected fraction of bits set is 1 - e^(-kn/m)
+  double d = density();
+  if (d >= 1.0)
+    return (double)insert_count_;
+  double m = (double)block_count_ * BLOCK_BITS;
+  double n = -m / probe_count_ * std::log(1.0 - d);
+  return std::min(n, (double)insert_count_);
+}
+
+void blocked_bloom_filter::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(block_count_, bl);
+  ::encode(probe_count_, bl);
+  ::encode(insert_count_, bl);
+  ::encode(target_element_count_, bl);
+  ::encode(seed_, bl);
+  const uint64_t *b = blocks();
+  for (size_t i = 0; i < (size_t)block_count_ * BLOCK_WORDS; ++i)
+    ::encode(b[i], bl);
+  ENCODE_FINISH(bl);
+}
+
+void blocked_bloom_filter::decode(bufferlist::iterator& p)
+{
+  DECODE_START(1, p);
+  uint32_t blocks;
+  ::decode(blocks, p);
+  ::decode(probe_count_, p);
+  if (probe_count_ > MAX_PROBES)
+    throw buffer::malformed_input("blocked_bloom_filter probe count");
+  ::decode(insert_count_, p);
+  ::decode(target_element_count_, p);
+  ::decode(seed_, p);
+  alloc(blocks);
+  uint64_t *b = this->blocks();
+  for (size_t i = 0; i < (size_t)blocks * BLOCK_WORDS; ++i)
+    ::decode(b[i], p);
+  DECODE_FINISH(p);
+}
+
+void blocked_bloom_filter::dump(Formatter *f) const
+{
+  f->dump_unsigned("block_count", block_count_);
+  f->dump_unsigned("probe_count", probe_count_);
+  f->dump_unsigned("insert_count", insert_count_);
+  f->dump_unsigned("target_element_count", target_element_count_);
+  f->dump_unsigned("random_seed", seed_);
+  f->dump_float("density", density());
+}
+
+void blocked_bloom_filter::generate_test_instances(
+  list<blocked_bloom_filter*>& ls)
+{
+  ls.push_back(new blocked_bloom_filter);
+  ls.push_back(new blocked_bloom_filter(10, .5, 1));
+  ls.push_back(new blocked_bloom_filter(100, .01, 2));
+  ls.back()->insert(1);
+  ls.back()->insert(0x12345678);
+  ls.back()->insert(0xffffffff);
+}
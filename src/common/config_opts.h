@@ -225,6 +225,8 @@ OPTION(ms_async_rdma_polling_us, OPT_U32, 1000)
 OPTION(ms_async_rdma_local_gid, OPT_STR, "")       // GID format: "fe80:0000:0000:0000:7efe:90ff:fe72:6efe", no zero folding
 OPTION(ms_async_rdma_roce_ver, OPT_INT, 1)         // 0=RoCEv1, 1=RoCEv2, 2=RoCEv1.5
 OPTION(ms_async_rdma_sl, OPT_INT, 3)               // in RoCE, this means PCP
+OPTION(ms_async_rdma_reg_cache_bytes, OPT_U64, 0)  // memory registration cache for zero copy sends, 0 disables
+OPTION(ms_async_rdma_zero_copy_min_bytes, OPT_U32, 65536) // send bufferptrs at least this large without copying
 
 OPTION(ms_dpdk_port_id, OPT_INT, 0)
 OPTION(ms_dpdk_coremask, OPT_STR, "1")
@@ -648,6 +650,10 @@ OPTION(osd_max_write_size, OPT_INT, 90)
 OPTION(osd_max_pgls, OPT_U64, 1024) // max number of pgls entries to return
 OPTION(osd_client_message_size_cap, OPT_U64, 500*1024L*1024L) // client data allowed in-memory (in bytes)
 OPTION(osd_client_message_cap, OPT_U64, 100)              // num client messages allowed in-memory
+OPTION(osd_client_adaptive_throttle, OPT_BOOL, false) // scale the client throttles above from op queue latency
+OPTION(osd_client_adaptive_throttle_target_latency, OPT_DOUBLE, .005) // seconds an op should wait in the op queue
+OPTION(osd_client_adaptive_throttle_tolerance, OPT_DOUBLE, .2)  // relative dead band around the target
+OPTION(osd_client_adaptive_throttle_min_scale, OPT_DOUBLE, .05) // never shrink the throttles below this fraction
 OPTION(osd_pg_bits, OPT_INT, 6)  // bits per osd
 OPTION(osd_pgp_bits, OPT_INT, 6)  // bits per osd
 OPTION(osd_crush_chooseleaf_type, OPT_INT, 1) // 1 = host
@@ -721,22 +727,53 @@ OPTION(osd_max_markdown_count, OPT_INT, 5)
 
 OPTION(osd_op_threads, OPT_INT, 2)    // 0 == no threading
 OPTION(osd_peering_wq_batch_size, OPT_U64, 20)
+// peering events handled for one pg before moving on to the next in a batch
+OPTION(osd_peering_wq_max_events_per_pg, OPT_U64, 10)
 OPTION(osd_op_pq_max_tokens_per_priority, OPT_U64, 4194304)
 OPTION(osd_op_pq_min_cost, OPT_U64, 65536)
 OPTION(osd_disk_threads, OPT_INT, 1)
 OPTION(osd_disk_thread_ioprio_class, OPT_STR, "") // rt realtime be best effort idle
 OPTION(osd_disk_thread_ioprio_priority, OPT_INT, -1) // 0-7
 OPTION(osd_recovery_threads, OPT_INT, 1)
+OPTION(osd_load_pgs_threads, OPT_INT, 4)  // threads reading pg state at startup
 OPTION(osd_recover_clone_overlap, OPT_BOOL, true)   // preserve clone_overlap during recovery/migration
 OPTION(osd_op_num_threads_per_shard, OPT_INT, 2)
 OPTION(osd_op_num_shards, OPT_INT, 5)
-OPTION(osd_op_queue, OPT_STR, "wpq") // PrioritzedQueue (prio), Weighted Priority Queue (wpq), or debug_random
+OPTION(osd_op_queue, OPT_STR, "wpq") // PrioritzedQueue (prio), Weighted Priority Queue (wpq), mClock (mclock), or debug_random
 OPTION(osd_op_queue_cut_off, OPT_STR, "low") // Min priority to go to strict queue. (low, high, debug_random)
+// Run each op shard on a single thread pinned to its own cpu, and have
+// dispatch hand ops to the shard through a lock-free inbox
+OPTION(osd_op_run_to_completion, OPT_BOOL, false)
+OPTION(osd_op_shard_cpus, OPT_STR, "") // cpus to pin shards to, e.g. "0-3,8"; empty for all online cpus
+
+// mClock op queue: reservation and limit are in ops/sec (0 = none),
+// weight is the relative share of the capacity left over.  Client op
+// settings apply to each client separately and can be overridden per
+// pool with the qos_reservation, qos_weight and qos_limit pool options.
+OPTION(osd_op_queue_mclock_client_op_res, OPT_DOUBLE, 1000.0)
+OPTION(osd_op_queue_mclock_client_op_wgt, OPT_DOUBLE, 500.0)
+OPTION(osd_op_queue_mclock_client_op_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_osd_subop_res, OPT_DOUBLE, 1000.0)
+OPTION(osd_op_queue_mclock_osd_subop_wgt, OPT_DOUBLE, 500.0)
+OPTION(osd_op_queue_mclock_osd_subop_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_snap_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_snap_wgt, OPT_DOUBLE, 1.0)
+OPTION(osd_op_queue_mclock_snap_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_recov_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_recov_wgt, OPT_DOUBLE, 1.0)
+OPTION(osd_op_queue_mclock_recov_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_scrub_res, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_scrub_wgt, OPT_DOUBLE, 1.0)
+OPTION(osd_op_queue_mclock_scrub_lim, OPT_DOUBLE, 0.0)
+OPTION(osd_op_queue_mclock_cost_unit, OPT_U32, 0) // bytes of op cost counted as one op (0 = every op counts as one)
+OPTION(osd_op_fast_read, OPT_BOOL, true) // answer single-op reads and stats of head objects on replicated pools without a full op context
 
 // Set to true for testing.  Users should NOT set this.
 // If set to true even after reading enough shards to
 // decode the object, any error will be reported.
 OPTION(osd_read_ec_check_for_errors, OPT_BOOL, false) // return error if any ec shard has an error
+OPTION(osd_ec_parity_delta_writes, OPT_BOOL, false) // small overwrites on ec overwrite pools read and write only the touched data and the coding shards
+OPTION(osd_ec_stripe_cache_size, OPT_U64, 1 << 20) // bytes of recently written stripes each ec overwrite pg primary keeps for later partial overwrites
 
 // Only use clone_overlap for recovery if there are fewer than
 // osd_recover_clone_overlap_limit entries in the overlap set
@@ -763,6 +800,11 @@ OPTION(osd_heartbeat_use_min_delay_socket, OPT_BOOL, false) // prio the heartbea
 
 // max number of parallel snap trims/pg
 OPTION(osd_pg_max_concurrent_snap_trims, OPT_U64, 2)
+OPTION(osd_snap_trim_batch_objects, OPT_U64, 16) // clones trimmed per transaction and replication round trip
+OPTION(osd_snap_trim_adaptive, OPT_BOOL, false) // shrink snap trim batches when client op queue latency rises
+OPTION(osd_snap_trim_adaptive_target_latency, OPT_DOUBLE, .005) // seconds a client op should wait in the op queue
+OPTION(osd_snap_trim_adaptive_tolerance, OPT_DOUBLE, .2)  // relative dead band around the target
+OPTION(osd_snap_trim_adaptive_min_scale, OPT_DOUBLE, .1) // never shrink snap trim batches below this fraction
 
 // minimum number of peers that must be reachable to mark ourselves
 // back up after being wrongly marked down.
@@ -788,6 +830,13 @@ OPTION(osd_copyfrom_max_chunk, OPT_U64, 8<<20)   // max size of a COPYFROM chunk
 OPTION(osd_push_per_object_cost, OPT_U64, 1000)  // push cost per object
 OPTION(osd_max_push_cost, OPT_U64, 8<<20)  // max size of push message
 OPTION(osd_max_push_objects, OPT_U64, 10)  // max objects in single push op
+// backfill packs up to osd_max_push_objects objects of at most this size
+// (and without omap) into a single recovery op; 0 to disable
+OPTION(osd_recovery_small_object_size, OPT_U64, 64<<10)
+OPTION(osd_recovery_adaptive, OPT_BOOL, false) // scale osd_recovery_max_active from client op queue latency
+OPTION(osd_recovery_adaptive_target_latency, OPT_DOUBLE, .005) // seconds a client op should wait in the op queue
+OPTION(osd_recovery_adaptive_tolerance, OPT_DOUBLE, .2)  // relative dead band around the target
+OPTION(osd_recovery_adaptive_min_scale, OPT_DOUBLE, .1) // never shrink recovery below this fraction
 OPTION(osd_recovery_forget_lost_objects, OPT_BOOL, false)   // off for now
 OPTION(osd_max_scrubs, OPT_INT, 1)
 OPTION(osd_scrub_during_recovery, OPT_BOOL, false) // Allow new scrubs to start while recovery is active on the OSD
@@ -806,6 +855,11 @@ OPTION(osd_deep_scrub_interval, OPT_FLOAT, 60*60*24*7) // once a week
 OPTION(osd_deep_scrub_randomize_ratio, OPT_FLOAT, 0.15) // scrubs will randomly become deep scrubs at this rate (0.15 -> 15% of scrubs are deep)
 OPTION(osd_deep_scrub_stride, OPT_INT, 524288)
 OPTION(osd_deep_scrub_update_digest_min_age, OPT_INT, 2*60*60)   // objects must be this old (seconds) before we update the whole-object digest on scrub
+// on stores that checksum their data (bluestore), have deep scrub ask the
+// store to verify its checksums instead of reading and hashing object data.
+// replicated pools then do not compare data digests between replicas.
+OPTION(osd_deep_scrub_csum_only, OPT_BOOL, false)
+OPTION(osd_deep_scrub_max_bytes_per_sec, OPT_U64, 0) // osd-wide deep scrub read budget, 0 = unlimited
 OPTION(osd_scan_list_ping_tp_interval, OPT_U64, 100)
 OPTION(osd_class_dir, OPT_STR, CEPH_LIBDIR "/rados-classes") // where rados plugins are stored
 OPTION(osd_open_classes_on_start, OPT_BOOL, true)
@@ -854,6 +908,9 @@ OPTION(osd_failsafe_nearfull_ratio, OPT_FLOAT, .90) // what % full makes an OSD
 OPTION(osd_fast_fail_on_connection_refused, OPT_BOOL, true) // immediately mark OSDs as down once they refuse to accept connections
 
 OPTION(osd_pg_object_context_cache_count, OPT_INT, 64)
+OPTION(osd_pg_object_context_enoent_cache_count, OPT_INT, 0) // remembered lookups of objects that do not exist; 0 (default) disables
+OPTION(osd_pg_object_context_pin_count, OPT_INT, 8) // hot object contexts kept regardless of LRU order
+OPTION(osd_pg_object_context_pin_hits, OPT_INT, 64) // cache hits that make an object context hot; 0 disables pinning
 OPTION(osd_tracing, OPT_BOOL, false) // true if LTTng-UST tracepoints should be enabled
 
 OPTION(osd_fast_info, OPT_BOOL, true) // use fast info attr, if we can
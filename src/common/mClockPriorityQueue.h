@@ -0,0 +1,435 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef MCLOCK_PRIORITY_QUEUE_H
+#define MCLOCK_PRIORITY_QUEUE_H
+
+#include "OpQueue.h"
+#include "common/Formatter.h"
+#include "common/ceph_time.h"
+#include "include/assert.h"
+
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+
+/**
+ * Quality of service settings of one mClock client.
+ *
+ * reservation and limit are rates in ops per second, 0 meaning no
+ * reservation and no limit respectively; weight is the client's share
+ * of whatever capacity is left once all reservations are met.
+ */
+struct mClockClientInfo {
+  double reservation;
+  double weight;
+  double limit;
+
+  mClockClientInfo(double r = 0, double w = 1, double l = 0)
+    : reservation(r), weight(w), limit(l) {}
+};
+
+/**
+ * OpQueue scheduling by mClock tags (Gulati et al., OSDI'10).
+ *
+ * Every client has its own FIFO.  The request at the head of each FIFO
+ * carries three tags, derived from the previous request's tags and the
+ * client's settings: a reservation tag advancing at 1/reservation, a
+ * proportional tag advancing at 1/weight and a limit tag advancing at
+ * 1/limit.  dequeue() first serves the smallest reservation tag that is
+ * due, and otherwise the smallest proportional tag among the clients
+ * that are under their limit.  Requests served in the second phase do
+ * not count against the client's reservation.
+ *
+ * Tags are computed only when a request reaches the head of its FIFO,
+ * which keeps enqueue and dequeue O(log clients).  Proportional tags of
+ * clients becoming active again start from the virtual time of the last
+ * request served by weight, so an idle client neither banks credit nor
+ * has to catch up with busy ones.
+ *
+ * Strict items bypass the tags and are served first, highest priority
+ * first, as in the other OpQueue implementations.
+ *
+ * When every backlogged client is at its limit dequeue() still returns
+ * the request with the earliest limit tag; callers that want limits to
+ * be hard should check ready_in() first.
+ */
+template <typename T, typename K>
+class mClockQueue : public OpQueue <T, K>
+{
+public:
+  typedef std::function<mClockClientInfo(const K&)> client_info_func;
+  typedef std::function<double()> clock_func;
+
+private:
+  struct Request {
+    T item;
+    unsigned cost;
+    double arrival;
+    Request(T& i, unsigned c, double a) : item(i), cost(c), arrival(a) {}
+  };
+
+  struct Client;
+  typedef std::pair<double, Client*> TagRef;
+  typedef std::set<TagRef> TagSet;
+
+  struct Client {
+    const K key;
+    mClockClientInfo info;
+    std::deque<Request> requests;
+    // tags of the last request served; a new client's first request is
+    // tagged with its arrival time
+    double prev_r = std::numeric_limits<double>::lowest();
+    double prev_p = std::numeric_limits<double>::lowest();
+    double prev_l = std::numeric_limits<double>::lowest();
+    // tags of requests.front(), valid while the client is active
+    double r = 0, p = 0, l = 0;
+    bool limited = false;
+    double idle_since = 0;
+    explicit Client(const K& k) : key(k) {}
+  };
+
+  typedef std::map<K, Client> Clients;
+
+  static double max_tag() {
+    return std::numeric_limits<double>::max();
+  }
+
+  client_info_func client_info_f;
+  clock_func clock_f;
+  unsigned cost_unit;
+  double idle_age;
+  double last_prune = 0;
+
+  std::map<unsigned, std::list<std::pair<K, T> > > strict;
+  unsigned strict_size = 0;
+
+  Clients clients;
+  unsigned size = 0;
+  /// clients with a reservation, by reservation tag
+  TagSet by_reservation;
+  /// clients under their limit, by proportional tag
+  TagSet ready;
+  /// clients at their limit, by limit tag
+  TagSet limited;
+  /// proportional tag of the last request served by weight
+  double vtime = 0;
+
+  static double now_mono() {
+    return std::chrono::duration<double>(
+      ceph::mono_clock::now().time_since_epoch()).count();
+  }
+
+  double units(unsigned cost) const {
+    if (!cost_unit || cost <= cost_unit)
+      return 1.0;
+    return (double)cost / cost_unit;
+  }
+
+  void activate(Client& c, double now) {
+    assert(!c.requests.empty());
+    const Request& head = c.requests.front();
+    double u = units(head.cost);
+    const mClockClientInfo& info = c.info;
+    c.r = info.reservation > 0 ?
+      std::max(c.prev_r + u / info.reservation, head.arrival) : max_tag();
+    c.p = std::max(c.prev_p + u / info.weight, vtime);
+    c.l = info.limit > 0 ?
+      std::max(c.prev_l + u / info.limit, head.arrival) : 0;
+    if (info.reservation > 0)
+      by_reservation.insert(TagRef(c.r, &c));
+    c.limited = c.l > now;
+    if (c.limited)
+      limited.insert(TagRef(c.l, &c));
+    else
+      ready.insert(TagRef(c.p, &c));
+  }
+
+  void deactivate(Client& c) {
+    if (c.info.reservation > 0)
+      by_reservation.erase(TagRef(c.r, &c));
+    if (c.limited)
+      limited.erase(TagRef(c.l, &c));
+    else
+      ready.erase(TagRef(c.p, &c));
+  }
+
+  void promote(double now) {
+    while (!limited.empty() && limited.begin()->first <= now) {
+      Client *c = limited.begin()->second;
+      limited.erase(limited.begin());
+      c->limited = false;
+      ready.insert(TagRef(c->p, c));
+    }
+  }
+
+  void insert(const K& cl, unsigned cost, T& item, bool front) {
+    double now = clock_f();
+    auto i = clients.find(cl);
+    if (i == clients.end()) {
+      i = clients.emplace(std::piecewise_construct,
+			  std::forward_as_tuple(cl),
+			  std::forward_as_tuple(cl)).first;
+    }
+    Client& c = i->second;
+    if (c.requests.empty()) {
+      // pick up settings changed while the client was idle
+      c.info = get_info(cl);
+      c.requests.emplace_back(item, cost, now);
+      activate(c, now);
+    } else if (front) {
+      deactivate(c);
+      c.requests.emplace_front(item, cost, c.requests.front().arrival);
+      activate(c, now);
+    } else {
+      c.requests.emplace_back(item, cost, now);
+    }
+    ++size;
+  }
+
+  mClockClientInfo get_info(const K& cl) const {
+    mClockClientInfo info = client_info_f(cl);
+    if (info.weight <= 0)
+      info.weight = 1;
+    return info;
+  }
+
+  T pop(Client& c, bool by_weight, double now) {
+    deactivate(c);
+    Request& head = c.requests.front();
+    T ret = head.item;
+    if (!by_weight)
+      c.prev_r = c.r;
+    else
+      vtime = std::max(vtime, c.p);
+    c.prev_p = c.p;
+    if (c.info.limit > 0)
+      c.prev_l = c.l;
+    c.requests.pop_front();
+    --size;
+    if (c.requests.empty())
+      c.idle_since = now;
+    else
+      activate(c, now);
+    return ret;
+  }
+
+  void prune(double now) {
+    if (now - last_prune < idle_age / 2)
+      return;
+    last_prune = now;
+    for (auto i = clients.begin(); i != clients.end(); ) {
+      if (i->second.requests.empty() &&
+	  now - i->second.idle_since > idle_age) {
+	i = clients.erase(i);
+      } else {
+	++i;
+      }
+    }
+  }
+
+  /// drop the elements of c matching f, visiting them back to front
+  template <typename C, typename F>
+  static unsigned filter_reverse(C& c, F&& f) {
+    unsigned n = 0;
+    C kept;
+    for (auto i = c.rbegin(); i != c.rend(); ++i) {
+      if (f(*i))
+	++n;
+      else
+	kept.push_front(std::move(*i));
+    }
+    c.swap(kept);
+    return n;
+  }
+
+  template <typename F>
+  void filter_clients(F&& f) {
+    double now = clock_f();
+    for (auto& i : clients) {
+      Client& c = i.second;
+      if (c.requests.empty())
+	continue;
+      deactivate(c);
+      size -= f(c);
+      if (c.requests.empty())
+	c.idle_since = now;
+      else
+	activate(c, now);
+    }
+  }
+
+public:
+  /**
+   * @param info_f looks up the settings of a client; consulted whenever
+   *               the client becomes active
+   * @param cost_unit op cost counted as a single op against the rates,
+   *                  0 to count every op as one regardless of its cost
+   * @param idle_age seconds after which an idle client's state is dropped
+   * @param clock_f  time source in seconds, monotonic clock by default
+   */
+  mClockQueue(client_info_func info_f, unsigned cost_unit = 0,
+	      double idle_age = 300, clock_func clock_f = clock_func())
+    : client_info_f(info_f),
+      clock_f(clock_f ? clock_f : clock_func(&now_mono)),
+      cost_unit(cost_unit),
+      idle_age(idle_age) {}
+
+  unsigned length() const override final {
+    return strict_size + size;
+  }
+
+  bool empty() const override final {
+    return !length();
+  }
+
+  /// f sees the items back to front, the order Pred-style callers expect
+  void remove_by_filter(std::function<bool (T)> f) override final {
+    filter_clients([&f](Client& c) {
+	return filter_reverse(c.requests,
+			      [&f](Request& r) { return f(r.item); });
+      });
+    for (auto p = strict.begin(); p != strict.end(); ) {
+      strict_size -= filter_reverse(
+	p->second, [&f](std::pair<K, T>& i) { return f(i.second); });
+      if (p->second.empty())
+	p = strict.erase(p);
+      else
+	++p;
+    }
+  }
+
+  /// remove the requests of every client matching f, in queue order
+  void remove_by_key_filter(std::function<bool (const K&)> f,
+			    std::list<T> *out) {
+    for (auto p = strict.rbegin(); p != strict.rend(); ++p) {
+      for (auto i = p->second.begin(); i != p->second.end(); ) {
+	if (f(i->first)) {
+	  if (out)
+	    out->push_back(i->second);
+	  i = p->second.erase(i);
+	  --strict_size;
+	} else {
+	  ++i;
+	}
+      }
+    }
+    for (auto p = strict.begin(); p != strict.end(); ) {
+      if (p->second.empty())
+	p = strict.erase(p);
+      else
+	++p;
+    }
+    filter_clients([&f, out](Client& c) {
+	if (!f(c.key))
+	  return 0u;
+	unsigned n = c.requests.size();
+	if (out) {
+	  for (auto& r : c.requests)
+	    out->push_back(r.item);
+	}
+	c.requests.clear();
+	return n;
+      });
+  }
+
+  void remove_by_class(K cl, std::list<T> *out = 0) override final {
+    remove_by_key_filter([&cl](const K& k) { return k == cl; }, out);
+  }
+
+  void enqueue_strict(K cl, unsigned priority, T item) override final {
+    strict[priority].push_back(std::make_pair(cl, item));
+    ++strict_size;
+  }
+
+  void enqueue_strict_front(K cl, unsigned priority, T item) override final {
+    strict[priority].push_front(std::make_pair(cl, item));
+    ++strict_size;
+  }
+
+  void enqueue(K cl, unsigned priority, unsigned cost, T item) override final {
+    insert(cl, cost, item, false);
+  }
+
+  void enqueue_front(K cl, unsigned priority, unsigned cost, T item) override final {
+    insert(cl, cost, item, true);
+  }
+
+  /**
+   * Seconds until dequeue() can return an item without exceeding a
+   * client's limit; 0 if it can right away (or the queue is empty).
+   */
+  double ready_in() const override final {
+    if (strict_size || !size || !ready.empty())
+      return 0;
+    double now = clock_f();
+    double next = max_tag();
+    if (!limited.empty())
+      next = limited.begin()->first;
+    if (!by_reservation.empty())
+      next = std::min(next, by_reservation.begin()->first);
+    return next > now ? next - now : 0;
+  }
+
+  T dequeue() override final {
+    assert(!empty());
+    if (strict_size) {
+      auto p = --strict.end();
+      T ret = p->second.front().second;
+      p->second.pop_front();
+      if (p->second.empty())
+	strict.erase(p);
+      --strict_size;
+      return ret;
+    }
+
+    double now = clock_f();
+    prune(now);
+    promote(now);
+    if (!by_reservation.empty() && by_reservation.begin()->first <= now)
+      return pop(*by_reservation.begin()->second, false, now);
+    if (!ready.empty())
+      return pop(*ready.begin()->second, true, now);
+    // everyone is at their limit; serve the one that gets there first
+    Client *c = limited.begin()->second;
+    return pop(*c, true, now);
+  }
+
+  void dump(ceph::Formatter *f) const override final {
+    f->dump_int("strict_size", strict_size);
+    f->dump_int("size", size);
+    f->dump_float("virtual_time", vtime);
+    f->open_array_section("clients");
+    for (auto& i : clients) {
+      const Client& c = i.second;
+      if (c.requests.empty())
+	continue;
+      f->open_object_section("client");
+      std::ostringstream key;
+      key << c.key;
+      f->dump_string("key", key.str());
+      f->dump_int("queued", c.requests.size());
+      f->dump_float("reservation_tag", c.r);
+      f->dump_float("proportion_tag", c.p);
+      f->dump_float("limit_tag", c.l);
+      f->dump_bool("limited", c.limited);
+      f->close_section();
+    }
+    f->close_section();
+  }
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include <map>
 #include <utility>
 #include <string>
+#include <vector>
 #include <errno.h>
 
 #include "include/Context.h"
@@ -69,6 +70,26 @@ public:
     pair<K, V> *next    ///< [out] first key after key
     ) = 0; ///< @return 0 on success, -ENOENT if there is no next
 
+  /// Returns up to max keys after key, in order
+  virtual int get_next_n(
+    const K &key,                  ///< [in] key after which to get
+    unsigned max,                  ///< [in] max keys to get
+    std::vector<pair<K, V> > *out  ///< [out] keys after key (appended)
+    ) {
+    K pos = key;
+    for (unsigned i = 0; i < max; ++i) {
+      pair<K, V> next;
+      int r = get_next(pos, &next);
+      if (r == -ENOENT)
+	break;
+      if (r < 0)
+	return r;
+      pos = next.first;
+      out->push_back(std::move(next));
+    }
+    return 0;
+  } ///< @return error value, 0 on success
+
   virtual ~StoreDriver() {}
 };
 
@@ -130,6 +151,54 @@ public:
     return -EINVAL;
   } ///< @return error value, 0 on success, -ENOENT if no more entries
 
+  /**
+   * Fetch up to max key/value pairs after key
+   *
+   * Like repeated get_next(), but reads the store with range scans
+   * rather than one lookup per key.  Fewer than max are returned only
+   * if there are no more keys.
+   */
+  int get_next_n(
+    K key,                        ///< [in] key after which to get
+    unsigned max,                 ///< [in] max keys to get
+    std::vector<pair<K, V> > *out ///< [out] next keys (appended)
+    ) {
+    assert(max > 0);
+    unsigned got = 0;
+    while (true) {
+      std::vector<pair<K, V> > stored;
+      int r = driver->get_next_n(key, max, &stored);
+      if (r < 0)
+	return r;
+
+      // the store is only known up to its last key unless it ran out;
+      // overlay unstable keys up to there
+      bool exhausted = stored.size() < max;
+      std::map<K, V> merged(stored.begin(), stored.end());
+      K pos = key;
+      pair<K, boost::optional<V> > cached;
+      while (in_progress.get_next(pos, &cached) &&
+	     (exhausted || cached.first <= stored.back().first)) {
+	if (cached.second)
+	  merged[cached.first] = cached.second.get();
+	else
+	  merged.erase(cached.first);
+	pos = cached.first;
+      }
+
+      for (auto& i : merged) {
+	if (got == max)
+	  break;
+	out->push_back(i);
+	++got;
+      }
+      if (got == max || exhausted)
+	return got ? 0 : -ENOENT;
+      // keys we read are being removed; carry on past them
+      key = stored.back().first;
+    }
+  } ///< @return error value, 0 on success, -ENOENT if no more entries
+
   /// Adds operation setting keys to Transaction
   void set_keys(
     const map<K, V> &keys,  ///< [in] keys/values to set
@@ -77,6 +77,13 @@ public:
     contents.erase(i);
   }
 
+  void clear() {
+    Mutex::Locker l(lock);
+    contents.clear();
+    lru.clear();
+    pinned.clear();
+  }
+
   void set_size(size_t new_size) {
     Mutex::Locker l(lock);
     max_size = new_size;
@@ -60,16 +60,45 @@ int ErasureCode::minimum_to_decode(const set<int> &want_to_read,
   return 0;
 }
 
+/*
+ * Let minimum_to_decode choose among the cheapest chunks first, then
+ * among those of the next cost, and so on, and keep the choice that
+ * costs the least overall.  When all the chunks cost the same this is
+ * exactly minimum_to_decode.
+ */
 int ErasureCode::minimum_to_decode_with_cost(const set<int> &want_to_read,
                                              const map<int, int> &available,
                                              set<int> *minimum)
 {
-  set <int> available_chunks;
+  map<int, set<int> > by_cost;
   for (map<int, int>::const_iterator i = available.begin();
        i != available.end();
        ++i)
-    available_chunks.insert(i->first);
-  return minimum_to_decode(want_to_read, available_chunks, minimum);
+    by_cost[i->second].insert(i->first);
+
+  set <int> available_chunks;
+  set<int> best;
+  int best_cost = -1;
+  for (map<int, set<int> >::iterator i = by_cost.begin();
+       i != by_cost.end();
+       ++i) {
+    available_chunks.insert(i->second.begin(), i->second.end());
+    set<int> candidate;
+    if (minimum_to_decode(want_to_read, available_chunks, &candidate) < 0)
+      continue;
+    int cost = 0;
+    for (set<int>::iterator j = candidate.begin(); j != candidate.end(); ++j)
+      cost += available.find(*j)->second;
+    if (best_cost < 0 || cost < best_cost ||
+	(cost == best_cost && candidate.size() < best.size())) {
+      best.swap(candidate);
+      best_cost = cost;
+    }
+  }
+  if (best_cost < 0)
+    return minimum_to_decode(want_to_read, available_chunks, minimum);
+  minimum->swap(best);
+  return 0;
 }
 
 int ErasureCode::encode_prepare(const bufferlist &raw,
@@ -132,7 +161,67 @@ int ErasureCode::encode_chunks(const set<int> &want_to_encode,
 {
   assert("ErasureCode::encode_chunks not implemented" == 0);
 }
- 
+
+/*
+ * Generic parity delta for linear codes: the coding chunks of a stripe
+ * holding the deltas and zeroes elsewhere are what must be XORed into
+ * the old coding chunks.  Plugins with a cheaper way to do it override
+ * this.
+ */
+int ErasureCode::encode_delta(const map<int, bufferlist> &delta,
+                              map<int, bufferlist> *parity)
+{
+  if (!supports_parity_delta())
+    return -EOPNOTSUPP;
+  assert(!delta.empty());
+  unsigned int k = get_data_chunk_count();
+  unsigned int m = get_chunk_count() - k;
+  unsigned blocksize = delta.begin()->second.length();
+
+  map<int, bufferlist> encoded;
+  for (unsigned int i = 0; i < k; i++) {
+    bufferlist &chunk = encoded[chunk_index(i)];
+    map<int, bufferlist>::const_iterator d = delta.find(chunk_index(i));
+    if (d != delta.end()) {
+      assert(d->second.length() == blocksize);
+      chunk = d->second;
+      chunk.rebuild_aligned_size_and_memory(blocksize, SIMD_ALIGN);
+    } else {
+      bufferptr buf(buffer::create_aligned(blocksize, SIMD_ALIGN));
+      buf.zero();
+      chunk.push_back(std::move(buf));
+    }
+  }
+  set<int> want;
+  for (unsigned int i = k; i < k + m; i++) {
+    encoded[chunk_index(i)].push_back(
+      buffer::create_aligned(blocksize, SIMD_ALIGN));
+    want.insert(chunk_index(i));
+  }
+  int r = encode_chunks(want, &encoded);
+  if (r)
+    return r;
+
+  for (map<int, bufferlist>::iterator i = parity->begin();
+       i != parity->end();
+       ++i) {
+    assert(want.count(i->first));
+    assert(i->second.length() == blocksize);
+    bufferptr out(buffer::create_aligned(blocksize, SIMD_ALIGN));
+    i->second.copy(0, blocksize, out.c_str());
+    const char *p = encoded[i->first].c_str();
+    char *o = out.c_str();
+    unsigned j = 0;
+    for (; j + sizeof(uint64_t) <= blocksize; j += sizeof(uint64_t))
+      *(uint64_t*)(o + j) ^= *(const uint64_t*)(p + j);
+    for (; j < blocksize; j++)
+      o[j] ^= p[j];
+    i->second.clear();
+    i->second.push_back(std::move(out));
+  }
+  return 0;
+}
+
 int ErasureCode::decode(const set<int> &want_to_read,
                         const map<int, bufferlist> &chunks,
                         map<int, bufferlist> *decoded)
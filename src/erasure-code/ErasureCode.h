@@ -70,6 +70,13 @@ namespace ceph {
     virtual int encode_chunks(const set<int> &want_to_encode,
                               map<int, bufferlist> *encoded);
 
+    virtual bool supports_parity_delta() const {
+      return false;
+    }
+
+    virtual int encode_delta(const map<int, bufferlist> &delta,
+                             map<int, bufferlist> *parity);
+
     virtual int decode(const set<int> &want_to_read,
                        const map<int, bufferlist> &chunks,
                        map<int, bufferlist> *decoded);
@@ -359,6 +359,34 @@ namespace ceph {
     virtual int encode_chunks(const set<int> &want_to_encode,
                               map<int, bufferlist> *encoded) = 0;
 
+    /**
+     * Return true if the code is linear, i.e. if the coding chunks
+     * of the XOR of two sets of data chunks are the XOR of their
+     * coding chunks. The coding chunks of a linear code can be
+     * brought up to date after some data chunks changed with
+     * **encode_delta**, without the other data chunks.
+     *
+     * @return **true** if **encode_delta** is supported
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Update the coding chunks in **parity** for a change to some of
+     * the data chunks. **delta** maps the index of each data chunk
+     * that changed to the XOR of its old and new content; data chunks
+     * missing from **delta** are unchanged. **parity** maps coding
+     * chunk indexes to their old content and is updated in place.
+     *
+     * All buffers in **delta** and **parity** must have the same
+     * size, which must be a valid chunk size for the code.
+     *
+     * @param [in] delta map data chunk indexes to old XOR new content
+     * @param [in,out] parity map coding chunk indexes to chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int encode_delta(const map<int, bufferlist> &delta,
+                             map<int, bufferlist> *parity) = 0;
+
     /**
      * Decode the **chunks** and store at least **want_to_read**
      * chunks in **decoded**.
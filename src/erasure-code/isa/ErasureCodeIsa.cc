@@ -157,6 +157,54 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::encode_delta(const map<int, bufferlist> &delta,
+                                    map<int, bufferlist> *parity)
+{
+  // ec_encode_data_update needs every coding chunk
+  if (!chunk_mapping.empty() || parity->size() != (unsigned)m)
+    return ErasureCode::encode_delta(delta, parity);
+
+  unsigned blocksize = delta.begin()->second.length();
+  char *coding[m];
+  for (int i = 0; i < m; i++) {
+    assert(parity->count(k + i));
+    bufferlist &chunk = (*parity)[k + i];
+    assert(chunk.length() == blocksize);
+    // the old content may be shared, update a private copy
+    bufferptr buf(buffer::create_aligned(blocksize, EC_ISA_ADDRESS_ALIGNMENT));
+    chunk.copy(0, blocksize, buf.c_str());
+    chunk.clear();
+    chunk.push_back(std::move(buf));
+    coding[i] = chunk.c_str();
+  }
+  for (map<int, bufferlist>::const_iterator i = delta.begin();
+       i != delta.end();
+       ++i) {
+    assert(i->first < k);
+    assert(i->second.length() == blocksize);
+    bufferlist d = i->second;
+    d.rebuild_aligned(EC_ISA_ADDRESS_ALIGNMENT);
+    if (m == 1) {
+      // single parity stripe
+      unsigned words = blocksize / EC_ISA_VECTOR_OP_WORDSIZE;
+      unsigned aligned = words * EC_ISA_VECTOR_OP_WORDSIZE;
+      vector_op_t *src = (vector_op_t*) d.c_str();
+      vector_xor(src, (vector_op_t*) coding[0], src + words);
+      byte_xor((unsigned char*) d.c_str() + aligned,
+               (unsigned char*) coding[0] + aligned,
+               (unsigned char*) d.c_str() + blocksize);
+    } else {
+      ec_encode_data_update(blocksize, k, m, i->first, encode_tbls,
+                            (unsigned char*)d.c_str(),
+                            (unsigned char**)coding);
+    }
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
@@ -148,6 +148,14 @@ public:
                           char **coding,
                           int blocksize);
 
+  virtual bool supports_parity_delta() const
+  {
+    return true;
+  }
+
+  virtual int encode_delta(const map<int, bufferlist> &delta,
+                           map<int, bufferlist> *parity);
+
   virtual bool erasure_contains(int *erasures, int i);
 
   virtual int isa_decode(int *erasures,
@@ -105,6 +105,10 @@ public:
       free(matrix);
   }
 
+  virtual bool supports_parity_delta() const {
+    return true;
+  }
+
   virtual void jerasure_encode(char **data,
                                char **coding,
                                int blocksize);
@@ -144,6 +144,7 @@ namespace mempool {
   f(buffer_meta)		      \
   f(buffer_data)		      \
   f(osd)			      \
+  f(osd_pglog)			      \
   f(bluestore_meta_onode)	      \
   f(bluestore_meta_other)	      \
   f(bluestore_alloc)		      \
@@ -382,7 +383,12 @@ public:
 	     typename h=std::hash<k>,					\
 	     typename eq = std::equal_to<k>>				\
     using unordered_map =						\
-      std::unordered_map<k,v,h,eq,pool_allocator<std::pair<k,v>>>;	\
+      std::unordered_map<k,v,h,eq,pool_allocator<std::pair<const k,v>>>; \
+    template<typename k, typename v,					\
+	     typename h=std::hash<k>,					\
+	     typename eq = std::equal_to<k>>				\
+    using unordered_multimap =						\
+      std::unordered_multimap<k,v,h,eq,pool_allocator<std::pair<const k,v>>>; \
     inline size_t allocated_bytes() {					\
       return mempool::get_pool(id).allocated_bytes();			\
     }									\
@@ -361,19 +361,7 @@ void MDRequestImpl::_dump(Formatter *f) const
       f->dump_string("op_type", "no_available_op_found");
     }
   }
-  {
-    f->open_array_section("events");
-    Mutex::Locker l(lock);
-    for (list<pair<utime_t, string> >::const_iterator i = events.begin();
-         i != events.end();
-         ++i) {
-      f->open_object_section("event");
-      f->dump_stream("time") << i->first;
-      f->dump_string("event", i->second);
-      f->close_section();
-    }
-    f->close_section(); // events
-  }
+  dump_events(f);
 }
 
 void MDRequestImpl::_dump_op_descriptor_unlocked(ostream& stream) const
@@ -108,16 +108,7 @@ private:
 
   void _dump(Formatter *f) const {
     {
-      f->open_array_section("events");
-      Mutex::Locker l(lock);
-      for (list<pair<utime_t,string> >::const_iterator i = events.begin();
-           i != events.end(); ++i) {
-        f->open_object_section("event");
-        f->dump_stream("time") << i->first;
-        f->dump_string("event", i->second);
-        f->close_section();
-      }
-      f->close_section();
+      dump_events(f);
       f->open_object_section("info");
       f->dump_int("seq", seq);
       f->dump_bool("src_is_mon", is_src_mon());
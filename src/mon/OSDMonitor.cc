@@ -2624,6 +2624,22 @@ MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
   m->oldest_map = get_first_committed();
   m->newest_map = osdmap.get_epoch();
 
+  if (to == osdmap.get_epoch()) {
+    // most subscribers ask for the tail of the map history; let them share
+    // a single encoding of it
+    if (inc_msg_encode_cache_epoch != m->newest_map ||
+	inc_msg_encode_cache_first != m->oldest_map ||
+	inc_msg_encode_cache.size() >= 32) {
+      inc_msg_encode_cache.clear();
+      inc_msg_encode_cache_epoch = m->newest_map;
+      inc_msg_encode_cache_first = m->oldest_map;
+    }
+    Message::EncodeCacheRef& c = inc_msg_encode_cache[from];
+    if (!c)
+      c = std::make_shared<Message::EncodeCache>();
+    m->set_encode_cache(c);
+  }
+
   for (epoch_t e = to; e >= from && e > 0; e--) {
     bufferlist bl;
     int err = get_version(e, bl);
@@ -3182,7 +3198,8 @@ namespace {
     RECOVERY_PRIORITY, RECOVERY_OP_PRIORITY, SCRUB_PRIORITY,
     COMPRESSION_MODE, COMPRESSION_ALGORITHM, COMPRESSION_REQUIRED_RATIO,
     COMPRESSION_MAX_BLOB_SIZE, COMPRESSION_MIN_BLOB_SIZE,
-    CSUM_TYPE, CSUM_MAX_BLOCK, CSUM_MIN_BLOCK };
+    CSUM_TYPE, CSUM_MAX_BLOCK, CSUM_MIN_BLOCK,
+    QOS_RESERVATION, QOS_WEIGHT, QOS_LIMIT };
 
   std::set<osd_pool_get_choices>
     subtract_second_from_first(const std::set<osd_pool_get_choices>& first,
@@ -3687,6 +3704,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
       {"csum_type", CSUM_TYPE},
       {"csum_max_block", CSUM_MAX_BLOCK},
       {"csum_min_block", CSUM_MIN_BLOCK},
+      {"qos_reservation", QOS_RESERVATION},
+      {"qos_weight", QOS_WEIGHT},
+      {"qos_limit", QOS_LIMIT},
     };
 
     typedef std::set<osd_pool_get_choices> choices_set_t;
@@ -3801,7 +3821,7 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	    break;
 	  case HIT_SET_FPP:
 	    {
-	      if (p->hit_set_params.get_type() == HitSet::TYPE_BLOOM) {
+	      if (HitSet::is_bloom_type(p->hit_set_params.get_type())) {
 		BloomHitSet::Params *bloomp =
 		  static_cast<BloomHitSet::Params*>(p->hit_set_params.impl.get());
 		f->dump_float("hit_set_fpp", bloomp->get_fpp());
@@ -3883,6 +3903,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case CSUM_TYPE:
 	  case CSUM_MAX_BLOCK:
 	  case CSUM_MIN_BLOCK:
+	  case QOS_RESERVATION:
+	  case QOS_WEIGHT:
+	  case QOS_LIMIT:
 	    for (i = ALL_CHOICES.begin(); i != ALL_CHOICES.end(); ++i) {
 	      if (i->second == *it)
 		break;
@@ -3941,7 +3964,7 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	    break;
 	  case HIT_SET_FPP:
 	    {
-	      if (p->hit_set_params.get_type() == HitSet::TYPE_BLOOM) {
+	      if (HitSet::is_bloom_type(p->hit_set_params.get_type())) {
 		BloomHitSet::Params *bloomp =
 		  static_cast<BloomHitSet::Params*>(p->hit_set_params.impl.get());
 		ss << "hit_set_fpp: " << bloomp->get_fpp() << "\n";
@@ -4032,6 +4055,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case CSUM_TYPE:
 	  case CSUM_MAX_BLOCK:
 	  case CSUM_MIN_BLOCK:
+	  case QOS_RESERVATION:
+	  case QOS_WEIGHT:
+	  case QOS_LIMIT:
 	    for (i = ALL_CHOICES.begin(); i != ALL_CHOICES.end(); ++i) {
 	      if (i->second == *it)
 		break;
@@ -5351,9 +5377,18 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       int err = check_cluster_features(CEPH_FEATURE_OSD_CACHEPOOL, ss);
       if (err)
 	return err;
-      if (val == "bloom") {
+      if (val == "bloom" || val == "blocked_bloom") {
+	// older OSDs would build plain bloom HitSets for the pool, but
+	// could not read the blocked ones that newer OSDs archived
+	if (val == "blocked_bloom" &&
+	    !osdmap.test_flag(CEPH_OSDMAP_REQUIRE_KRAKEN)) {
+	  ss << "blocked_bloom hit sets require all OSDs to be upgraded; "
+	     << "set require_kraken_osds first";
+	  return -EPERM;
+	}
 	BloomHitSet::Params *bsp = new BloomHitSet::Params;
 	bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
+	bsp->blocked = (val == "blocked_bloom");
 	p.hit_set_params = HitSet::Params(bsp);
       } else if (val == "explicit_hash")
 	p.hit_set_params = HitSet::Params(new ExplicitHashHitSet::Params);
@@ -5381,7 +5416,7 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
       ss << "error parsing floating point value '" << val << "': " << floaterr;
       return -EINVAL;
     }
-    if (p.hit_set_params.get_type() != HitSet::TYPE_BLOOM) {
+    if (!HitSet::is_bloom_type(p.hit_set_params.get_type())) {
       ss << "hit set is not of type Bloom; invalid to set a false positive rate!";
       return -EINVAL;
     }
@@ -5555,6 +5590,17 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
         ss << "error parsing int value '" << val << "': " << interr;
         return -EINVAL;
       }
+    } else if (var == "qos_reservation" ||
+               var == "qos_weight" ||
+               var == "qos_limit") {
+      if (floaterr.length()) {
+        ss << "error parsing float value '" << val << "': " << floaterr;
+        return -EINVAL;
+      }
+      if (f < 0) {
+        ss << var << " must be non-negative: '" << val << "'";
+        return -EINVAL;
+      }
     }
 
     pool_opts_t::opt_desc_t desc = pool_opts_t::get_opt_desc(var);
@@ -7803,9 +7849,14 @@ done:
       goto reply;
     }
     HitSet::Params hsp;
-    if (g_conf->osd_tier_default_cache_hit_set_type == "bloom") {
+    if (g_conf->osd_tier_default_cache_hit_set_type == "bloom" ||
+	g_conf->osd_tier_default_cache_hit_set_type == "blocked_bloom") {
       BloomHitSet::Params *bsp = new BloomHitSet::Params;
       bsp->set_fpp(g_conf->osd_pool_default_hit_set_bloom_fpp);
+      // fall back to plain bloom until every OSD can read blocked ones
+      bsp->blocked =
+	g_conf->osd_tier_default_cache_hit_set_type == "blocked_bloom" &&
+	osdmap.test_flag(CEPH_OSDMAP_REQUIRE_KRAKEN);
       hsp = HitSet::Params(bsp);
     } else if (g_conf->osd_tier_default_cache_hit_set_type == "explicit_hash") {
       hsp = HitSet::Params(new ExplicitHashHitSet::Params);
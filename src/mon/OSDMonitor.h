@@ -127,6 +127,12 @@ private:
   SimpleLRU<version_t, bufferlist> inc_osd_cache;
   SimpleLRU<version_t, bufferlist> full_osd_cache;
 
+  // encoded MOSDMap payloads for ranges ending at the current epoch, shared
+  // by every subscriber that gets the same range.  reset on each new epoch.
+  map<epoch_t, Message::EncodeCacheRef> inc_msg_encode_cache;
+  epoch_t inc_msg_encode_cache_epoch = 0;
+  version_t inc_msg_encode_cache_first = 0;
+
   bool check_failures(utime_t now);
   bool check_failure(utime_t now, int target_osd, failure_info_t& fi);
   void force_failure(utime_t now, int target_osd);
@@ -191,16 +191,22 @@ void Message::encode(uint64_t features, int crcflags)
   // encode and copy out of *m
   if (empty_payload()) {
     assert(middle.length() == 0);
-    encode_payload(features);
+    if (!encode_cache ||
+	!encode_cache->lookup(features, header, payload, middle)) {
+      encode_payload(features);
+
+      // if the encoder didn't specify past compatibility, we assume it
+      // is incompatible.
+      if (header.compat_version == 0)
+	header.compat_version = header.version;
+
+      if (encode_cache)
+	encode_cache->add(features, header, payload, middle);
+    }
 
     if (byte_throttler) {
       byte_throttler->take(payload.length() + middle.length());
     }
-
-    // if the encoder didn't specify past compatibility, we assume it
-    // is incompatible.
-    if (header.compat_version == 0)
-      header.compat_version = header.version;
   }
   if (crcflags & MSG_CRC_HEADER)
     calc_front_crc();
@@ -16,6 +16,8 @@
 #define CEPH_MESSAGE_H
  
 #include <stdlib.h>
+#include <map>
+#include <memory>
 #include <ostream>
 
 #include <boost/intrusive_ptr.hpp>
@@ -248,6 +250,53 @@ public:
 				     bi::list_member_hook<>,
 				     &Message::dispatch_q > > Queue;
 
+  /**
+   * Encoded payloads shared by messages with identical content.
+   *
+   * A sender that fans the same logical message out to many peers can
+   * attach one EncodeCache to every copy. The first encode() for a given
+   * feature set runs encode_payload() and stashes the result; later copies
+   * encoded with the same features reuse the buffers and only rebuild
+   * the header and footer. Only usable for messages whose encode_payload()
+   * leaves the data section alone.
+   */
+  class EncodeCache {
+    struct Encoded {
+      bufferlist payload;
+      bufferlist middle;
+      __u16 version;
+      __u16 compat_version;
+    };
+    Mutex lock;
+    std::map<uint64_t, Encoded> encoded; // by features
+
+  public:
+    EncodeCache() : lock("Message::EncodeCache::lock") {}
+
+    bool lookup(uint64_t features, ceph_msg_header &h,
+		bufferlist &payload, bufferlist &middle) {
+      Mutex::Locker l(lock);
+      auto p = encoded.find(features);
+      if (p == encoded.end())
+	return false;
+      payload = p->second.payload;
+      middle = p->second.middle;
+      h.version = p->second.version;
+      h.compat_version = p->second.compat_version;
+      return true;
+    }
+    void add(uint64_t features, const ceph_msg_header &h,
+	     const bufferlist &payload, const bufferlist &middle) {
+      Mutex::Locker l(lock);
+      Encoded &e = encoded[features];
+      e.payload = payload;
+      e.middle = middle;
+      e.version = h.version;
+      e.compat_version = h.compat_version;
+    }
+  };
+  typedef std::shared_ptr<EncodeCache> EncodeCacheRef;
+
 protected:
   CompletionHook* completion_hook = nullptr; // owned by Messenger
 
@@ -265,6 +314,8 @@ protected:
   // currently throttled.
   uint64_t dispatch_throttle_size = 0;
 
+  EncodeCacheRef encode_cache;
+
   friend class Messenger;
 
 public:
@@ -328,6 +379,10 @@ public:
    * functions are throttling-aware as appropriate.
    */
 
+  void set_encode_cache(const EncodeCacheRef& c) {
+    encode_cache = c;
+  }
+
   void clear_payload() {
     if (byte_throttler) {
       byte_throttler->put(payload.length() + middle.length());
@@ -158,11 +158,105 @@ Infiniband::Infiniband(CephContext *cct, const std::string &device_name, uint8_t
                                      cct->_conf->ms_async_rdma_enable_hugepage);
   memory_manager->register_rx_tx(
       cct->_conf->ms_async_rdma_buffer_size, max_recv_wr, max_send_wr);
+  if (cct->_conf->ms_async_rdma_reg_cache_bytes) {
+    ldout(cct, 1) << __func__ << " zero copy send enabled, registration cache "
+                  << cct->_conf->ms_async_rdma_reg_cache_bytes << " bytes" << dendl;
+    memory_manager->enable_reg_cache(cct, cct->_conf->ms_async_rdma_reg_cache_bytes);
+  }
 
   srq = create_shared_receive_queue(max_recv_wr, MAX_SHARED_RX_SGE_COUNT);
   post_channel_cluster();
 }
 
+Infiniband::MemoryManager::RegCache::~RegCache()
+{
+  for (auto &p : entries) {
+    assert(p.second->refs == 0);
+    assert(ibv_dereg_mr(p.second->mr) == 0);
+    delete p.second;
+  }
+}
+
+/**
+ * Find or create the memory region covering the raw buffer behind `bp`
+ * and pin it.
+ *
+ * \return
+ *      A pinned entry, or NULL if the buffer can't be registered within
+ *      the cache budget. The caller should copy the data in that case.
+ */
+Infiniband::MemoryManager::RegCache::Entry* Infiniband::MemoryManager::RegCache::get(const bufferptr& bp)
+{
+  const char *raw = bp.raw_c_str();
+  uint64_t len = bp.raw_length();
+  Mutex::Locker l(lock);
+  auto it = entries.find(raw);
+  if (it != entries.end()) {
+    // the entry holds a reference on the raw buffer, so the address can't
+    // have been recycled for another buffer in the meantime.
+    Entry *e = it->second;
+    if (e->refs++ == 0)
+      lru.erase(e->lru_pos);
+    return e;
+  }
+
+  if (len > max_bytes)
+    return nullptr;
+  if (bytes + len > max_bytes) {
+    trim(max_bytes - len);
+    if (bytes + len > max_bytes)
+      return nullptr;
+  }
+
+  ibv_mr *mr = ibv_reg_mr(pd->pd, const_cast<char*>(raw), len, 0);
+  if (!mr) {
+    ldout(cct, 1) << __func__ << " failed to register " << len << " bytes: "
+                  << cpp_strerror(errno) << dendl;
+    return nullptr;
+  }
+  Entry *e = new Entry;
+  e->raw = bp;
+  e->raw.set_offset(0);
+  e->raw.set_length(len);
+  e->mr = mr;
+  e->refs = 1;
+  entries[raw] = e;
+  bytes += len;
+  ldout(cct, 20) << __func__ << " registered " << (void*)raw << "~" << len
+                 << ", cache now " << bytes << " bytes" << dendl;
+  return e;
+}
+
+void Infiniband::MemoryManager::RegCache::put(Entry *e)
+{
+  Mutex::Locker l(lock);
+  assert(e->refs > 0);
+  if (--e->refs == 0) {
+    lru.push_front(e);
+    e->lru_pos = lru.begin();
+    trim(max_bytes);
+  }
+}
+
+void Infiniband::MemoryManager::RegCache::trim(uint64_t target)
+{
+  assert(lock.is_locked());
+  while (bytes > target && !lru.empty())
+    evict(lru.back());
+}
+
+void Infiniband::MemoryManager::RegCache::evict(Entry *e)
+{
+  assert(lock.is_locked());
+  assert(e->refs == 0);
+  lru.erase(e->lru_pos);
+  entries.erase(e->raw.raw_c_str());
+  bytes -= e->raw.length();
+  int r = ibv_dereg_mr(e->mr);
+  assert(r == 0);
+  delete e;
+}
+
 /**
  * Create a shared receive queue. This basically wraps the verbs call. 
  *
@@ -19,11 +19,15 @@
 
 #include <infiniband/verbs.h>
 
+#include <list>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "include/int_types.h"
 #include "include/page.h"
+#include "include/buffer.h"
+#include "include/unordered_set.h"
 #include "common/debug.h"
 #include "common/errno.h"
 #include "msg/msg_types.h"
@@ -148,9 +152,6 @@ class Infiniband {
     class Chunk {
      public:
       Chunk(char* b, uint32_t len, ibv_mr* m) : buffer(b), bytes(len), offset(0), mr(m) {}
-      ~Chunk() {
-        assert(ibv_dereg_mr(mr) == 0);
-      }
 
       void set_offset(uint32_t o) {
         offset = o;
@@ -234,6 +235,11 @@ class Infiniband {
       uint64_t owner;
     };
 
+    // A Cluster is one contiguous slab carved into fixed size chunks. The
+    // whole slab is registered with a single memory region so the HCA only
+    // has to track one translation entry per cluster instead of one per
+    // chunk, and the chunk descriptors live in one array so that ownership
+    // checks on the completion path are a range compare.
     class Cluster {
      public:
       Cluster(MemoryManager& m, uint32_t s) : manager(m), chunk_size(s), lock("cluster_lock"){}
@@ -242,31 +248,33 @@ class Infiniband {
       }
 
       ~Cluster() {
-        set<Chunk*>::iterator c = all_chunks.begin();
-        while(c != all_chunks.end()) {
-          delete *c;
-          ++c;
-        }
+        if (mr)
+          assert(ibv_dereg_mr(mr) == 0);
+        for (Chunk *c = chunk_base; c != chunk_end; ++c)
+          c->~Chunk();
+        ::free(chunk_base);
         if (manager.enabled_huge_page)
           manager.free_huge_pages(base);
         else
-          delete base;
+          ::free(base);
       }
       int add(uint32_t num) {
+        assert(base == nullptr);
         uint32_t bytes = chunk_size * num;
-        //cihar* base = (char*)malloc(bytes);
         if (manager.enabled_huge_page) {
           base = (char*)manager.malloc_huge_pages(bytes);
         } else {
           base = (char*)memalign(CEPH_PAGE_SIZE, bytes);
         }
         assert(base);
-        for (uint32_t offset = 0; offset < bytes; offset += chunk_size){
-          ibv_mr* m = ibv_reg_mr(manager.pd->pd, base+offset, chunk_size, IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_LOCAL_WRITE);
-          assert(m);
-          Chunk* c = new Chunk(base+offset,chunk_size,m);
+        mr = ibv_reg_mr(manager.pd->pd, base, bytes, IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_LOCAL_WRITE);
+        assert(mr);
+        chunk_base = static_cast<Chunk*>(::malloc(sizeof(Chunk) * num));
+        assert(chunk_base);
+        chunk_end = chunk_base;
+        for (uint32_t offset = 0; offset < bytes; offset += chunk_size) {
+          Chunk* c = new (chunk_end++) Chunk(base+offset, chunk_size, mr);
           free_chunks.push_back(c);
-          all_chunks.insert(c);
         }
         return 0;
       }
@@ -299,15 +307,77 @@ class Infiniband {
         }
         return r;
       }
+
+      bool is_my_chunk(const Chunk* c) const {
+        return c >= chunk_base && c < chunk_end;
+      }
+
       MemoryManager& manager;
       uint32_t chunk_size;
       Mutex lock;
       std::vector<Chunk*> free_chunks;
-      std::set<Chunk*> all_chunks;
-      char* base;
+      char* base = nullptr;
+      ibv_mr* mr = nullptr;
+      Chunk* chunk_base = nullptr;
+      Chunk* chunk_end = nullptr;
+    };
+
+    // Registration cache for buffers handed down from the upper layers.
+    // Large bufferptrs are sent straight from their own memory instead of
+    // being copied into the tx cluster; registering memory is expensive, so
+    // the memory region of each raw buffer is kept around (LRU, bounded by
+    // ms_async_rdma_reg_cache_bytes) and reused by later sends of the same
+    // buffer. Each entry holds a reference on its raw buffer, so the
+    // registered pages can never be freed and recycled behind our back.
+    class RegCache {
+     public:
+      struct Entry {
+        bufferptr raw;
+        ibv_mr* mr = nullptr;
+        uint32_t refs = 0;
+        std::list<Entry*>::iterator lru_pos;
+      };
+
+      RegCache(CephContext *c, ProtectionDomain *p, uint64_t max)
+        : cct(c), pd(p), lock("RegCache::lock"), max_bytes(max) {}
+      ~RegCache();
+
+      Entry* get(const bufferptr& bp);
+      void pin(Entry *e) {
+        Mutex::Locker l(lock);
+        ++e->refs;
+      }
+      void put(Entry *e);
+
+     private:
+      void trim(uint64_t target);
+      void evict(Entry *e);
+
+      CephContext *cct;
+      ProtectionDomain *pd;
+      Mutex lock;
+      std::map<const char*, Entry*> entries; // keyed by raw buffer address
+      std::list<Entry*> lru;                 // unpinned entries, MRU first
+      uint64_t bytes = 0;
+      uint64_t max_bytes;
     };
 
-    MemoryManager(Device *d, ProtectionDomain *p, bool hugepage): device(d), pd(p) {
+    // A send work request posted from a registered upper layer buffer.
+    // Like every other send it holds a tx chunk until it completes, which
+    // stands in for its send queue slot: the tx pool has max_send_wr chunks,
+    // so zero copy sends can't overflow the send queue either.
+    class ZeroCopyChunk : public Chunk {
+     public:
+      ZeroCopyChunk(const char* b, uint32_t len, RegCache::Entry *e, Chunk *c)
+        : Chunk(const_cast<char*>(b), len, e->mr), entry(e), credit(c) {
+        set_offset(len);
+      }
+      RegCache::Entry *entry;
+      Chunk *credit;
+    };
+
+    MemoryManager(Device *d, ProtectionDomain *p, bool hugepage)
+      : device(d), pd(p), zc_lock("MemoryManager::zc_lock") {
       enabled_huge_page = hugepage;
     }
     ~MemoryManager() {
@@ -315,6 +385,8 @@ class Infiniband {
         delete channel;
       if (send)
         delete send;
+      if (reg_cache)
+        delete reg_cache;
     }
     void* malloc_huge_pages(size_t size) {
       size_t real_size = ALIGN_TO_PAGE_SIZE(size + HUGE_PAGE_SIZE);
@@ -346,6 +418,10 @@ class Infiniband {
       send = new Cluster(*this, size);
       send->add(tx_num);
     }
+    void enable_reg_cache(CephContext *cct, uint64_t max_bytes) {
+      assert(!reg_cache);
+      reg_cache = new RegCache(cct, pd, max_bytes);
+    }
     void return_tx(std::vector<Chunk*> &chunks) {
       for (auto c : chunks) {
         c->clear();
@@ -361,14 +437,47 @@ class Infiniband {
       return channel->get_buffers(chunks, bytes);
     }
 
-    int is_tx_chunk(Chunk* c) { return send->all_chunks.count(c);}
-    int is_rx_chunk(Chunk* c) { return channel->all_chunks.count(c);}
+    uint32_t get_buffer_size() const { return send->chunk_size; }
+    RegCache* get_reg_cache() { return reg_cache; }
+
+    Chunk* get_zero_copy_chunk(RegCache::Entry *e, const char *data, uint32_t len,
+                               Chunk *credit) {
+      reg_cache->pin(e);
+      Chunk *c = new ZeroCopyChunk(data, len, e, credit);
+      Mutex::Locker l(zc_lock);
+      zc_chunks.insert(c);
+      return c;
+    }
+    /// unpin and free a zero copy chunk, \return the tx chunk it held
+    Chunk* put_zero_copy_chunk(Chunk *c) {
+      {
+        Mutex::Locker l(zc_lock);
+        zc_chunks.erase(c);
+      }
+      ZeroCopyChunk *zc = static_cast<ZeroCopyChunk*>(c);
+      Chunk *credit = zc->credit;
+      reg_cache->put(zc->entry);
+      delete zc;
+      return credit;
+    }
+
+    int is_tx_chunk(Chunk* c) { return send->is_my_chunk(c); }
+    int is_rx_chunk(Chunk* c) { return channel->is_my_chunk(c); }
+    bool is_zero_copy_chunk(Chunk* c) {
+      if (!reg_cache)
+        return false;
+      Mutex::Locker l(zc_lock);
+      return zc_chunks.count(c);
+    }
     bool enabled_huge_page;
    private:
-    Cluster* channel;//RECV
-    Cluster* send;// SEND
+    Cluster* channel = nullptr;//RECV
+    Cluster* send = nullptr;// SEND
     Device *device;
     ProtectionDomain *pd;
+    RegCache* reg_cache = nullptr;
+    Mutex zc_lock;
+    ceph::unordered_set<Chunk*> zc_chunks; // zero-copy sends in flight
   };
 
  private:
@@ -567,6 +676,7 @@ class Infiniband {
  public:
   typedef MemoryManager::Cluster Cluster;
   typedef MemoryManager::Chunk Chunk;
+  typedef MemoryManager::RegCache RegCache;
   QueuePair* create_queue_pair(CephContext *c, CompletionQueue*, CompletionQueue*, ibv_qp_type type);
   ibv_srq* create_shared_receive_queue(uint32_t max_wr, uint32_t max_sge);
   int post_chunk(Chunk* chunk);
@@ -595,6 +705,11 @@ class Infiniband {
       v.push_back(c);
       memory_manager->return_tx(v);  
       return 2;
+    } else if (memory_manager->is_zero_copy_chunk(c)) {
+      vector<Chunk*> v;
+      v.push_back(memory_manager->put_zero_copy_chunk(c));
+      memory_manager->return_tx(v);
+      return 3;
     }
     return -1;
   }
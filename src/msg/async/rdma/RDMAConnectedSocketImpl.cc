@@ -347,15 +347,71 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   if (!bytes)
     return 0;
 
-  int ret = worker->reserve_message_buffer(this, tx_buffers, bytes);
+  // large buffers are sent in place out of the registration cache, only the
+  // rest needs to be copied into tx chunks.  every work request takes a tx
+  // chunk though (zero copy ones just hold it), which keeps what we post
+  // within the send queue.
+  Infiniband::MemoryManager *mm = infiniband->get_memory_manager();
+  RegCache *reg_cache = mm->get_reg_cache();
+  uint32_t seg = mm->get_buffer_size();
+  std::vector<RegCache::Entry*> zero_copy;
+  size_t want = bytes;
+  if (reg_cache) {
+    want = 0;
+    for (auto &p : pending_bl.buffers()) {
+      RegCache::Entry *e = nullptr;
+      if (p.length() >= cct->_conf->ms_async_rdma_zero_copy_min_bytes)
+        e = reg_cache->get(p);
+      if (e) {
+        // its segments, plus the partly filled chunk flushed ahead of it
+        want += ((p.length() + seg - 1) / seg + 1) * seg;
+      } else {
+        want += p.length();
+      }
+      zero_copy.push_back(e);
+    }
+  }
+
+  int ret = worker->reserve_message_buffer(this, tx_buffers, want);
   if (ret == 0) {
     ldout(cct, 10) << __func__ << " no enough buffers in worker " << worker << dendl;
+    for (auto e : zero_copy)
+      if (e)
+        reg_cache->put(e);
     return -EAGAIN; // that is ok , cause send will return bytes. == 0 enough buffers, < 0 no buffer, >0 not enough
   }
+  // work requests in wire order, tx chunks and zero copy chunks interleaved
+  std::vector<Chunk*> wrs;
   vector<Chunk*>::iterator current_buffer = tx_buffers.begin();
   list<bufferptr>::const_iterator it = pending_bl.buffers().begin();
+  unsigned idx = 0;
   unsigned total = 0;
   while (it != pending_bl.buffers().end()) {
+    RegCache::Entry *e = zero_copy.empty() ? nullptr : zero_copy[idx];
+    if (e) {
+      // flush the partially filled chunk first to keep the byte order
+      if (current_buffer != tx_buffers.end() && (*current_buffer)->get_offset()) {
+        wrs.push_back(*current_buffer);
+        ++current_buffer;
+      }
+      unsigned off = 0;
+      while (off < it->length() && current_buffer != tx_buffers.end()) {
+        uint32_t len = MIN(seg, it->length() - off);
+        wrs.push_back(mm->get_zero_copy_chunk(e, it->c_str() + off, len,
+                                              *current_buffer));
+        ++current_buffer;
+        off += len;
+      }
+      reg_cache->put(e);
+      total += off;
+      if (off < it->length())
+        goto sending; // out of send credits, the rest stays pending
+      ++it;
+      ++idx;
+      continue;
+    }
+    if (current_buffer == tx_buffers.end())
+      break;
     const uintptr_t addr = reinterpret_cast<const uintptr_t>(it->c_str());
     unsigned copied = 0;
     while (copied < it->length()) {
@@ -363,15 +419,30 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
       copied += r;
       total += r;
       if ((*current_buffer)->full()){
+        wrs.push_back(*current_buffer);
         ++current_buffer;
         if (current_buffer == tx_buffers.end())
           goto sending;
       }
     }
     ++it;
+    ++idx;
+  }
+  if (current_buffer != tx_buffers.end() && (*current_buffer)->get_offset()) {
+    wrs.push_back(*current_buffer);
+    ++current_buffer;
   }
 
  sending:
+  // drop the pins of zero copy buffers we didn't get to
+  for (++idx; idx < zero_copy.size(); ++idx)
+    if (zero_copy[idx])
+      reg_cache->put(zero_copy[idx]);
+  if (current_buffer != tx_buffers.end()) {
+    std::vector<Chunk*> unused(current_buffer, tx_buffers.end());
+    worker->get_stack()->get_dispatcher()->inflight -= unused.size();
+    mm->return_tx(unused);
+  }
   assert(total <= pending_bl.length());
   bufferlist swapped;
   if (total < pending_bl.length()) {
@@ -384,7 +455,9 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   ldout(cct, 20) << __func__ << " left bytes: " << pending_bl.length() << " in buffers "
                  << pending_bl.buffers().size() << dendl;
 
-  int r = post_work_request(tx_buffers);
+  if (wrs.empty())
+    return -EAGAIN;
+  int r = post_work_request(wrs);
   if (r < 0)
     return r;
 
@@ -430,12 +503,26 @@ int RDMAConnectedSocketImpl::post_work_request(std::vector<Chunk*> &tx_buffers)
     ++current_buffer;
   }
 
-  ibv_send_wr *bad_tx_work_request;
-  if (ibv_post_send(qp->get_qp(), iswr, &bad_tx_work_request)) {
+  ibv_send_wr *bad_tx_work_request = NULL;
+  int r = ibv_post_send(qp->get_qp(), iswr, &bad_tx_work_request);
+  if (r) {
     lderr(cct) << __func__ << " failed to send data"
                << " (most probably should be peer not ready): "
-               << cpp_strerror(errno) << dendl;
-    return -errno;
+               << cpp_strerror(r) << dendl;
+    // nothing from the bad work request on was queued, so none of it will
+    // complete: give the chunks back and unpin the zero copy buffers
+    Infiniband::MemoryManager *mm = infiniband->get_memory_manager();
+    std::vector<Chunk*> unposted;
+    size_t i = bad_tx_work_request ? bad_tx_work_request - iswr : 0;
+    for (; i < tx_buffers.size(); ++i) {
+      Chunk *c = tx_buffers[i];
+      if (mm->is_zero_copy_chunk(c))
+        c = mm->put_zero_copy_chunk(c);
+      unposted.push_back(c);
+    }
+    worker->get_stack()->get_dispatcher()->inflight -= unposted.size();
+    mm->return_tx(unposted);
+    return -r;
   }
   ldout(cct, 20) << __func__ << " qp state is : " << Infiniband::qp_state_string(qp->get_state()) << dendl;
   return 0;
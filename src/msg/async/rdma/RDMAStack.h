@@ -247,6 +247,7 @@ class RDMAWorker : public Worker {
 class RDMAConnectedSocketImpl : public ConnectedSocketImpl {
  public:
   typedef Infiniband::MemoryManager::Chunk Chunk;
+  typedef Infiniband::MemoryManager::RegCache RegCache;
   typedef Infiniband::CompletionChannel CompletionChannel;
   typedef Infiniband::CompletionQueue CompletionQueue;
 
@@ -191,12 +191,25 @@ extern int cls_cxx_map_get_vals(cls_method_context_t hctx,
 extern int cls_cxx_map_read_header(cls_method_context_t hctx, bufferlist *outbl);
 extern int cls_cxx_map_get_val(cls_method_context_t hctx,
                                const string &key, bufferlist *outbl);
+/**
+ * look up several keys with a single omap read
+ *
+ * @param keys keys to look up
+ * @param vals the values of the keys that exist; keys that do not
+ *             exist are left out
+ * @return number of values found, or negative error code
+ */
+extern int cls_cxx_map_get_vals_by_keys(cls_method_context_t hctx,
+                                        const std::set<string> &keys,
+                                        std::map<string, bufferlist> *vals);
 extern int cls_cxx_map_set_val(cls_method_context_t hctx,
                                const string &key, bufferlist *inbl);
 extern int cls_cxx_map_set_vals(cls_method_context_t hctx,
                                 const std::map<string, bufferlist> *map);
 extern int cls_cxx_map_write_header(cls_method_context_t hctx, bufferlist *inbl);
 extern int cls_cxx_map_remove_key(cls_method_context_t hctx, const string &key);
+extern int cls_cxx_map_remove_keys(cls_method_context_t hctx,
+                                   const std::set<string> &keys);
 extern int cls_cxx_map_update(cls_method_context_t hctx, bufferlist *inbl);
 
 extern int cls_cxx_list_watchers(cls_method_context_t hctx,
@@ -1669,6 +1669,30 @@ public:
      return read(c->get_cid(), oid, offset, len, bl, op_flags, allow_eio);
    }
 
+  /**
+   * verify -- check the store's own checksums for a byte range
+   *
+   * Reads the data backing the range from the device (not the cache)
+   * and checks it against the checksums the store keeps for it,
+   * without decompressing or returning it.  Lets deep scrub check the
+   * media without hashing the data a second time.
+   *
+   * @param c collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be verified
+   * @param len number of bytes to be verified
+   * @returns number of bytes verified on success, -EIO on a checksum
+   *          mismatch, -EOPNOTSUPP if the store keeps no checksums, or
+   *          another negative error code on failure.
+   */
+  virtual int verify(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len) {
+    return -EOPNOTSUPP;
+  }
+
   /**
    * fiemap -- get extent map of data of an object
    *
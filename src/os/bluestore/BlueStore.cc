@@ -5282,6 +5282,114 @@ int BlueStore::_do_read(
   return r;
 }
 
+int BlueStore::verify(
+  CollectionHandle &c_,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t length)
+{
+  Collection *c = static_cast<Collection*>(c_.get());
+  dout(15) << __func__ << " " << c->cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+  if (csum_type == Checksummer::CSUM_NONE)
+    return -EOPNOTSUPP;
+
+  int r;
+  {
+    RWLock::RLocker l(c->lock);
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      r = -ENOENT;
+    } else {
+      r = _do_verify(o, offset, length);
+    }
+  }
+  c->trim_cache();
+  if (r >= 0 && _debug_data_eio(oid)) {
+    r = -EIO;
+    derr << __func__ << " " << c->cid << " " << oid << " INJECT EIO" << dendl;
+  }
+  dout(10) << __func__ << " " << c->cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << " = " << r << dendl;
+  return r;
+}
+
+int BlueStore::_do_verify(
+  OnodeRef o,
+  uint64_t offset,
+  size_t length)
+{
+  if (offset >= o->onode.size) {
+    return 0;
+  }
+  if (offset + length > o->onode.size) {
+    length = o->onode.size - offset;
+  }
+
+  o->flush();
+  o->extent_map.fault_range(db, offset, length);
+
+  // collect the csum chunks (or, if compressed, the whole blob) covering
+  // the range.  unlike _do_read we skip the buffer cache: the point is
+  // to check what is on the device.  a blob written without a checksum
+  // (before csums were enabled, or for a pool with csum_type none) can't
+  // be verified this way; the caller has to read it instead.
+  map<BlobRef, interval_set<uint64_t>> blobs2verify;
+  uint64_t end = offset + length;
+  for (auto lp = o->extent_map.seek_lextent(offset);
+       lp != o->extent_map.extent_map.end() && lp->logical_offset < end;
+       ++lp) {
+    const bluestore_blob_t& blob = lp->blob->get_blob();
+    if (!blob.has_csum()) {
+      dout(20) << __func__ << "  blob " << *lp->blob << " has no csum"
+	       << dendl;
+      return -EOPNOTSUPP;
+    }
+    if (blob.has_flag(bluestore_blob_t::FLAG_COMPRESSED)) {
+      blobs2verify[lp->blob].union_insert(0, blob.get_ondisk_length());
+      continue;
+    }
+    uint64_t l_start = MAX(offset, (uint64_t)lp->logical_offset);
+    uint64_t l_end = MIN(end, (uint64_t)lp->logical_end());
+    uint64_t chunk_size = blob.get_chunk_size(block_size);
+    uint64_t b_start = lp->blob_offset + (l_start - lp->logical_offset);
+    uint64_t b_end = b_start + (l_end - l_start);
+    b_start -= b_start % chunk_size;
+    b_end = ROUND_UP_TO(b_end, chunk_size);
+    blobs2verify[lp->blob].union_insert(b_start, b_end - b_start);
+  }
+
+  for (auto& p : blobs2verify) {
+    const bluestore_blob_t& blob = p.first->get_blob();
+    for (auto q = p.second.begin(); q != p.second.end(); ++q) {
+      dout(20) << __func__ << "  blob " << *p.first << std::hex
+	       << " verify 0x" << q.get_start() << "~" << q.get_len()
+	       << std::dec << dendl;
+      IOContext ioc(cct, NULL);
+      bufferlist bl;
+      int r = blob.map(
+	q.get_start(), q.get_len(),
+	[&](uint64_t offset, uint64_t length) {
+	  bufferlist t;
+	  int r = bdev->read(offset, length, &t, &ioc, false);
+	  if (r < 0)
+	    return r;
+	  bl.claim_append(t);
+	  return 0;
+	});
+      if (r < 0)
+	return r;
+      if (_verify_csum(o, &blob, q.get_start(), bl) < 0)
+	return -EIO;
+    }
+  }
+  return length;
+}
+
 int BlueStore::_verify_csum(OnodeRef& o,
 			    const bluestore_blob_t* blob, uint64_t blob_xoffset,
 			    const bufferlist& bl) const
@@ -1824,6 +1824,15 @@ public:
     size_t len,
     bufferlist& bl,
     uint32_t op_flags = 0);
+  int verify(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len) override;
+  int _do_verify(
+    OnodeRef o,
+    uint64_t offset,
+    size_t len);
 
   int fiemap(const coll_t& cid, const ghobject_t& oid,
 	     uint64_t offset, size_t len, bufferlist& bl) override;
@@ -288,6 +288,8 @@ private:
 
     // valid in state READING
     pair<uint64_t, uint64_t> extent_requested;
+    // chunks read, until decoded by decode_recovery_reads
+    map<int, bufferlist> read_chunks;
 
     void dump(Formatter *f) const;
 
@@ -300,6 +302,7 @@ private:
     RecoveryOp &op,
     RecoveryMessages *m);
   void dispatch_recovery_messages(RecoveryMessages &m, int priority);
+  void decode_recovery_reads(RecoveryMessages *m);
   friend struct OnRecoveryReadComplete;
   void handle_recovery_read_complete(
     const hobject_t &hoid,
@@ -467,14 +470,22 @@ public:
     bool invalidates_cache() const { return plan.invalidates_cache; }
 
     // must be true if requires_rmw(), must be false if invalidates_cache()
+    // (or parity_delta)
     bool using_cache = false;
 
+    /// rmw reads only the touched data and the parity chunks, see
+    /// ECTransaction::plan_parity_delta
+    bool parity_delta = false;
+
     /// In progress read state;
     hobject_t::bitwisemap<extent_set> pending_read; // subset already being read
     hobject_t::bitwisemap<extent_set> remote_read;  // subset we must read
     hobject_t::bitwisemap<extent_map> remote_read_result;
+    /// parity_delta reads: per object, shard -> chunk extents
+    hobject_t::bitwisemap<map<int, extent_map> > delta_read_result;
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return !remote_read.empty() && remote_read_result.empty() &&
+	delta_read_result.empty();
     }
 
     /// In progress write state
@@ -559,6 +570,19 @@ public:
   bool try_finish_rmw();
   void check_ops();
 
+  void start_rmw_read(Op *op);
+  bool parity_delta_in_flight(
+    const hobject_t::bitwisemap<extent_set> &to_read) const;
+  set<pg_shard_t> get_parity_delta_shards(const set<int> &delta_chunks) const;
+  bool can_parity_delta(const Op *op);
+  void start_parity_delta_read(Op *op);
+  void handle_parity_delta_read(
+    Op *op,
+    const hobject_t &hoid,
+    bool complete,
+    map<int, extent_map> &&result);
+  friend struct CallParityDeltaRead;
+
   ErasureCodeInterfaceRef ec_impl;
 
 
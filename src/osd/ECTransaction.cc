@@ -82,6 +82,194 @@ void encode_and_write(
   }
 }
 
+/* Overwrite part of the stripes of an object as a parity delta, given
+ * the old content over those stripes of the touched data shards and of
+ * every coding shard.  The untouched data shards are only cloned for
+ * rollback, like every other shard. */
+void write_parity_delta(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const PGTransaction::ObjectOperation &op,
+  const extent_set &stripes,
+  const map<int, extent_map> &old_chunks,
+  pg_log_entry_t *entry,
+  vector<pair<uint64_t, uint64_t> > *rollback_extents,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const unsigned k = ecimpl->get_data_chunk_count();
+  const vector<int> &mapping = ecimpl->get_chunk_mapping();
+
+  map<int, int> shard_to_pos;
+  for (unsigned i = 0; i < ecimpl->get_chunk_count(); ++i) {
+    shard_to_pos[(int)mapping.size() > (int)i ? mapping[i] : i] = i;
+  }
+
+  uint32_t fadvise_flags = 0;
+  extent_map updates;
+  for (auto &&extent: op.buffer_updates) {
+    using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+    bufferlist bl;
+    match(
+      extent.get_val(),
+      [&](const BufferUpdate::Write &op) {
+	bl = op.buffer;
+	fadvise_flags |= op.fadvise_flags;
+      },
+      [&](const BufferUpdate::Zero &) {
+	bl.append_zero(extent.get_len());
+      },
+      [&](const BufferUpdate::CloneRange &) {
+	assert(
+	  0 ==
+	  "CloneRange is not allowed, do_op should have returned ENOTSUPP");
+      });
+    updates.insert(extent.get_off(), extent.get_len(), bl);
+  }
+
+  for (auto &&stripe: stripes) {
+    const uint64_t off = stripe.first;
+    const uint64_t len = stripe.second;
+    assert(sinfo.logical_offset_is_stripe_aligned(off));
+    assert(sinfo.logical_offset_is_stripe_aligned(len));
+    const uint64_t chunk_off = sinfo.aligned_logical_offset_to_chunk_offset(off);
+    const uint64_t chunk_len = sinfo.aligned_logical_offset_to_chunk_offset(len);
+
+    if (entry) {
+      ldpp_dout(dpp, 20) << __func__ << ": overwriting "
+			 << chunk_off << "~" << chunk_len
+			 << dendl;
+      if (rollback_extents->empty()) {
+	for (auto &&st : *transactions) {
+	  st.second.touch(
+	    coll_t(spg_t(pgid, st.first)),
+	    ghobject_t(oid, entry->version.version, st.first));
+	}
+      }
+      rollback_extents->emplace_back(make_pair(chunk_off, chunk_len));
+      for (auto &&st : *transactions) {
+	st.second.clone_range(
+	  coll_t(spg_t(pgid, st.first)),
+	  ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	  ghobject_t(oid, entry->version.version, st.first),
+	  chunk_off,
+	  chunk_len,
+	  chunk_off);
+      }
+    }
+
+    map<int, bufferlist> old_data, new_data, parity;
+    for (auto &&i : old_chunks) {
+      extent_map piece = i.second.intersect(chunk_off, chunk_len);
+      assert(piece.ext_count() == 1);
+      assert(piece.begin().get_off() == chunk_off);
+      assert(piece.begin().get_len() == chunk_len);
+      assert(shard_to_pos.count(i.first));
+      if (shard_to_pos[i.first] < (int)k) {
+	old_data[i.first] = piece.begin().get_val();
+	bufferptr bp(buffer::create(chunk_len));
+	old_data[i.first].copy(0, chunk_len, bp.c_str());
+	new_data[i.first].push_back(std::move(bp));
+      } else {
+	parity[i.first] = piece.begin().get_val();
+      }
+    }
+
+    // lay the new data over the old content of the touched chunks
+    for (auto &&u : updates.intersect(off, len)) {
+      uint64_t pos = u.get_off();
+      const uint64_t end = pos + u.get_len();
+      while (pos < end) {
+	const uint64_t in_stripe = (pos - off) % stripe_width;
+	const uint64_t in_chunk = in_stripe % chunk_size;
+	const uint64_t n = std::min(chunk_size - in_chunk, end - pos);
+	int shard = (int)mapping.size() > (int)(in_stripe / chunk_size) ?
+	  mapping[in_stripe / chunk_size] : in_stripe / chunk_size;
+	assert(new_data.count(shard));
+	u.get_val().copy(
+	  pos - u.get_off(), n,
+	  new_data[shard].c_str() +
+	    ((pos - off) / stripe_width) * chunk_size + in_chunk);
+	pos += n;
+      }
+    }
+
+    int r = ECUtil::encode_delta(sinfo, ecimpl, old_data, new_data, &parity);
+    assert(r == 0);
+
+    for (auto &&st : *transactions) {
+      bufferlist *bl = nullptr;
+      if (new_data.count(st.first))
+	bl = &new_data[st.first];
+      else if (parity.count(st.first))
+	bl = &parity[st.first];
+      else
+	continue;
+      assert(bl->length() == chunk_len);
+      st.second.write(
+	coll_t(spg_t(pgid, st.first)),
+	ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	chunk_off,
+	chunk_len,
+	*bl,
+	fadvise_flags);
+    }
+  }
+}
+
+bool ECTransaction::plan_parity_delta(
+  const ECUtil::stripe_info_t &sinfo,
+  unsigned k,
+  unsigned m,
+  WritePlan &plan,
+  DoutPrefixProvider *dpp) {
+  if (!plan.t || plan.invalidates_cache ||
+      plan.t->op_map.size() != 1 ||
+      plan.to_read.size() != 1 ||
+      plan.will_write.size() != 1)
+    return false;
+
+  const hobject_t &oid = plan.t->op_map.begin()->first;
+  const PGTransaction::ObjectOperation &op = plan.t->op_map.begin()->second;
+  auto to_read = plan.to_read.find(oid);
+  auto will_write = plan.will_write.find(oid);
+  // every stripe written must be read, i.e. no full stripe or append
+  if (to_read == plan.to_read.end() ||
+      will_write == plan.will_write.end() ||
+      !(to_read->second == will_write->second))
+    return false;
+  if (!op.is_none() || op.deletes_first() || op.truncate ||
+      op.has_source() || op.buffer_updates.empty())
+    return false;
+
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  set<int> touched;
+  for (auto &&extent: op.buffer_updates) {
+    uint64_t pos = extent.get_off();
+    const uint64_t end = pos + extent.get_len();
+    while (pos < end && touched.size() < k) {
+      uint64_t in_stripe = pos % stripe_width;
+      touched.insert(in_stripe / chunk_size);
+      pos += chunk_size - in_stripe % chunk_size;
+    }
+  }
+
+  // chunks read and written per stripe, against k read and k + m written
+  if (2 * (touched.size() + m) >= 2 * k + m) {
+    ldpp_dout(dpp, 20) << __func__ << ": " << oid << " touches "
+		       << touched << ", not worth a parity delta" << dendl;
+    return false;
+  }
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid << " touches "
+		     << touched << dendl;
+  plan.delta_chunks[oid] = std::move(touched);
+  return true;
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -102,6 +290,7 @@ void ECTransaction::generate_transactions(
   bool legacy_log_entries,
   const ECUtil::stripe_info_t &sinfo,
   const hobject_t::bitwisemap<extent_map> &partial_extents,
+  const hobject_t::bitwisemap<map<int, extent_map> > &delta_extents,
   vector<pg_log_entry_t> &entries,
   hobject_t::bitwisemap<extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -399,6 +588,31 @@ void ECTransaction::generate_transactions(
       vector<pair<uint64_t, uint64_t> > rollback_extents;
       const uint64_t orig_size = hinfo->get_total_logical_size(sinfo);
 
+      auto dextiter = delta_extents.find(oid);
+      if (dextiter != delta_extents.end()) {
+	assert(to_write.empty());
+	assert(!op.truncate);
+	auto stripes = plan.to_read.find(oid);
+	assert(stripes != plan.to_read.end());
+	ldpp_dout(dpp, 20) << __func__ << ": parity delta over "
+			   << stripes->second
+			   << dendl;
+	write_parity_delta(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  op,
+	  stripes->second,
+	  dextiter->second,
+	  entry,
+	  &rollback_extents,
+	  transactions,
+	  dpp);
+	// nothing left for the whole stripe path below
+	op.buffer_updates.clear();
+      }
+
       uint64_t new_size = orig_size;
       uint64_t append_after = new_size;
       ldpp_dout(dpp, 20) << __func__ << ": new_size start " << new_size << dendl;
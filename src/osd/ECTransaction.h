@@ -30,8 +30,28 @@ namespace ECTransaction {
     hobject_t::bitwisemap<extent_set> will_write; // superset of to_read
 
     hobject_t::bitwisemap<ECUtil::HashInfoRef> hash_infos;
+
+    /* Positions in the stripe of the data chunks touched by the partial
+     * stripe overwrites of each object, when the plan can be carried
+     * out as a parity delta (see plan_parity_delta) */
+    hobject_t::bitwisemap<set<int> > delta_chunks;
   };
 
+  /* A partial stripe overwrite with a linear code only needs the old
+   * content of the data chunks it touches and of the coding chunks:
+   * the coding chunks are updated with the difference between the old
+   * and new data, and the untouched data chunks are left alone.
+   *
+   * Fills in plan.delta_chunks and returns true if the plan is a
+   * single such overwrite and reading and writing only those chunks
+   * moves less data than the whole stripe read-modify-write. */
+  bool plan_parity_delta(
+    const ECUtil::stripe_info_t &sinfo,
+    unsigned k,
+    unsigned m,
+    WritePlan &plan,
+    DoutPrefixProvider *dpp);
+
   bool requires_overwrite(
     uint64_t prev_size,
     const PGTransaction::ObjectOperation &op);
@@ -183,6 +203,7 @@ namespace ECTransaction {
     bool legacy_log_entries,
     const ECUtil::stripe_info_t &sinfo,
     const hobject_t::bitwisemap<extent_map> &partial_extents,
+    const hobject_t::bitwisemap<map<int, extent_map> > &delta_extents,
     vector<pg_log_entry_t> &entries,
     hobject_t::bitwisemap<extent_map> *written,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -106,6 +106,15 @@ int encode(
   const set<int> &want,
   map<int, bufferlist> *out);
 
+/// bring the coding chunks in parity up to date for a change of some
+/// data chunks from old_data to new_data, one stripe at a time
+int encode_delta(
+  const stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ec_impl,
+  const map<int, bufferlist> &old_data,
+  const map<int, bufferlist> &new_data,
+  map<int, bufferlist> *parity);
+
 class HashInfo {
   uint64_t total_chunk_size = 0;
   vector<uint32_t> cumulative_shard_hashes;
@@ -20,6 +20,7 @@ void ExtentCache::extent::_link_pin_state(pin_state &pin_state)
   assert(!parent_pin_state);
   parent_pin_state = &pin_state;
   pin_state.pin_list.push_back(*this);
+  pin_state.bytes += length;
 }
 
 void ExtentCache::extent::_unlink_pin_state()
@@ -28,6 +29,8 @@ void ExtentCache::extent::_unlink_pin_state()
   assert(parent_pin_state);
   auto liter = pin_state::list::s_iterator_to(*this);
   parent_pin_state->pin_list.erase(liter);
+  assert(parent_pin_state->bytes >= length);
+  parent_pin_state->bytes -= length;
   parent_pin_state = nullptr;
 }
 
@@ -216,6 +219,65 @@ void ExtentCache::present_rmw_update(
   }
 }
 
+void ExtentCache::release_write_pin_to_lru(
+  write_pin &pin,
+  uint64_t max_bytes)
+{
+  if (max_bytes == 0) {
+    release_pin(pin);
+    return;
+  }
+  for (auto iter = pin.pin_list.begin(); iter != pin.pin_list.end(); ) {
+    extent *ext = &*iter;
+    iter++; // move will invalidate
+    if (ext->is_pending()) {
+      unique_ptr<extent> owned(ext);
+      auto &eset = *(ext->parent_extent_set);
+      ext->unlink();
+      remove_and_destroy_if_empty(eset);
+    } else {
+      // don't hold on to the (possibly much larger) buffers of the op
+      ext->bl->rebuild();
+      ext->move(lru);
+    }
+  }
+  pin.tid = 0;
+  pin.pin_type = pin_state::NONE;
+  trim_lru(max_bytes);
+}
+
+void ExtentCache::trim_lru(uint64_t max_bytes)
+{
+  while (lru.bytes > max_bytes) {
+    unique_ptr<extent> ext(&lru.pin_list.front());
+    auto &eset = *(ext->parent_extent_set);
+    ext->unlink();
+    remove_and_destroy_if_empty(eset);
+  }
+}
+
+void ExtentCache::drop_unpinned(const hobject_t &oid)
+{
+  object_extent_set *eset = get_if_exists(oid);
+  if (!eset)
+    return;
+  for (auto iter = eset->extent_set.begin();
+       iter != eset->extent_set.end(); ) {
+    extent *ext = &*iter;
+    ++iter; // unlink will invalidate
+    if (ext->is_cached()) {
+      ext->unlink();
+      delete ext;
+    }
+  }
+  remove_and_destroy_if_empty(*eset);
+}
+
+void ExtentCache::drop_unpinned()
+{
+  trim_lru(0);
+}
+
 ostream &ExtentCache::print(ostream &out) const
 {
   out << "ExtentCache(" << std::endl;
@@ -227,9 +289,12 @@ ostream &ExtentCache::print(ostream &out) const
 	 exiter != esiter->extent_set.end();
 	 ++exiter) {
       out << "    Extent(" << exiter->offset
-	  << "~" << exiter->get_length()
-	  << ":" << exiter->pin_tid()
-	  << ")" << std::endl;
+	  << "~" << exiter->get_length();
+      if (exiter->is_cached())
+	out << ":cached";
+      else
+	out << ":" << exiter->pin_tid();
+      out << ")" << std::endl;
     }
   }
   return out << ")" << std::endl;
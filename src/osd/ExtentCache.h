@@ -92,6 +92,19 @@
    All of the above suggests that there are 3 things users can
    ask of the cache corresponding to the 3 Write pipelines
    states.
+
+   Optionally, a write pin may be released into the LRU rather than
+   dropped (release_write_pin_to_lru), adding a state:
+
+   3) Cached:
+      - This extent has the data written by the last write to it,
+        which has completed
+      - No op pins it; it may be evicted at any time
+      - reserve_extents_for_rmw turns it into Write Pinned pin.reqid
+        without a read
+
+   It is up to the user to drop cached extents (drop_unpinned) of
+   objects it modifies without going through the cache.
  */
 
 /// If someone wants these types, but not ExtentCache, move to another file
@@ -151,6 +164,11 @@ private:
       return parent_pin_state->tid;
     }
 
+    bool is_cached() const {
+      assert(parent_pin_state);
+      return parent_pin_state->is_lru();
+    }
+
     extent(uint64_t offset, bufferlist _bl)
       : offset(offset), length(_bl.length()), bl(_bl) {}
 
@@ -351,9 +369,12 @@ private:
     enum pin_type_t {
       NONE,
       WRITE,
+      LRU,
     };
     pin_type_t pin_type = NONE;
     bool is_write() const { return pin_type == WRITE; }
+    bool is_lru() const { return pin_type == LRU; }
+    uint64_t bytes = 0; ///< total length of the extents in pin_list
 
     pin_state(const pin_state &other) = delete;
     pin_state &operator=(const pin_state &other) = delete;
@@ -368,6 +389,7 @@ private:
     list pin_list;
     ~pin_state() {
       assert(pin_list.empty());
+      assert(bytes == 0);
       assert(tid == 0);
       assert(pin_type == NONE);
     }
@@ -392,7 +414,19 @@ private:
     p.pin_type = pin_state::NONE;
   }
 
+  /// owns the Cached extents, least recently used first
+  pin_state lru;
+  void trim_lru(uint64_t max_bytes);
+
 public:
+  ExtentCache() {
+    lru.pin_type = pin_state::LRU;
+  }
+  ~ExtentCache() {
+    drop_unpinned();
+    lru.pin_type = pin_state::NONE;
+  }
+
   class write_pin : private pin_state {
     friend class ExtentCache;
   private:
@@ -482,6 +516,29 @@ public:
     release_pin(pin);
   }
 
+  /**
+   * Release pin, keeping the buffers it held as Cached extents
+   *
+   * Then evicts the least recently used Cached extents until at most
+   * max_bytes of them are left.
+   *
+   * @param pin [in,out] pin of a completed write
+   * @param max_bytes [in] limit on the size of the Cached extents
+   */
+  void release_write_pin_to_lru(
+    write_pin &pin,
+    uint64_t max_bytes);
+
+  /// Drop the Cached extents of oid
+  void drop_unpinned(const hobject_t &oid);
+
+  /// Drop all of the Cached extents
+  void drop_unpinned();
+
+  uint64_t get_cached_bytes() const {
+    return lru.bytes;
+  }
+
   ostream &print(
     ostream &out) const;
 };
@@ -29,6 +29,11 @@ HitSet::HitSet(const HitSet::Params& params)
     }
     break;
 
+  case TYPE_BLOCKED_BLOOM:
+    impl.reset(new BlockedBloomHitSet(
+		 static_cast<BloomHitSet::Params*>(params.impl.get())));
+    break;
+
   case TYPE_EXPLICIT_HASH:
     impl.reset(new ExplicitHashHitSet(static_cast<ExplicitHashHitSet::Params*>(params.impl.get())));
     break;
@@ -71,6 +76,9 @@ void HitSet::decode(bufferlist::iterator &bl)
   case TYPE_BLOOM:
     impl.reset(new BloomHitSet);
     break;
+  case TYPE_BLOCKED_BLOOM:
+    impl.reset(new BlockedBloomHitSet);
+    break;
   case TYPE_NONE:
     impl.reset(NULL);
     break;
@@ -97,6 +105,10 @@ void HitSet::generate_test_instances(list<HitSet*>& o)
   o.back()->insert(hobject_t());
   o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
   o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  o.push_back(new HitSet(new BlockedBloomHitSet(10, .1, 1)));
+  o.back()->insert(hobject_t());
+  o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+  o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
   o.push_back(new HitSet(new ExplicitHashHitSet));
   o.back()->insert(hobject_t());
   o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
@@ -138,7 +150,11 @@ void HitSet::Params::encode(bufferlist &bl) const
 {
   ENCODE_START(1, 1, bl);
   if (impl) {
-    ::encode((__u8)impl->get_type(), bl);
+    // blocked bloom params go out as bloom params (see BloomHitSet::Params)
+    impl_type_t type = impl->get_type();
+    if (type == TYPE_BLOCKED_BLOOM)
+      type = TYPE_BLOOM;
+    ::encode((__u8)type, bl);
     impl->encode(bl);
   } else {
     ::encode((__u8)TYPE_NONE, bl);
@@ -158,6 +174,13 @@ bool HitSet::Params::create_impl(impl_type_t type)
   case TYPE_BLOOM:
     impl.reset(new BloomHitSet::Params);
     break;
+  case TYPE_BLOCKED_BLOOM:
+    {
+      BloomHitSet::Params *p = new BloomHitSet::Params;
+      p->blocked = true;
+      impl.reset(p);
+    }
+    break;
   case TYPE_NONE:
     impl.reset(NULL);
     break;
@@ -239,10 +262,17 @@ void ExplicitObjectHitSet::dump(Formatter *f) const {
   f->close_section();
 }
 
+HitSet::Impl *BloomHitSet::Params::get_new_impl() const {
+  if (blocked)
+    return new BlockedBloomHitSet;
+  return new BloomHitSet;
+}
+
 void BloomHitSet::Params::dump(Formatter *f) const {
   f->dump_float("false_positive_probability", get_fpp());
   f->dump_int("target_size", target_size);
   f->dump_int("seed", seed);
+  f->dump_bool("blocked", blocked);
 }
 
 void BloomHitSet::dump(Formatter *f) const {
@@ -250,3 +280,9 @@ void BloomHitSet::dump(Formatter *f) const {
   bloom.dump(f);
   f->close_section();
 }
+
+void BlockedBloomHitSet::dump(Formatter *f) const {
+  f->open_object_section("blocked_bloom_filter");
+  bloom.dump(f);
+  f->close_section();
+}
@@ -20,6 +20,7 @@
 #include "include/encoding.h"
 #include "include/unordered_set.h"
 #include "common/bloom_filter.hpp"
+#include "common/blocked_bloom_filter.hpp"
 #include "common/hobject.h"
 
 /**
@@ -36,7 +37,8 @@ public:
     TYPE_NONE = 0,
     TYPE_EXPLICIT_HASH = 1,
     TYPE_EXPLICIT_OBJECT = 2,
-    TYPE_BLOOM = 3
+    TYPE_BLOOM = 3,
+    TYPE_BLOCKED_BLOOM = 4
   } impl_type_t;
 
   static const char *get_type_name(impl_type_t t) {
@@ -45,9 +47,14 @@ public:
     case TYPE_EXPLICIT_HASH: return "explicit_hash";
     case TYPE_EXPLICIT_OBJECT: return "explicit_object";
     case TYPE_BLOOM: return "bloom";
+    case TYPE_BLOCKED_BLOOM: return "blocked_bloom";
     default: return "???";
     }
   }
+  /// true if the type is configured with BloomHitSet::Params
+  static bool is_bloom_type(impl_type_t t) {
+    return t == TYPE_BLOOM || t == TYPE_BLOCKED_BLOOM;
+  }
   const char *get_type_name() const {
     if (impl)
       return get_type_name(impl->get_type());
@@ -61,6 +68,8 @@ public:
     virtual bool is_full() const = 0;
     virtual void insert(const hobject_t& o) = 0;
     virtual bool contains(const hobject_t& o) const = 0;
+    /// hint that contains(o) is coming
+    virtual void prefetch(const hobject_t& o) const {}
     virtual unsigned insert_count() const = 0;
     virtual unsigned approx_unique_insert_count() const = 0;
     virtual void encode(bufferlist &bl) const = 0;
@@ -145,6 +154,10 @@ public:
   bool contains(const hobject_t& o) const {
     return impl->contains(o);
   }
+  /// start pulling in what contains(o) will look at
+  void prefetch(const hobject_t& o) const {
+    impl->prefetch(o);
+  }
 
   unsigned insert_count() const {
     return impl->insert_count();
@@ -326,27 +339,34 @@ public:
     return HitSet::TYPE_BLOOM;
   }
 
+  /**
+   * Params for both BloomHitSet and BlockedBloomHitSet
+   *
+   * A blocked bloom pool is described on the wire as TYPE_BLOOM params
+   * with the blocked flag set, so OSDs that predate BlockedBloomHitSet
+   * still decode the pool and simply build plain bloom HitSets.
+   */
   class Params : public HitSet::Params::Impl {
   public:
     HitSet::impl_type_t get_type() const override {
-      return HitSet::TYPE_BLOOM;
-    }
-    HitSet::Impl *get_new_impl() const override {
-      return new BloomHitSet;
+      return blocked ? HitSet::TYPE_BLOCKED_BLOOM : HitSet::TYPE_BLOOM;
     }
+    HitSet::Impl *get_new_impl() const override;
 
     uint32_t fpp_micro;    ///< false positive probability / 1M
     uint64_t target_size;  ///< number of unique insertions we expect to this HitSet
     uint64_t seed;         ///< seed to use when initializing the bloom filter
+    bool blocked;          ///< use a BlockedBloomHitSet
 
     Params()
-      : fpp_micro(0), target_size(0), seed(0) {}
-    Params(double fpp, uint64_t t, uint64_t s)
-      : fpp_micro(fpp * 1000000.0), target_size(t), seed(s) {}
+      : fpp_micro(0), target_size(0), seed(0), blocked(false) {}
+    Params(double fpp, uint64_t t, uint64_t s, bool b = false)
+      : fpp_micro(fpp * 1000000.0), target_size(t), seed(s), blocked(b) {}
     Params(const Params &o)
       : fpp_micro(o.fpp_micro),
 	target_size(o.target_size),
-	seed(o.seed) {}
+	seed(o.seed),
+	blocked(o.blocked) {}
     ~Params() {}
 
     double get_fpp() const {
@@ -357,17 +377,22 @@ public:
     }
 
     void encode(bufferlist& bl) const override {
-      ENCODE_START(1, 1, bl);
+      ENCODE_START(2, 1, bl);
       ::encode(fpp_micro, bl);
       ::encode(target_size, bl);
       ::encode(seed, bl);
+      ::encode(blocked, bl);
       ENCODE_FINISH(bl);
     }
     void decode(bufferlist::iterator& bl) override {
-      DECODE_START(1, bl);
+      DECODE_START(2, bl);
       ::decode(fpp_micro, bl);
       ::decode(target_size, bl);
       ::decode(seed, bl);
+      if (struct_v >= 2)
+	::decode(blocked, bl);
+      else
+	blocked = false;
       DECODE_FINISH(bl);
     }
     void dump(Formatter *f) const override;
@@ -375,6 +400,8 @@ public:
       o << "false_positive_probability: "
 	<< get_fpp() << ", target_size: " << target_size
 	<< ", seed: " << seed;
+      if (blocked)
+	o << ", blocked";
     }
     static void generate_test_instances(list<Params*>& o) {
       o.push_back(new Params);
@@ -382,6 +409,7 @@ public:
       (*o.rbegin())->fpp_micro = 123456;
       (*o.rbegin())->target_size = 300;
       (*o.rbegin())->seed = 99;
+      o.push_back(new Params(.01, 1000, 7, true));
     }
   };
 
@@ -450,4 +478,73 @@ public:
 };
 WRITE_CLASS_ENCODER(BloomHitSet)
 
+/**
+ * use a blocked_bloom_filter to track hits to the set
+ *
+ * Each insert and lookup touches a single cache line of the filter,
+ * which makes it cheaper than BloomHitSet on the op path and in the tier
+ * agent, at the cost of a somewhat larger filter for the same fpp.
+ * Configured with BloomHitSet::Params.
+ */
+class BlockedBloomHitSet : public HitSet::Impl {
+  blocked_bloom_filter bloom;
+
+public:
+  HitSet::impl_type_t get_type() const override {
+    return HitSet::TYPE_BLOCKED_BLOOM;
+  }
+
+  BlockedBloomHitSet() {}
+  BlockedBloomHitSet(unsigned inserts, double fpp, int seed)
+    : bloom(inserts, fpp, seed)
+  {}
+  explicit BlockedBloomHitSet(const BloomHitSet::Params *p)
+    : bloom(p->target_size, p->get_fpp(), p->seed)
+  {}
+
+  HitSet::Impl *clone() const override {
+    return new BlockedBloomHitSet(*this);
+  }
+
+  bool is_full() const override {
+    return bloom.is_full();
+  }
+
+  void insert(const hobject_t& o) override {
+    bloom.insert(o.get_hash());
+  }
+  bool contains(const hobject_t& o) const override {
+    return bloom.contains(o.get_hash());
+  }
+  void prefetch(const hobject_t& o) const override {
+    bloom.prefetch(o.get_hash());
+  }
+  unsigned insert_count() const override {
+    return bloom.element_count();
+  }
+  unsigned approx_unique_insert_count() const override {
+    return bloom.approx_unique_element_count();
+  }
+
+  void encode(bufferlist &bl) const override {
+    ENCODE_START(1, 1, bl);
+    ::encode(bloom, bl);
+    ENCODE_FINISH(bl);
+  }
+  void decode(bufferlist::iterator &bl) override {
+    DECODE_START(1, bl);
+    ::decode(bloom, bl);
+    DECODE_FINISH(bl);
+  }
+  void dump(Formatter *f) const override;
+  static void generate_test_instances(list<BlockedBloomHitSet*>& o) {
+    o.push_back(new BlockedBloomHitSet);
+    o.push_back(new BlockedBloomHitSet(10, .1, 1));
+    o.back()->insert(hobject_t());
+    o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+    o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  }
+};
+WRITE_CLASS_ENCODER(BlockedBloomHitSet)
+
 #endif
@@ -15,6 +15,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <thread>
 #include <errno.h>
 #include <sys/stat.h>
 #include <signal.h>
@@ -176,6 +177,31 @@ void PGQueueable::RunVis::operator()(const PGRecovery &op) {
   return osd->do_recovery(pg.get(), op.epoch_queued, op.reserved_pushes, handle);
 }
 
+osd_op_type_t PGQueueable::get_op_type() const
+{
+  if (boost::get<PGSnapTrim>(&qvariant))
+    return osd_op_type_t::bg_snaptrim;
+  if (boost::get<PGScrub>(&qvariant))
+    return osd_op_type_t::bg_scrub;
+  if (boost::get<PGRecovery>(&qvariant))
+    return osd_op_type_t::bg_recovery;
+  const Message *m = boost::get<OpRequestRef>(qvariant)->get_req();
+  if (m->get_source().is_client())
+    return osd_op_type_t::client_op;
+  switch (m->get_type()) {
+  case MSG_OSD_PG_PUSH:
+  case MSG_OSD_PG_PULL:
+  case MSG_OSD_PG_PUSH_REPLY:
+  case MSG_OSD_PG_SCAN:
+  case MSG_OSD_PG_BACKFILL:
+    return osd_op_type_t::bg_recovery;
+  case MSG_OSD_REP_SCRUB:
+    return osd_op_type_t::bg_scrub;
+  default:
+    return osd_op_type_t::osd_subop;
+  }
+}
+
 //Initial features in new superblock.
 //Features here are also automatically upgraded
 CompatSet OSD::get_osd_initial_compat_set() {
@@ -252,6 +278,8 @@ OSDService::OSDService(OSD *osd) :
   next_notif_id(0),
   backfill_request_lock("OSDService::backfill_request_lock"),
   backfill_request_timer(cct, backfill_request_lock, false),
+  scrub_sleep_lock("OSDService::scrub_sleep_lock"),
+  scrub_sleep_timer(cct, scrub_sleep_lock, false),
   reserver_finisher(cct),
   local_reserver(&reserver_finisher, cct->_conf->osd_max_backfills,
 		 cct->_conf->osd_min_recovery_priority),
@@ -260,6 +288,7 @@ OSDService::OSDService(OSD *osd) :
   pg_temp_lock("OSDService::pg_temp_lock"),
   recovery_lock("OSDService::recovery_lock"),
   recovery_ops_active(0),
+  recovery_batched_active(0),
   recovery_ops_reserved(0),
   recovery_paused(false),
   map_cache_lock("OSDService::map_cache_lock"),
@@ -488,6 +517,10 @@ void OSDService::shutdown()
     Mutex::Locker l(backfill_request_lock);
     backfill_request_timer.shutdown();
   }
+  {
+    Mutex::Locker l(scrub_sleep_lock);
+    scrub_sleep_timer.shutdown();
+  }
   osdmap = OSDMapRef();
   next_osdmap = OSDMapRef();
 }
@@ -1120,6 +1153,30 @@ void OSDService::dec_scrubs_active()
   sched_scrub_lock.Unlock();
 }
 
+void OSDService::charge_deep_scrub(uint64_t bytes)
+{
+  logger->inc(l_osd_scrub_deep_bytes, bytes);
+  uint64_t rate = cct->_conf->osd_deep_scrub_max_bytes_per_sec;
+  if (!rate)
+    return;
+  utime_t now = ceph_clock_now();
+  Mutex::Locker l(sched_scrub_lock);
+  if (deep_scrub_budget_next < now)
+    deep_scrub_budget_next = now;
+  deep_scrub_budget_next += (double)bytes / (double)rate;
+}
+
+utime_t OSDService::get_deep_scrub_wait()
+{
+  if (!cct->_conf->osd_deep_scrub_max_bytes_per_sec)
+    return utime_t();
+  utime_t now = ceph_clock_now();
+  Mutex::Locker l(sched_scrub_lock);
+  if (deep_scrub_budget_next <= now)
+    return utime_t();
+  return deep_scrub_budget_next - now;
+}
+
 void OSDService::retrieve_epochs(epoch_t *_boot_epoch, epoch_t *_up_epoch,
                                  epoch_t *_bind_epoch) const
 {
@@ -1467,6 +1524,23 @@ void OSDService::queue_for_snap_trim(PG *pg) {
 	entity_inst_t())));
 }
 
+void OSDService::update_snap_trim_throttle()
+{
+  if (!snap_trim_throttle)
+    return;
+  snap_trim_throttle->update();
+  snap_trim_batch = MAX(1, (unsigned)(cct->_conf->osd_snap_trim_batch_objects *
+				      snap_trim_throttle->get_scale()));
+}
+
+unsigned OSDService::get_snap_trim_batch() const
+{
+  unsigned n = snap_trim_batch;
+  if (n)
+    return n;
+  return MAX(1, cct->_conf->osd_snap_trim_batch_objects);
+}
+
 
 // ====================================================================
 // OSD
@@ -1671,7 +1745,9 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
   osd_compat(get_osd_compat_set()),
   osd_tp(cct, "OSD::osd_tp", "tp_osd", cct->_conf->osd_op_threads, "osd_op_threads"),
   osd_op_tp(cct, "OSD::osd_op_tp", "tp_osd_tp",
-    cct->_conf->osd_op_num_threads_per_shard * cct->_conf->osd_op_num_shards),
+    (cct->_conf->osd_op_run_to_completion ?
+     1 : cct->_conf->osd_op_num_threads_per_shard) *
+    cct->_conf->osd_op_num_shards),
   disk_tp(cct, "OSD::disk_tp", "tp_osd_disk", cct->_conf->osd_disk_threads, "osd_disk_threads"),
   command_tp(cct, "OSD::command_tp", "tp_osd_cmd",  1),
   session_waiting_lock("OSD::session_waiting_lock"),
@@ -1689,6 +1765,7 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
   test_ops_hook(NULL),
   op_queue(get_io_queue()),
   op_prio_cutoff(get_io_prio_cut()),
+  op_run_to_completion(cct->_conf->osd_op_run_to_completion),
   op_shardedwq(
     cct->_conf->osd_op_num_shards,
     this,
@@ -1882,6 +1959,31 @@ bool OSD::asok_command(string command, cmdmap_t& cmdmap, string format,
     }
 
     f->close_section(); //watchers
+  } else if (command == "dump_object_context_cache") {
+    map<int64_t, obc_cache_stats_t> pools;
+    {
+      Mutex::Locker l(osd_lock);
+      RWLock::RLocker l2(pg_map_lock);
+      for (ceph::unordered_map<spg_t,PG*>::iterator it = pg_map.begin();
+          it != pg_map.end();
+          ++it) {
+        obc_cache_stats_t s;
+        PG *pg = it->second;
+        pg->lock();
+        pg->get_obc_cache_stats(&s);
+        pg->unlock();
+        pools[it->first.pool()].add(s);
+      }
+    }
+
+    f->open_array_section("pools");
+    for (auto& p : pools) {
+      f->open_object_section("pool");
+      f->dump_int("pool", p.first);
+      p.second.dump(f);
+      f->close_section();
+    }
+    f->close_section(); //pools
   } else if (command == "dump_reservations") {
     f->open_object_section("reservations");
     f->open_object_section("local_reservations");
@@ -2033,6 +2135,7 @@ int OSD::init()
   tick_timer.init();
   tick_timer_without_osd_lock.init();
   service.backfill_request_timer.init();
+  service.scrub_sleep_timer.init();
 
   // mount.
   dout(2) << "mounting " << dev_path << " "
@@ -2181,6 +2284,42 @@ int OSD::init()
     op_prio_cutoff << "." << dendl;
 
   create_logger();
+  logger->tset(l_osd_load_pgs_scan, load_pgs_scan_time);
+  logger->tset(l_osd_load_pgs_read, load_pgs_read_time);
+  logger->tset(l_osd_load_pgs_init, load_pgs_init_time);
+  logger->tset(l_osd_load_pgs_past_intervals, load_pgs_past_intervals_time);
+
+  if (cct->_conf->osd_client_adaptive_throttle) {
+    Messenger::Policy p =
+      client_messenger->get_policy(entity_name_t::TYPE_CLIENT);
+    AdaptiveThrottle *t = new AdaptiveThrottle(
+      cct, "osd_client",
+      cct->_conf->osd_client_adaptive_throttle_target_latency,
+      cct->_conf->osd_client_adaptive_throttle_tolerance,
+      cct->_conf->osd_client_adaptive_throttle_min_scale);
+    if (p.throttler_messages)
+      t->add_throttle(p.throttler_messages);
+    if (p.throttler_bytes)
+      t->add_throttle(p.throttler_bytes);
+    adaptive_throttles[CEPH_ENTITY_TYPE_CLIENT].reset(t);
+  }
+  if (cct->_conf->osd_recovery_adaptive) {
+    service.recovery_throttle.reset(new AdaptiveThrottle(
+      cct, "osd_recovery",
+      cct->_conf->osd_recovery_adaptive_target_latency,
+      cct->_conf->osd_recovery_adaptive_tolerance,
+      cct->_conf->osd_recovery_adaptive_min_scale));
+    // no client ops waiting means nothing for recovery to get out of the way of
+    service.recovery_throttle->set_grow_when_idle(true);
+  }
+  if (cct->_conf->osd_snap_trim_adaptive) {
+    service.snap_trim_throttle.reset(new AdaptiveThrottle(
+      cct, "osd_snap_trim",
+      cct->_conf->osd_snap_trim_adaptive_target_latency,
+      cct->_conf->osd_snap_trim_adaptive_tolerance,
+      cct->_conf->osd_snap_trim_adaptive_min_scale));
+    service.snap_trim_throttle->set_grow_when_idle(true);
+  }
 
   // i'm ready!
   client_messenger->add_dispatcher_head(this);
@@ -2240,6 +2379,12 @@ int OSD::init()
   update_log_config();
 
   osd_tp.start();
+  if (op_run_to_completion) {
+    vector<int> cpus;
+    parse_cpu_list(cct->_conf->osd_op_shard_cpus, &cpus);
+    dout(0) << "running op shards to completion on cpus " << cpus << dendl;
+    osd_op_tp.set_thread_cpus(cpus);
+  }
   osd_op_tp.start();
   disk_tp.start();
   command_tp.start();
@@ -2371,6 +2516,12 @@ void OSD::final_init()
 				     "show clients which have active watches,"
 				     " and on which objects");
   assert(r == 0);
+  r = admin_socket->register_command("dump_object_context_cache",
+				     "dump_object_context_cache",
+				     asok_hook,
+				     "show object context cache hits and misses"
+				     " by pool");
+  assert(r == 0);
   r = admin_socket->register_command("dump_reservations", "dump_reservations",
 				     asok_hook,
 				     "show recovery reservations");
@@ -2517,6 +2668,8 @@ void OSD::create_logger()
       "Latency of read operation (excluding queue time)");   // client read process latency
   osd_plb.add_time_avg(l_osd_op_r_prepare_lat, "op_r_prepare_latency",
       "Latency of read operations (excluding queue time and wait for finished)"); // client read prepare latency
+  osd_plb.add_u64_counter(l_osd_op_r_fast, "op_r_fast",
+      "Client reads answered without an op context"); // client fast reads
   osd_plb.add_u64_counter(l_osd_op_w,      "op_w",
       "Client write operations");        // client writes
   osd_plb.add_u64_counter(l_osd_op_w_inb,  "op_w_in_bytes",
@@ -2624,6 +2777,22 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_pg_biginfo, "osd_pg_biginfo",
 			  "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(l_osd_scrub_deep_bytes, "scrub_deep_bytes",
+			  "Object data read or verified by deep scrub");
+  osd_plb.add_time_avg(l_osd_scrub_throttle_lat, "scrub_throttle_lat",
+		       "Delay of deep scrub chunks for the scrub budget");
+  osd_plb.add_u64_counter(l_osd_op_blocked_by_scrub, "op_blocked_by_scrub",
+			  "Client writes delayed by a scrub of their object");
+
+  osd_plb.add_time(l_osd_load_pgs_scan, "load_pgs_scan",
+		   "Startup: listing and opening pgs");
+  osd_plb.add_time(l_osd_load_pgs_read, "load_pgs_read",
+		   "Startup: reading pg info and logs");
+  osd_plb.add_time(l_osd_load_pgs_init, "load_pgs_init",
+		   "Startup: initializing loaded pgs");
+  osd_plb.add_time(l_osd_load_pgs_past_intervals, "load_pgs_past_intervals",
+		   "Startup: building past intervals");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -2724,6 +2893,7 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("dump_op_pq_state");
   cct->get_admin_socket()->unregister_command("dump_blacklist");
   cct->get_admin_socket()->unregister_command("dump_watchers");
+  cct->get_admin_socket()->unregister_command("dump_object_context_cache");
   cct->get_admin_socket()->unregister_command("dump_reservations");
   cct->get_admin_socket()->unregister_command("get_latest_osdmap");
   cct->get_admin_socket()->unregister_command("set_heap_property");
@@ -2781,6 +2951,7 @@ int OSD::shutdown()
     Mutex::Locker l(tick_timer_lock);
     tick_timer_without_osd_lock.shutdown();
   }
+  adaptive_throttles.clear();
 
   // note unmount epoch
   dout(10) << "noting clean unmount in epoch " << osdmap->get_epoch() << dendl;
@@ -3305,6 +3476,11 @@ void OSD::load_pgs()
 
   bool has_upgraded = false;
 
+  // open every pg first, then read their state in parallel (pgs are
+  // independent of each other and reading the logs is most of the
+  // work), then finish loading them one at a time
+  utime_t start = ceph_clock_now();
+  vector<pair<PG*, bufferlist> > opened;
   for (vector<coll_t>::iterator it = ls.begin();
        it != ls.end();
        ++it) {
@@ -3359,12 +3535,45 @@ void OSD::load_pgs()
     } else {
       pg = _open_lock_pg(osdmap, pgid);
     }
-    // there can be no waiters here, so we don't call wake_pg_waiters
-
     pg->ch = store->open_collection(pg->coll);
+    // there can be no waiters here, so we don't call wake_pg_waiters
+    pg->unlock();
+    opened.push_back(make_pair(pg, bl));
+  }
+  load_pgs_scan_time = ceph_clock_now() - start;
 
-    // read pg state, log
-    pg->read_state(store, bl);
+  start = ceph_clock_now();
+  {
+    // plain threads rather than a ThreadPool: the OSD's pools are not
+    // started until the end of init(), these threads live only for this
+    // pass and are joined below, and the pgs they read are not yet
+    // reachable by anything else
+    std::atomic<size_t> next = {0};
+    auto work = [&]() {
+      for (size_t i = next++; i < opened.size(); i = next++) {
+	PG *pg = opened[i].first;
+	pg->lock();
+	// read pg state, log
+	pg->read_state(store, opened[i].second);
+	pg->unlock();
+      }
+    };
+    unsigned threads = MAX(1, MIN((size_t)cct->_conf->osd_load_pgs_threads,
+				  opened.size()));
+    vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i)
+      workers.emplace_back(work);
+    work();
+    for (auto& t : workers)
+      t.join();
+  }
+  load_pgs_read_time = ceph_clock_now() - start;
+
+  start = ceph_clock_now();
+  for (auto& p : opened) {
+    PG *pg = p.first;
+    pg->lock();
+    spg_t pgid = pg->info.pgid;
 
     if (pg->must_upgrade()) {
       if (!pg->can_upgrade()) {
@@ -3412,9 +3621,14 @@ void OSD::load_pgs()
     }
     pg->unlock();
   }
+  load_pgs_init_time = ceph_clock_now() - start;
   {
     RWLock::RLocker l(pg_map_lock);
-    dout(0) << "load_pgs opened " << pg_map.size() << " pgs" << dendl;
+    dout(0) << "load_pgs opened " << pg_map.size() << " pgs in "
+	    << load_pgs_scan_time + load_pgs_read_time + load_pgs_init_time
+	    << " (scan " << load_pgs_scan_time
+	    << ", read " << load_pgs_read_time
+	    << ", init " << load_pgs_init_time << ")" << dendl;
   }
 
   // clean up old infos object?
@@ -3430,7 +3644,9 @@ void OSD::load_pgs()
     }
   }
 
+  start = ceph_clock_now();
   build_past_intervals_parallel();
+  load_pgs_past_intervals_time = ceph_clock_now() - start;
 }
 
 
@@ -4049,6 +4265,70 @@ void OSD::reset_heartbeat_peers()
   failure_queue.clear();
 }
 
+/*
+ * Answer a ping.  This is the hot half of the heartbeat protocol: every
+ * peer pings us on both the front and back networks every few seconds,
+ * so it stays off heartbeat_lock (which the heartbeat thread holds while
+ * sending its own pings and checking for failures) and only looks up the
+ * cluster connection when the peer actually needs newer maps.
+ */
+void OSD::handle_osd_ping_request(MOSDPing *m, int from, OSDMapRef& curmap)
+{
+  if (cct->_conf->osd_debug_drop_ping_probability > 0) {
+    Mutex::Locker l(heartbeat_lock);
+    auto heartbeat_drop = debug_heartbeat_drops_remaining.find(from);
+    if (heartbeat_drop != debug_heartbeat_drops_remaining.end()) {
+      if (heartbeat_drop->second == 0) {
+	debug_heartbeat_drops_remaining.erase(heartbeat_drop);
+      } else {
+	--heartbeat_drop->second;
+	dout(5) << "Dropping heartbeat from " << from
+		<< ", " << heartbeat_drop->second
+		<< " remaining to drop" << dendl;
+	return;
+      }
+    } else if (cct->_conf->osd_debug_drop_ping_probability >
+	       ((((double)(rand()%100))/100.0))) {
+      heartbeat_drop =
+	debug_heartbeat_drops_remaining.insert(std::make_pair(from,
+			 cct->_conf->osd_debug_drop_ping_duration)).first;
+      dout(5) << "Dropping heartbeat from " << from
+	      << ", " << heartbeat_drop->second
+	      << " remaining to drop" << dendl;
+      return;
+    }
+  }
+
+  if (!cct->get_heartbeat_map()->is_healthy()) {
+    dout(10) << "internal heartbeat not healthy, dropping ping request" << dendl;
+    return;
+  }
+
+  Message *r = new MOSDPing(monc->get_fsid(),
+			    curmap->get_epoch(),
+			    MOSDPing::PING_REPLY,
+			    m->stamp);
+  m->get_connection()->send_message(r);
+
+  if (curmap->is_up(from)) {
+    service.note_peer_epoch(from, m->map_epoch);
+    if (is_active() && m->map_epoch < curmap->get_epoch()) {
+      ConnectionRef con = service.get_con_osd_cluster(from, curmap->get_epoch());
+      if (con) {
+	service.share_map_peer(from, con.get());
+      }
+    }
+  } else if (!curmap->exists(from) ||
+	     curmap->get_down_at(from) > m->map_epoch) {
+    // tell them they have died
+    Message *r = new MOSDPing(monc->get_fsid(),
+			      curmap->get_epoch(),
+			      MOSDPing::YOU_DIED,
+			      m->stamp);
+    m->get_connection()->send_message(r);
+  }
+}
+
 void OSD::handle_osd_ping(MOSDPing *m)
 {
   if (superblock.cluster_fsid != m->fsid) {
@@ -4060,9 +4340,7 @@ void OSD::handle_osd_ping(MOSDPing *m)
 
   int from = m->get_source().num();
 
-  heartbeat_lock.Lock();
   if (is_stopping()) {
-    heartbeat_lock.Unlock();
     m->put();
     return;
   }
@@ -4070,64 +4348,20 @@ void OSD::handle_osd_ping(MOSDPing *m)
   OSDMapRef curmap = service.get_osdmap();
   assert(curmap);
 
-  switch (m->op) {
-
-  case MOSDPing::PING:
-    {
-      if (cct->_conf->osd_debug_drop_ping_probability > 0) {
-	auto heartbeat_drop = debug_heartbeat_drops_remaining.find(from);
-	if (heartbeat_drop != debug_heartbeat_drops_remaining.end()) {
-	  if (heartbeat_drop->second == 0) {
-	    debug_heartbeat_drops_remaining.erase(heartbeat_drop);
-	  } else {
-	    --heartbeat_drop->second;
-	    dout(5) << "Dropping heartbeat from " << from
-		    << ", " << heartbeat_drop->second
-		    << " remaining to drop" << dendl;
-	    break;
-	  }
-	} else if (cct->_conf->osd_debug_drop_ping_probability >
-	           ((((double)(rand()%100))/100.0))) {
-	  heartbeat_drop =
-	    debug_heartbeat_drops_remaining.insert(std::make_pair(from,
-	                     cct->_conf->osd_debug_drop_ping_duration)).first;
-	  dout(5) << "Dropping heartbeat from " << from
-		  << ", " << heartbeat_drop->second
-		  << " remaining to drop" << dendl;
-	  break;
-	}
-      }
-
-      if (!cct->get_heartbeat_map()->is_healthy()) {
-	dout(10) << "internal heartbeat not healthy, dropping ping request" << dendl;
-	break;
-      }
+  if (m->op == MOSDPing::PING) {
+    handle_osd_ping_request(m, from, curmap);
+    m->put();
+    return;
+  }
 
-      Message *r = new MOSDPing(monc->get_fsid(),
-				curmap->get_epoch(),
-				MOSDPing::PING_REPLY,
-				m->stamp);
-      m->get_connection()->send_message(r);
+  heartbeat_lock.Lock();
+  if (is_stopping()) {
+    heartbeat_lock.Unlock();
+    m->put();
+    return;
+  }
 
-      if (curmap->is_up(from)) {
-	service.note_peer_epoch(from, m->map_epoch);
-	if (is_active()) {
-	  ConnectionRef con = service.get_con_osd_cluster(from, curmap->get_epoch());
-	  if (con) {
-	    service.share_map_peer(from, con.get());
-	  }
-	}
-      } else if (!curmap->exists(from) ||
-		 curmap->get_down_at(from) > m->map_epoch) {
-	// tell them they have died
-	Message *r = new MOSDPing(monc->get_fsid(),
-				  curmap->get_epoch(),
-				  MOSDPing::YOU_DIED,
-				  m->stamp);
-	m->get_connection()->send_message(r);
-      }
-    }
-    break;
+  switch (m->op) {
 
   case MOSDPing::PING_REPLY:
     {
@@ -4290,7 +4524,10 @@ void OSD::heartbeat()
 
   utime_t now = ceph_clock_now();
 
-  // send heartbeats
+  // send heartbeats.  every ping of this round carries the same content,
+  // so they share one encoded payload.
+  epoch_t epoch = service.get_osdmap()->get_epoch();
+  Message::EncodeCacheRef ping_cache = std::make_shared<Message::EncodeCache>();
   for (map<int,HeartbeatInfo>::iterator i = heartbeat_peers.begin();
        i != heartbeat_peers.end();
        ++i) {
@@ -4299,16 +4536,15 @@ void OSD::heartbeat()
     if (i->second.first_tx == utime_t())
       i->second.first_tx = now;
     dout(30) << "heartbeat sending ping to osd." << peer << dendl;
-    i->second.con_back->send_message(new MOSDPing(monc->get_fsid(),
-					  service.get_osdmap()->get_epoch(),
-					  MOSDPing::PING,
-					  now));
+    Message *m = new MOSDPing(monc->get_fsid(), epoch, MOSDPing::PING, now);
+    m->set_encode_cache(ping_cache);
+    i->second.con_back->send_message(m);
 
-    if (i->second.con_front)
-      i->second.con_front->send_message(new MOSDPing(monc->get_fsid(),
-					     service.get_osdmap()->get_epoch(),
-						     MOSDPing::PING,
-						     now));
+    if (i->second.con_front) {
+      m = new MOSDPing(monc->get_fsid(), epoch, MOSDPing::PING, now);
+      m->set_encode_cache(ping_cache);
+      i->second.con_front->send_message(m);
+    }
   }
 
   logger->set(l_osd_hb_to, heartbeat_peers.size());
@@ -4409,6 +4645,11 @@ void OSD::tick_without_osd_lock()
   logger->set(l_osd_cached_crc, buffer::get_cached_crc());
   logger->set(l_osd_cached_crc_adjusted, buffer::get_cached_crc_adjusted());
 
+  for (auto& p : adaptive_throttles)
+    p.second->update();
+  service.update_recovery_throttle();
+  service.update_snap_trim_throttle();
+
   // osd_lock is not being held, which means the OSD state
   // might change when doing the monitor report
   if (is_active() || is_waiting_for_healthy()) {
@@ -6909,12 +7150,14 @@ void OSD::handle_osd_map(MOSDMap *m)
       t.write(coll_t::meta(), oid, 0, bl.length(), bl);
       pin_map_inc_bl(e, bl);
 
+      // start from the previous map (usually still cached, since we
+      // just added it) so that whatever the incremental leaves alone
+      // stays shared between the two instead of being decoded again
       OSDMap *o = new OSDMap;
       if (e > 1) {
-	bufferlist obl;
-        bool got = get_map_bl(e - 1, obl);
-        assert(got);
-	o->decode(obl);
+	OSDMapRef prev = service.try_get_map(e - 1);
+	assert(prev);
+	o->shallow_copy_from(*prev);
       }
 
       OSDMap::Incremental inc;
@@ -8504,11 +8747,21 @@ void OSDService::_maybe_queue_recovery() {
   }
 }
 
+uint64_t OSDService::_get_recovery_ops_active() const
+{
+  uint64_t per_op = MAX(1, cct->_conf->osd_max_push_objects);
+  return recovery_ops_active +
+    (recovery_batched_active + per_op - 1) / per_op;
+}
+
 bool OSDService::_recover_now(uint64_t *available_pushes)
 {
   uint64_t max = cct->_conf->osd_recovery_max_active;
-  if (max <= recovery_ops_active + recovery_ops_reserved) {
-    dout(15) << "_recover_now active " << recovery_ops_active
+  if (recovery_throttle)
+    max = MAX(1, (uint64_t)(max * recovery_throttle->get_scale()));
+  uint64_t active = _get_recovery_ops_active();
+  if (max <= active + recovery_ops_reserved) {
+    dout(15) << "_recover_now active " << active
 	     << " + reserved " << recovery_ops_reserved
 	     << " >= max " << max << dendl;
     if (available_pushes)
@@ -8517,7 +8770,7 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
   }
 
   if (available_pushes)
-    *available_pushes = max - recovery_ops_active - recovery_ops_reserved;
+    *available_pushes = max - active - recovery_ops_reserved;
 
   if (ceph_clock_now() < defer_recovery_until) {
     dout(15) << "_recover_now defer until " << defer_recovery_until << dendl;
@@ -8601,14 +8854,27 @@ void OSD::do_recovery(
   service.release_reserved_pushes(reserved_pushes);
 }
 
-void OSDService::start_recovery_op(PG *pg, const hobject_t& soid)
+void OSDService::update_recovery_throttle()
+{
+  if (!recovery_throttle)
+    return;
+  Mutex::Locker l(recovery_lock);
+  recovery_throttle->update();
+  _maybe_queue_recovery();
+}
+
+void OSDService::start_recovery_op(PG *pg, const hobject_t& soid, bool batched)
 {
   Mutex::Locker l(recovery_lock);
   dout(10) << "start_recovery_op " << *pg << " " << soid
-	   << " (" << recovery_ops_active << "/"
+	   << (batched ? " batched" : "")
+	   << " (" << _get_recovery_ops_active() << "/"
 	   << cct->_conf->osd_recovery_max_active << " rops)"
 	   << dendl;
-  recovery_ops_active++;
+  if (batched)
+    recovery_batched_active++;
+  else
+    recovery_ops_active++;
 
 #ifdef DEBUG_RECOVERY_OIDS
   dout(20) << "  active was " << recovery_oids[pg->info.pgid] << dendl;
@@ -8617,17 +8883,24 @@ void OSDService::start_recovery_op(PG *pg, const hobject_t& soid)
 #endif
 }
 
-void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
+void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue,
+				    bool batched)
 {
   Mutex::Locker l(recovery_lock);
   dout(10) << "finish_recovery_op " << *pg << " " << soid
 	   << " dequeue=" << dequeue
-	   << " (" << recovery_ops_active << "/" << cct->_conf->osd_recovery_max_active << " rops)"
+	   << (batched ? " batched" : "")
+	   << " (" << _get_recovery_ops_active() << "/" << cct->_conf->osd_recovery_max_active << " rops)"
 	   << dendl;
 
   // adjust count
-  assert(recovery_ops_active > 0);
-  recovery_ops_active--;
+  if (batched) {
+    assert(recovery_batched_active > 0);
+    recovery_batched_active--;
+  } else {
+    assert(recovery_ops_active > 0);
+    recovery_ops_active--;
+  }
 
 #ifdef DEBUG_RECOVERY_OIDS
   dout(20) << "  active oids was " << recovery_oids[pg->info.pgid] << dendl;
@@ -8640,7 +8913,7 @@ void OSDService::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
 
 bool OSDService::is_recovery_active()
 {
-  if (recovery_ops_active > 0)
+  if (recovery_ops_active > 0 || recovery_batched_active > 0)
     return true;
 
   return false;
@@ -8883,6 +9156,71 @@ void OSD::enqueue_op(PGRef pg, OpRequestRef& op)
   pg->queue_op(op);
 }
 
+void OSD::parse_cpu_list(const string& str, vector<int> *cpus)
+{
+  list<string> ranges;
+  get_str_list(str, ",", ranges);
+  for (auto& r : ranges) {
+    string err;
+    size_t dash = r.find('-');
+    int first = strict_strtol(r.substr(0, dash).c_str(), 10, &err);
+    int last = first;
+    if (err.empty() && dash != string::npos)
+      last = strict_strtol(r.substr(dash + 1).c_str(), 10, &err);
+    if (!err.empty() || first < 0 || last < first) {
+      derr << "ignoring bad cpu range '" << r << "' in osd_op_shard_cpus"
+	   << dendl;
+      continue;
+    }
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus->push_back(cpu);
+  }
+  if (cpus->empty()) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < n; ++cpu)
+      cpus->push_back(cpu);
+  }
+}
+
+mClockClientInfo OSD::get_mclock_client_info(const mClockOpClient& c)
+{
+  const md_config_t *conf = cct->_conf;
+  switch (c.type) {
+  case osd_op_type_t::client_op:
+    {
+      mClockClientInfo info(conf->osd_op_queue_mclock_client_op_res,
+			    conf->osd_op_queue_mclock_client_op_wgt,
+			    conf->osd_op_queue_mclock_client_op_lim);
+      OSDMapRef osdmap = service.get_osdmap();
+      const pg_pool_t *pool = osdmap ? osdmap->get_pg_pool(c.pool) : nullptr;
+      if (pool) {
+	pool->opts.get(pool_opts_t::QOS_RESERVATION, &info.reservation);
+	pool->opts.get(pool_opts_t::QOS_WEIGHT, &info.weight);
+	pool->opts.get(pool_opts_t::QOS_LIMIT, &info.limit);
+      }
+      return info;
+    }
+  case osd_op_type_t::osd_subop:
+    return mClockClientInfo(conf->osd_op_queue_mclock_osd_subop_res,
+			    conf->osd_op_queue_mclock_osd_subop_wgt,
+			    conf->osd_op_queue_mclock_osd_subop_lim);
+  case osd_op_type_t::bg_snaptrim:
+    return mClockClientInfo(conf->osd_op_queue_mclock_snap_res,
+			    conf->osd_op_queue_mclock_snap_wgt,
+			    conf->osd_op_queue_mclock_snap_lim);
+  case osd_op_type_t::bg_recovery:
+    return mClockClientInfo(conf->osd_op_queue_mclock_recov_res,
+			    conf->osd_op_queue_mclock_recov_wgt,
+			    conf->osd_op_queue_mclock_recov_lim);
+  case osd_op_type_t::bg_scrub:
+    return mClockClientInfo(conf->osd_op_queue_mclock_scrub_res,
+			    conf->osd_op_queue_mclock_scrub_wgt,
+			    conf->osd_op_queue_mclock_scrub_lim);
+  }
+  ceph_abort();
+  return mClockClientInfo();
+}
+
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb ) {
 
   uint32_t shard_index = thread_index % num_shards;
@@ -8890,20 +9228,32 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb )
   ShardData* sdata = shard_list[shard_index];
   assert(NULL != sdata);
   sdata->sdata_op_ordering_lock.Lock();
+  drain_inbox(sdata);
   if (sdata->pqueue->empty()) {
     sdata->sdata_op_ordering_lock.Unlock();
     osd->cct->get_heartbeat_map()->reset_timeout(hb,
       osd->cct->_conf->threadpool_default_timeout, 0);
-    sdata->sdata_lock.Lock();
-    sdata->sdata_cond.WaitInterval(sdata->sdata_lock,
+    wait_for_work(sdata,
       utime_t(osd->cct->_conf->threadpool_empty_queue_max_wait, 0));
-    sdata->sdata_lock.Unlock();
     sdata->sdata_op_ordering_lock.Lock();
+    drain_inbox(sdata);
     if(sdata->pqueue->empty()) {
       sdata->sdata_op_ordering_lock.Unlock();
       return;
     }
   }
+  double ready_in = sdata->pqueue->ready_in();
+  if (ready_in > 0) {
+    // everything queued is held back by a QoS limit
+    sdata->sdata_op_ordering_lock.Unlock();
+    osd->cct->get_heartbeat_map()->reset_timeout(hb,
+      osd->cct->_conf->threadpool_default_timeout, 0);
+    utime_t wait;
+    wait.set_from_double(MIN(ready_in,
+      (double)osd->cct->_conf->threadpool_empty_queue_max_wait));
+    wait_for_work(sdata, wait);
+    return;
+  }
   pair<PGRef, PGQueueable> item = sdata->pqueue->dequeue();
   sdata->pg_for_processing[&*(item.first)].push_back(item.second);
   sdata->sdata_op_ordering_lock.Unlock();
@@ -8970,10 +9320,34 @@ void OSD::ShardedOpWQ::_enqueue(pair<PGRef, PGQueueable> item) {
 
   ShardData* sdata = shard_list[shard_index];
   assert (NULL != sdata);
+
+  if (osd->op_run_to_completion) {
+    // the shard's only thread moves this to pqueue itself; only wake it
+    // if it is (about to be) waiting
+    sdata->inbox.push(item);
+    if (sdata->sleeping.load()) {
+      sdata->sdata_lock.Lock();
+      sdata->sdata_cond.SignalOne();
+      sdata->sdata_lock.Unlock();
+    }
+    return;
+  }
+
+  sdata->sdata_op_ordering_lock.Lock();
+  _enqueue_locked(sdata, item);
+  sdata->sdata_op_ordering_lock.Unlock();
+
+  sdata->sdata_lock.Lock();
+  sdata->sdata_cond.SignalOne();
+  sdata->sdata_lock.Unlock();
+
+}
+
+void OSD::ShardedOpWQ::_enqueue_locked(
+  ShardData *sdata, pair<PGRef, PGQueueable>& item)
+{
   unsigned priority = item.second.get_priority();
   unsigned cost = item.second.get_cost();
-  sdata->sdata_op_ordering_lock.Lock();
- 
   if (priority >= osd->op_prio_cutoff)
     sdata->pqueue->enqueue_strict(
       item.second.get_owner(), priority, item);
@@ -8981,12 +9355,16 @@ void OSD::ShardedOpWQ::_enqueue(pair<PGRef, PGQueueable> item) {
     sdata->pqueue->enqueue(
       item.second.get_owner(),
       priority, cost, item);
-  sdata->sdata_op_ordering_lock.Unlock();
+}
 
+void OSD::ShardedOpWQ::wait_for_work(ShardData *sdata, utime_t interval)
+{
   sdata->sdata_lock.Lock();
-  sdata->sdata_cond.SignalOne();
+  sdata->sleeping = true;
+  if (sdata->inbox.empty())
+    sdata->sdata_cond.WaitInterval(sdata->sdata_lock, interval);
+  sdata->sleeping = false;
   sdata->sdata_lock.Unlock();
-
 }
 
 void OSD::ShardedOpWQ::_enqueue_front(pair<PGRef, PGQueueable> item) {
@@ -9030,6 +9408,17 @@ void OSD::dequeue_op(
   utime_t now = ceph_clock_now();
   op->set_dequeued_time(now);
   utime_t latency = now - op->get_req()->get_recv_stamp();
+  if (!adaptive_throttles.empty()) {
+    auto p = adaptive_throttles.find(op->get_req()->get_source().type());
+    if (p != adaptive_throttles.end())
+      p->second->add_sample(now - op->get_req()->get_recv_complete_stamp());
+  }
+  if (service.recovery_throttle && op->get_req()->get_source().is_client())
+    service.recovery_throttle->add_sample(
+      now - op->get_req()->get_recv_complete_stamp());
+  if (service.snap_trim_throttle && op->get_req()->get_source().is_client())
+    service.snap_trim_throttle->add_sample(
+      now - op->get_req()->get_recv_complete_stamp());
   dout(10) << "dequeue_op " << op << " prio " << op->get_req()->get_priority()
 	   << " cost " << op->get_req()->get_cost()
 	   << " latency " << latency
@@ -9131,10 +9520,21 @@ void OSD::process_peering_events(
       // handle an event
       peering_wq.queue(pg);
     } else {
-      assert(!pg->peering_queue.empty());
-      PG::CephPeeringEvtRef evt = pg->peering_queue.front();
-      pg->peering_queue.pop_front();
-      pg->handle_peering_event(evt, &rctx);
+      // handle what is queued for this pg under one lock and in one
+      // transaction; messages for all pgs in the batch go out together
+      // in dispatch_context below.  the queue may already be empty if
+      // an earlier batch drained the event this pg was queued for.
+      uint64_t max_events = std::max<uint64_t>(
+	cct->_conf->osd_peering_wq_max_events_per_pg, 1);
+      for (uint64_t n = 0;
+	   n < max_events && !pg->peering_queue.empty();
+	   ++n) {
+	PG::CephPeeringEvtRef evt = pg->peering_queue.front();
+	pg->peering_queue.pop_front();
+	pg->handle_peering_event(evt, &rctx);
+      }
+      if (!pg->peering_queue.empty())
+	peering_wq.queue(pg);
     }
     need_up_thru = pg->need_up_thru || need_up_thru;
     same_interval_since = MAX(pg->info.history.same_interval_since,
@@ -9513,6 +9913,7 @@ void OSD::PeeringWQ::_dequeue(list<PG*> *out) {
           ++i;
         } else {
           out->push_back(*i);
+          queued.erase(*i);
           peering_queue.erase(i++);
         }
   }
@@ -51,6 +51,8 @@ using namespace std;
 #include "common/sharedptr_registry.hpp"
 #include "common/WeightedPriorityQueue.h"
 #include "common/PrioritizedQueue.h"
+#include "common/MPSCInbox.h"
+#include "osd/mClockOpQueue.h"
 #include "messages/MOSDOp.h"
 #include "include/Spinlock.h"
 
@@ -71,6 +73,7 @@ enum {
   l_osd_op_r_lat,
   l_osd_op_r_process_lat,
   l_osd_op_r_prepare_lat,
+  l_osd_op_r_fast,
   l_osd_op_w,
   l_osd_op_w_inb,
   l_osd_op_w_rlat,
@@ -162,6 +165,15 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_scrub_deep_bytes,
+  l_osd_scrub_throttle_lat,
+  l_osd_op_blocked_by_scrub,
+
+  l_osd_load_pgs_scan,
+  l_osd_load_pgs_read,
+  l_osd_load_pgs_init,
+  l_osd_load_pgs_past_intervals,
+
   l_osd_last,
 };
 
@@ -419,6 +431,7 @@ public:
   int get_cost() const { return cost; }
   utime_t get_start_time() const { return start_time; }
   entity_inst_t get_owner() const { return owner; }
+  osd_op_type_t get_op_type() const;
 };
 
 class OSDService {
@@ -629,6 +642,7 @@ private:
   Mutex sched_scrub_lock;
   int scrubs_pending;
   int scrubs_active;
+  utime_t deep_scrub_budget_next;  ///< when the deep scrub budget frees up
 
 public:
   struct ScrubJob {
@@ -693,6 +707,11 @@ public:
   void dec_scrubs_pending();
   void dec_scrubs_active();
 
+  /// charge bytes deep scrub read to osd_deep_scrub_max_bytes_per_sec
+  void charge_deep_scrub(uint64_t bytes);
+  /// @return how long deep scrub should wait before its next chunk
+  utime_t get_deep_scrub_wait();
+
   void reply_op_error(OpRequestRef op, int err);
   void reply_op_error(OpRequestRef op, int err, eversion_t v, version_t uv);
   void handle_misdirected_op(PG *pg, OpRequestRef op);
@@ -866,6 +885,10 @@ public:
   Mutex backfill_request_lock;
   SafeTimer backfill_request_timer;
 
+  // -- Scrub throttling --
+  Mutex scrub_sleep_lock;
+  SafeTimer scrub_sleep_timer;
+
   // -- tids --
   // for ops i issue
   std::atomic_uint last_tid{0};
@@ -892,6 +915,15 @@ public:
 
   void queue_for_peering(PG *pg);
   void queue_for_snap_trim(PG *pg);
+
+  /// scales osd_snap_trim_batch_objects from client op latency, if enabled
+  std::unique_ptr<AdaptiveThrottle> snap_trim_throttle;
+  void update_snap_trim_throttle();
+  /// clones a pg should trim per transaction
+  unsigned get_snap_trim_batch() const;
+private:
+  std::atomic<unsigned> snap_trim_batch = {0}; ///< scaled; 0 if not adaptive
+public:
   void queue_for_scrub(PG *pg) {
     op_wq.queue(
       make_pair(
@@ -911,11 +943,13 @@ private:
 
   utime_t defer_recovery_until;
   uint64_t recovery_ops_active;
+  uint64_t recovery_batched_active; ///< small objects, osd_max_push_objects per op
   uint64_t recovery_ops_reserved;
   bool recovery_paused;
 #ifdef DEBUG_RECOVERY_OIDS
   map<spg_t, set<hobject_t, hobject_t::BitwiseComparator> > recovery_oids;
 #endif
+  uint64_t _get_recovery_ops_active() const;
   bool _recover_now(uint64_t *available_pushes);
   void _maybe_queue_recovery();
   void _queue_for_recovery(
@@ -932,8 +966,13 @@ private:
     op_wq.queue(to_queue);
   }
 public:
-  void start_recovery_op(PG *pg, const hobject_t& soid);
-  void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue);
+  /// scales osd_recovery_max_active from client op latency, if enabled
+  std::unique_ptr<AdaptiveThrottle> recovery_throttle;
+  void update_recovery_throttle();
+
+  void start_recovery_op(PG *pg, const hobject_t& soid, bool batched = false);
+  void finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue,
+			  bool batched = false);
   bool is_recovery_active();
   void release_reserved_pushes(uint64_t pushes) {
     Mutex::Locker l(recovery_lock);
@@ -1205,6 +1244,8 @@ protected:
   Messenger   *cluster_messenger;
   Messenger   *client_messenger;
   Messenger   *objecter_messenger;
+  /// policy throttles sized from op queue latency, by peer entity type
+  map<int, std::unique_ptr<AdaptiveThrottle>> adaptive_throttles;
   MonClient   *monc; // check the "monc helpers" list before accessing directly
   MgrClient   mgrc;
   PerfCounters      *logger;
@@ -1733,9 +1774,12 @@ private:
   // -- op queue --
   enum io_queue {
     prioritized,
-    weightedpriority};
+    weightedpriority,
+    mclock};
   const io_queue op_queue;
   const unsigned int op_prio_cutoff;
+  /// one pinned thread per shard, fed through the shard's inbox
+  const bool op_run_to_completion;
 
   friend class PGQueueable;
   class ShardedOpWQ: public ShardedThreadPool::ShardedWQ < pair <PGRef, PGQueueable> > {
@@ -1746,13 +1790,30 @@ private:
       Mutex sdata_op_ordering_lock;
       map<PG*, list<PGQueueable> > pg_for_processing;
       std::unique_ptr<OpQueue< pair<PGRef, PGQueueable>, entity_inst_t>> pqueue;
+      /// run-to-completion mode: ops handed over by dispatch without
+      /// taking sdata_op_ordering_lock, moved to pqueue by drain_inbox()
+      MPSCInbox<pair<PGRef, PGQueueable>> inbox;
+      /// set by the shard's thread while it waits on sdata_cond
+      std::atomic<bool> sleeping = {false};
       ShardData(
 	string lock_name, string ordering_lock,
 	uint64_t max_tok_per_prio, uint64_t min_cost, CephContext *cct,
-	io_queue opqueue)
+	io_queue opqueue, OSD *osd)
 	: sdata_lock(lock_name.c_str(), false, true, false, cct),
 	  sdata_op_ordering_lock(ordering_lock.c_str(), false, true, false, cct) {
-	    if (opqueue == weightedpriority) {
+	    if (opqueue == mclock) {
+	      pqueue = std::unique_ptr
+		<mClockOpQueue< pair<PGRef, PGQueueable>>>(
+		  new mClockOpQueue< pair<PGRef, PGQueueable>>(
+		    [](const pair<PGRef, PGQueueable>& i) {
+		      return make_pair(i.second.get_op_type(),
+				       i.first->get_pgid().pool());
+		    },
+		    [osd](const mClockOpClient& c) {
+		      return osd->get_mclock_client_info(c);
+		    },
+		    cct->_conf->osd_op_queue_mclock_cost_unit));
+	    } else if (opqueue == weightedpriority) {
 	      pqueue = std::unique_ptr
 		<WeightedPriorityQueue< pair<PGRef, PGQueueable>, entity_inst_t>>(
 		  new WeightedPriorityQueue< pair<PGRef, PGQueueable>, entity_inst_t>(
@@ -1784,7 +1845,7 @@ private:
 	ShardData* one_shard = new ShardData(
 	  lock_name, order_lock,
 	  osd->cct->_conf->osd_op_pq_max_tokens_per_priority, 
-	  osd->cct->_conf->osd_op_pq_min_cost, osd->cct, osd->op_queue);
+	  osd->cct->_conf->osd_op_pq_min_cost, osd->cct, osd->op_queue, osd);
 	shard_list.push_back(one_shard);
       }
     }
@@ -1799,6 +1860,17 @@ private:
     void _process(uint32_t thread_index, heartbeat_handle_d *hb);
     void _enqueue(pair <PGRef, PGQueueable> item);
     void _enqueue_front(pair <PGRef, PGQueueable> item);
+    /// wait on sdata_cond unless something arrives in sdata's inbox
+    void wait_for_work(ShardData *sdata, utime_t interval);
+    /// add item to sdata's pqueue; sdata_op_ordering_lock must be held
+    void _enqueue_locked(ShardData *sdata, pair <PGRef, PGQueueable>& item);
+    /// move sdata's inbox to its pqueue; sdata_op_ordering_lock must be held
+    void drain_inbox(ShardData *sdata) {
+      assert(sdata->sdata_op_ordering_lock.is_locked());
+      sdata->inbox.take_all([this, sdata](pair <PGRef, PGQueueable>&& item) {
+	  _enqueue_locked(sdata, item);
+	});
+    }
       
     void return_waiting_threads() {
       for(uint32_t i = 0; i < num_shards; i++) {
@@ -1817,6 +1889,7 @@ private:
 	snprintf(lock_name, sizeof(lock_name), "%s%d", "OSD:ShardedOpWQ:", i);
 	assert (NULL != sdata);
 	sdata->sdata_op_ordering_lock.Lock();
+	drain_inbox(sdata);
 	f->open_object_section(lock_name);
 	sdata->pqueue->dump(f);
 	f->close_section();
@@ -1863,6 +1936,7 @@ private:
       sdata = shard_list[shard_index];
       assert(sdata != NULL);
       sdata->sdata_op_ordering_lock.Lock();
+      drain_inbox(sdata);
 
       Pred f(pg, dequeued);
 
@@ -1889,7 +1963,7 @@ private:
       ShardData* sdata = shard_list[shard_index];
       assert(NULL != sdata);
       Mutex::Locker l(sdata->sdata_op_ordering_lock);
-      return sdata->pqueue->empty();
+      return sdata->pqueue->empty() && sdata->inbox.empty();
     }
   } op_shardedwq;
 
@@ -1902,6 +1976,7 @@ private:
   // -- peering queue --
   struct PeeringWQ : public ThreadPool::BatchWorkQueue<PG> {
     list<PG*> peering_queue;
+    set<PG*> queued;  ///< pgs in peering_queue; each one is there only once
     OSD *osd;
     set<PG*> in_use;
     PeeringWQ(OSD *o, time_t ti, time_t si, ThreadPool *tp)
@@ -1909,18 +1984,22 @@ private:
 	"OSD::PeeringWQ", ti, si, tp), osd(o) {}
 
     void _dequeue(PG *pg) override {
+      if (!queued.erase(pg))
+	return;
       for (list<PG*>::iterator i = peering_queue.begin();
 	   i != peering_queue.end();
-	   ) {
+	   ++i) {
 	if (*i == pg) {
-	  peering_queue.erase(i++);
+	  peering_queue.erase(i);
 	  pg->put("PeeringWQ");
-	} else {
-	  ++i;
+	  break;
 	}
       }
     }
     bool _enqueue(PG *pg) override {
+      // a queued pg drains all of its events when its turn comes
+      if (!queued.insert(pg).second)
+	return false;
       pg->get("PeeringWQ");
       peering_queue.push_back(pg);
       return true;
@@ -2073,6 +2152,10 @@ protected:
   void load_pgs();
   void build_past_intervals_parallel();
 
+  /// time load_pgs() spent in each phase, for the perf counters
+  utime_t load_pgs_scan_time, load_pgs_read_time, load_pgs_init_time,
+    load_pgs_past_intervals_time;
+
   /// project pg history from from to now
   bool project_pg_history(
     spg_t pgid, pg_history_t& h, epoch_t from,
@@ -2402,15 +2485,22 @@ protected:
 
   io_queue get_io_queue() const {
     if (cct->_conf->osd_op_queue == "debug_random") {
+      static const io_queue queues[] = { prioritized, weightedpriority, mclock };
       srand(time(NULL));
-      return (rand() % 2 < 1) ? prioritized : weightedpriority;
+      return queues[rand() % 3];
     } else if (cct->_conf->osd_op_queue == "wpq") {
       return weightedpriority;
+    } else if (cct->_conf->osd_op_queue == "mclock") {
+      return mclock;
     } else {
       return prioritized;
     }
   }
 
+  mClockClientInfo get_mclock_client_info(const mClockOpClient& c);
+  /// parse "0-3,8" style cpu lists; all online cpus if none are given
+  void parse_cpu_list(const string& str, vector<int> *cpus);
+
   unsigned int get_io_prio_cut() const {
     if (cct->_conf->osd_op_queue_cut_off == "debug_random") {
       srand(time(NULL));
@@ -2460,6 +2550,7 @@ private:
 
   void handle_pg_scrub(struct MOSDScrub *m, PG* pg);
   void handle_scrub(struct MOSDScrub *m);
+  void handle_osd_ping_request(class MOSDPing *m, int from, OSDMapRef& curmap);
   void handle_osd_ping(class MOSDPing *m);
   void handle_op(OpRequestRef& op, OSDMapRef& osdmap);
 
@@ -920,6 +920,9 @@ void OSDMap::set_max_osd(int m)
   }
   osd_info.resize(m);
   osd_xinfo.resize(m);
+  _unshare(osd_addrs);
+  _unshare(osd_uuid);
+  _unshare(osd_primary_affinity);
   osd_addrs->client_addr.resize(m);
   osd_addrs->cluster_addr.resize(m);
   osd_addrs->hb_back_addr.resize(m);
@@ -1126,62 +1129,78 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   if (o->epoch == n->epoch)
     return;
 
-  int diff = 0;
+  // maps built with shallow_copy_from may already share any of the
+  // below; only compare what is not shared yet
 
-  // do addrs match?
-  if (o->max_osd != n->max_osd)
-    diff++;
-  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
-    if ( n->osd_addrs->client_addr[i] &&  o->osd_addrs->client_addr[i] &&
-	*n->osd_addrs->client_addr[i] == *o->osd_addrs->client_addr[i])
-      n->osd_addrs->client_addr[i] = o->osd_addrs->client_addr[i];
-    else
-      diff++;
-    if ( n->osd_addrs->cluster_addr[i] &&  o->osd_addrs->cluster_addr[i] &&
-	*n->osd_addrs->cluster_addr[i] == *o->osd_addrs->cluster_addr[i])
-      n->osd_addrs->cluster_addr[i] = o->osd_addrs->cluster_addr[i];
-    else
-      diff++;
-    if ( n->osd_addrs->hb_back_addr[i] &&  o->osd_addrs->hb_back_addr[i] &&
-	*n->osd_addrs->hb_back_addr[i] == *o->osd_addrs->hb_back_addr[i])
-      n->osd_addrs->hb_back_addr[i] = o->osd_addrs->hb_back_addr[i];
-    else
+  // do addrs match?  (the per-osd entries are rewritten in place, which
+  // is only safe if nobody else has n's)
+  if (o->osd_addrs != n->osd_addrs && n->osd_addrs.use_count() == 1) {
+    int diff = 0;
+    if (o->max_osd != n->max_osd)
       diff++;
-    if ( n->osd_addrs->hb_front_addr[i] &&  o->osd_addrs->hb_front_addr[i] &&
-	*n->osd_addrs->hb_front_addr[i] == *o->osd_addrs->hb_front_addr[i])
-      n->osd_addrs->hb_front_addr[i] = o->osd_addrs->hb_front_addr[i];
-    else
-      diff++;
-  }
-  if (diff == 0) {
-    // zoinks, no differences at all!
-    n->osd_addrs = o->osd_addrs;
+    for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+      if ( n->osd_addrs->client_addr[i] &&  o->osd_addrs->client_addr[i] &&
+	  *n->osd_addrs->client_addr[i] == *o->osd_addrs->client_addr[i])
+	n->osd_addrs->client_addr[i] = o->osd_addrs->client_addr[i];
+      else
+	diff++;
+      if ( n->osd_addrs->cluster_addr[i] &&  o->osd_addrs->cluster_addr[i] &&
+	  *n->osd_addrs->cluster_addr[i] == *o->osd_addrs->cluster_addr[i])
+	n->osd_addrs->cluster_addr[i] = o->osd_addrs->cluster_addr[i];
+      else
+	diff++;
+      if ( n->osd_addrs->hb_back_addr[i] &&  o->osd_addrs->hb_back_addr[i] &&
+	  *n->osd_addrs->hb_back_addr[i] == *o->osd_addrs->hb_back_addr[i])
+	n->osd_addrs->hb_back_addr[i] = o->osd_addrs->hb_back_addr[i];
+      else
+	diff++;
+      if ( n->osd_addrs->hb_front_addr[i] &&  o->osd_addrs->hb_front_addr[i] &&
+	  *n->osd_addrs->hb_front_addr[i] == *o->osd_addrs->hb_front_addr[i])
+	n->osd_addrs->hb_front_addr[i] = o->osd_addrs->hb_front_addr[i];
+      else
+	diff++;
+    }
+    if (diff == 0) {
+      // zoinks, no differences at all!
+      n->osd_addrs = o->osd_addrs;
+    }
   }
 
   // does crush match?
-  bufferlist oc, nc;
-  ::encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  ::encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (o->crush != n->crush) {
+    bufferlist oc, nc;
+    ::encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    ::encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (o->pg_temp->size() == n->pg_temp->size()) {
+  if (o->pg_temp != n->pg_temp &&
+      o->pg_temp->size() == n->pg_temp->size()) {
     if (*o->pg_temp == *n->pg_temp)
       n->pg_temp = o->pg_temp;
   }
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (o->primary_temp != n->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
 
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (o->osd_uuid != n->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
+
+  // does primary affinity match?
+  if (o->osd_primary_affinity && n->osd_primary_affinity &&
+      o->osd_primary_affinity != n->osd_primary_affinity &&
+      *o->osd_primary_affinity == *n->osd_primary_affinity)
+    n->osd_primary_affinity = o->osd_primary_affinity;
 }
 
 void OSDMap::clean_temps(CephContext *cct,
@@ -1348,6 +1367,11 @@ int OSDMap::apply_incremental(const Incremental &inc)
   }
   
   // up/down
+  if (!inc.new_state.empty() || !inc.new_up_client.empty() ||
+      !inc.new_up_cluster.empty())
+    _unshare(osd_addrs);
+  if (!inc.new_state.empty() || !inc.new_uuid.empty())
+    _unshare(osd_uuid);
   for (map<int32_t,uint8_t>::const_iterator i = inc.new_state.begin();
        i != inc.new_state.end();
        ++i) {
@@ -1420,6 +1444,10 @@ int OSDMap::apply_incremental(const Incremental &inc)
     (*osd_uuid)[p->first] = p->second;
 
   // pg rebuild
+  if (!inc.new_pg_temp.empty())
+    _unshare(pg_temp);
+  if (!inc.new_primary_temp.empty())
+    _unshare(primary_temp);
   for (map<pg_t, vector<int> >::const_iterator p = inc.new_pg_temp.begin(); p != inc.new_pg_temp.end(); ++p) {
     if (p->second.empty())
       pg_temp->erase(p->first);
@@ -1700,10 +1728,13 @@ void OSDMap::pg_to_raw_up(pg_t pg, vector<int> *up, int *primary) const
 }
   
 void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_primary,
-                                   vector<int> *acting, int *acting_primary) const
+                                   vector<int> *acting, int *acting_primary,
+                                   vector<int> *raw_out) const
 {
   const pg_pool_t *pool = get_pg_pool(pg.pool());
   if (!pool) {
+    if (raw_out)
+      raw_out->clear();
     if (up)
       up->clear();
     if (up_primary)
@@ -1721,9 +1752,11 @@ void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_prim
   int _acting_primary;
   ps_t pps;
   _get_temp_osds(*pool, pg, &_acting, &_acting_primary);
-  if (_acting.empty() || up || up_primary) {
+  if (_acting.empty() || up || up_primary || raw_out) {
     _pg_to_raw_osds(*pool, pg, &raw, &_up_primary, &pps);
     _raw_to_up_osds(*pool, raw, &_up, &_up_primary);
+    if (raw_out)
+      raw_out->swap(raw);
     _apply_primary_affinity(pps, *pool, &_up, &_up_primary);
     if (_acting.empty()) {
       _acting = _up;
@@ -2117,6 +2150,13 @@ void OSDMap::decode(bufferlist::iterator& bl)
   size_t tail_offset = 0;
   bufferlist crc_front, crc_tail;
 
+  // we decode in place; leave whatever we share with other maps alone
+  _drop_shared(osd_addrs);
+  _drop_shared(pg_temp);
+  _drop_shared(primary_temp);
+  _drop_shared(osd_uuid);
+  _drop_shared(crush);
+
   DECODE_START_LEGACY_COMPAT_LEN(8, 7, 7, bl); // wrapper
   if (struct_v < 7) {
     int struct_v_size = sizeof(struct_v);
@@ -248,6 +248,19 @@ private:
 
   void _calc_up_osd_features();
 
+  /// give this map its own copy of *p if it is shared with another map
+  template <typename T>
+  static void _unshare(ceph::shared_ptr<T>& p) {
+    if (p && p.use_count() > 1)
+      p = std::make_shared<T>(*p);
+  }
+  /// like _unshare, for a *p that is about to be overwritten anyway
+  template <typename T>
+  static void _drop_shared(ceph::shared_ptr<T>& p) {
+    if (p && p.use_count() > 1)
+      p = std::make_shared<T>();
+  }
+
  public:
   bool have_crc() const { return crc_defined; }
   uint32_t get_crc() const { return crc; }
@@ -255,6 +268,7 @@ private:
   ceph::shared_ptr<CrushWrapper> crush;       // hierarchical map
 
   friend class OSDMonitor;
+  friend class OSDMapMapping;
 
  public:
   OSDMap() : epoch(0), 
@@ -296,6 +310,20 @@ public:
     // allocate a new CrushWrapper, though.
   }
 
+  /**
+   * share every refcounted substructure of o
+   *
+   * Cheap enough to do per epoch: crush, the addrs, uuids, primary
+   * affinity, pg_temp and primary_temp are only copied by
+   * apply_incremental (or set_max_osd, set_primary_affinity) once the
+   * Incremental actually changes them, so successive maps built this
+   * way keep sharing whatever did not change.  Other mutators assume
+   * a deepish_copy_from.
+   */
+  void shallow_copy_from(const OSDMap& o) {
+    *this = o;
+  }
+
   // map info
   const uuid_d& get_fsid() const { return fsid; }
   void set_fsid(uuid_d& f) { fsid = f; }
@@ -382,6 +410,9 @@ public:
     if (!osd_primary_affinity)
       osd_primary_affinity.reset(new vector<__u32>(max_osd,
 						   CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
+    else if ((*osd_primary_affinity)[o] == (unsigned)w)
+      return;
+    _unshare(osd_primary_affinity);
     (*osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
@@ -637,7 +668,8 @@ private:
    *  map to up and acting. Fills in whatever fields are non-NULL.
    */
   void _pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_primary,
-                             vector<int> *acting, int *acting_primary) const;
+                             vector<int> *acting, int *acting_primary,
+                             vector<int> *raw_out = nullptr) const;
 
 public:
   /***
@@ -676,6 +708,12 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /// as above, also returning the raw CRUSH mapping up was derived from
+  void pg_to_raw_up_acting_osds(pg_t pg, vector<int> *raw,
+                                vector<int> *up, int *up_primary,
+                                vector<int> *acting, int *acting_primary) const {
+    _pg_to_up_acting_osds(pg, up, up_primary, acting, acting_primary, raw);
+  }
   bool pg_is_ec(pg_t pg) const {
     map<int64_t, pg_pool_t>::const_iterator i = pools.find(pg.pool());
     assert(i != pools.end());
@@ -0,0 +1,274 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "OSDMapMapping.h"
+
+#include <atomic>
+#include <thread>
+
+#include "common/debug.h"
+
+#define dout_subsys ceph_subsys_osd
+
+// pgs per job when mapping in parallel
+static const ps_t JOB_PGS = 1024;
+
+bool OSDMapMapping::PoolMapping::raw_contains(
+  ps_t ps, const std::vector<bool>& osds) const
+{
+  const int32_t *r = row(ps);
+  const int32_t *raw = r + 5;
+  for (int i = 0; i < r[2]; ++i) {
+    if (raw[i] >= 0 && raw[i] < (int)osds.size() && osds[raw[i]])
+      return true;
+  }
+  return false;
+}
+
+void OSDMapMapping::PoolMapping::set(
+  ps_t ps, const vector<int>& raw,
+  const vector<int>& up, int up_primary,
+  const vector<int>& acting, int acting_primary)
+{
+  assert(raw.size() <= width);
+  assert(up.size() <= width);
+  assert(acting.size() <= width);
+  int32_t *r = row(ps);
+  r[0] = up_primary;
+  r[1] = acting_primary;
+  r[2] = raw.size();
+  r[3] = up.size();
+  r[4] = acting.size();
+  std::copy(raw.begin(), raw.end(), r + 5);
+  std::copy(up.begin(), up.end(), r + 5 + width);
+  std::copy(acting.begin(), acting.end(), r + 5 + 2 * width);
+}
+
+void OSDMapMapping::PoolMapping::get(
+  ps_t ps, vector<int> *up, int *up_primary,
+  vector<int> *acting, int *acting_primary) const
+{
+  const int32_t *r = row(ps);
+  if (up_primary)
+    *up_primary = r[0];
+  if (acting_primary)
+    *acting_primary = r[1];
+  if (up) {
+    const int32_t *p = r + 5 + width;
+    up->assign(p, p + r[3]);
+  }
+  if (acting) {
+    const int32_t *p = r + 5 + 2 * width;
+    acting->assign(p, p + r[4]);
+  }
+}
+
+unsigned OSDMapMapping::_get_width(const OSDMap& map, int64_t pool_id,
+				   const pg_pool_t& pool)
+{
+  // pg_temp is whatever the primary asked for, so it may be longer
+  // than the pool is wide
+  unsigned width = pool.get_size();
+  for (auto p = map.pg_temp->lower_bound(pg_t(0, pool_id));
+       p != map.pg_temp->end() && p->first.pool() == (uint64_t)pool_id;
+       ++p)
+    width = MAX(width, p->second.size());
+  return width;
+}
+
+bool OSDMapMapping::_same_mapping(const pg_pool_t& a, const pg_pool_t& b)
+{
+  return a.get_pg_num() == b.get_pg_num() &&
+    a.get_pgp_num() == b.get_pgp_num() &&
+    a.get_size() == b.get_size() &&
+    a.get_type() == b.get_type() &&
+    a.get_crush_ruleset() == b.get_crush_ruleset() &&
+    a.has_flag(pg_pool_t::FLAG_HASHPSPOOL) ==
+      b.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+}
+
+void OSDMapMapping::_init_pool(const OSDMap& map, int64_t pool_id,
+			       const pg_pool_t& pool)
+{
+  pools[pool_id].init(pool, _get_width(map, pool_id, pool));
+}
+
+void OSDMapMapping::_map_pg(const OSDMap& map, int64_t pool_id,
+			    PoolMapping& pm, ps_t ps)
+{
+  vector<int> raw, up, acting;
+  int up_primary, acting_primary;
+  map.pg_to_raw_up_acting_osds(pg_t(ps, pool_id), &raw, &up, &up_primary,
+			       &acting, &acting_primary);
+  pm.set(ps, raw, up, up_primary, acting, acting_primary);
+}
+
+void OSDMapMapping::_add_jobs(int64_t pool_id, PoolMapping& pm,
+			      const std::vector<bool> *osds,
+			      std::vector<job_t> *jobs)
+{
+  for (ps_t ps = 0; ps < pm.pool.get_pg_num(); ps += JOB_PGS) {
+    jobs->push_back(job_t{pool_id, &pm, ps,
+	  MIN(ps + JOB_PGS, pm.pool.get_pg_num()), osds});
+  }
+}
+
+void OSDMapMapping::_run(const OSDMap& map, std::vector<job_t>& jobs,
+			 unsigned threads)
+{
+  // jobs write disjoint rows of tables that are already sized, so
+  // workers need nothing but a shared cursor
+  std::atomic<size_t> next = {0};
+  std::atomic<uint64_t> mapped = {0};
+  auto work = [&]() {
+    uint64_t n = 0;
+    for (size_t i = next++; i < jobs.size(); i = next++) {
+      job_t& j = jobs[i];
+      for (ps_t ps = j.begin; ps < j.end; ++ps) {
+	if (j.osds && !j.pm->raw_contains(ps, *j.osds))
+	  continue;
+	_map_pg(map, j.pool_id, *j.pm, ps);
+	++n;
+      }
+    }
+    mapped += n;
+  };
+  threads = MAX(1, MIN(threads, jobs.size()));
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; ++i)
+    workers.emplace_back(work);
+  work();
+  for (auto& t : workers)
+    t.join();
+  num_mapped += mapped;
+}
+
+void OSDMapMapping::_snapshot(const OSDMap& map)
+{
+  int max = map.get_max_osd();
+  osd_state.resize(max);
+  osd_weight.resize(max);
+  osd_affinity.resize(max);
+  for (int o = 0; o < max; ++o) {
+    osd_state[o] = (map.exists(o) ? CEPH_OSD_EXISTS : 0) |
+      (map.is_up(o) ? CEPH_OSD_UP : 0);
+    osd_weight[o] = map.get_weight(o);
+    osd_affinity[o] = map.get_primary_affinity(o);
+  }
+  temp_pgs.clear();
+  for (auto& p : *map.pg_temp)
+    temp_pgs.insert(p.first);
+  for (auto& p : *map.primary_temp)
+    temp_pgs.insert(p.first);
+  epoch = map.get_epoch();
+}
+
+void OSDMapMapping::update(CephContext *cct, const OSDMap& map,
+			   unsigned threads)
+{
+  pools.clear();
+  num_mapped = 0;
+  std::vector<job_t> jobs;
+  for (auto& p : map.get_pools()) {
+    _init_pool(map, p.first, p.second);
+    _add_jobs(p.first, pools[p.first], nullptr, &jobs);
+  }
+  _run(map, jobs, threads);
+  _snapshot(map);
+  ldout(cct, 10) << __func__ << " e" << epoch << " mapped "
+		 << num_mapped << " pgs" << dendl;
+}
+
+void OSDMapMapping::update(CephContext *cct, const OSDMap& map,
+			   const OSDMap::Incremental& inc, unsigned threads)
+{
+  if (epoch == 0 || inc.epoch != epoch + 1 || map.get_epoch() != inc.epoch ||
+      inc.fullmap.length() || inc.crush.length() ||
+      map.get_max_osd() != (int)osd_state.size()) {
+    update(cct, map, threads);
+    return;
+  }
+
+  // which osds moved, and whether anything could now map to an osd
+  // that nothing mapped to before
+  std::vector<bool> changed(map.get_max_osd(), false);
+  bool any_changed = false;
+  for (int o = 0; o < map.get_max_osd(); ++o) {
+    bool exists = map.exists(o);
+    if (exists != !!(osd_state[o] & CEPH_OSD_EXISTS) ||
+	map.get_weight(o) > osd_weight[o]) {
+      update(cct, map, threads);
+      return;
+    }
+    if (map.is_up(o) != !!(osd_state[o] & CEPH_OSD_UP) ||
+	map.get_weight(o) != osd_weight[o] ||
+	map.get_primary_affinity(o) != osd_affinity[o]) {
+      changed[o] = true;
+      any_changed = true;
+    }
+  }
+
+  num_mapped = 0;
+  std::vector<job_t> jobs;
+  for (auto p = pools.begin(); p != pools.end(); ) {
+    if (!map.have_pg_pool(p->first))
+      pools.erase(p++);
+    else
+      ++p;
+  }
+  for (auto& p : map.get_pools()) {
+    auto q = pools.find(p.first);
+    if (q == pools.end() || !_same_mapping(q->second.pool, p.second) ||
+	_get_width(map, p.first, p.second) > q->second.width) {
+      _init_pool(map, p.first, p.second);
+      _add_jobs(p.first, pools[p.first], nullptr, &jobs);
+    } else {
+      q->second.pool = p.second;
+      if (any_changed)
+	_add_jobs(p.first, q->second, &changed, &jobs);
+    }
+  }
+  _run(map, jobs, threads);
+
+  // temp mappings come and go without any osd changing
+  set<pg_t> temps;
+  temps.swap(temp_pgs);
+  for (auto& p : inc.new_pg_temp)
+    temps.insert(p.first);
+  for (auto& p : inc.new_primary_temp)
+    temps.insert(p.first);
+  for (auto& p : *map.pg_temp)
+    temps.insert(p.first);
+  for (auto& p : *map.primary_temp)
+    temps.insert(p.first);
+  for (auto& pgid : temps) {
+    auto q = pools.find(pgid.pool());
+    if (q == pools.end() || pgid.ps() >= q->second.pool.get_pg_num())
+      continue;
+    _map_pg(map, pgid.pool(), q->second, pgid.ps());
+    ++num_mapped;
+  }
+
+  _snapshot(map);
+  ldout(cct, 10) << __func__ << " e" << epoch << " remapped "
+		 << num_mapped << " of " << get_num_pgs()
+		 << " pgs" << dendl;
+}
+
+bool OSDMapMapping::get(pg_t pgid, vector<int> *up, int *up_primary,
+			vector<int> *acting, int *acting_primary) const
+{
+  auto p = pools.find(pgid.pool());
+  if (p == pools.end() || pgid.ps() >= p->second.pool.get_pg_num())
+    return false;
+  p->second.get(pgid.ps(), up, up_primary, acting, acting_primary);
+  return true;
+}
+
+uint64_t OSDMapMapping::get_num_pgs() const
+{
+  uint64_t n = 0;
+  for (auto& p : pools)
+    n += p.second.pool.get_pg_num();
+  return n;
+}
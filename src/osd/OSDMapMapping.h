@@ -0,0 +1,148 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSDMAPMAPPING_H
+#define CEPH_OSDMAPMAPPING_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "osd/OSDMap.h"
+
+/**
+ * OSDMapMapping
+ *
+ * Precomputed pg -> up/acting mapping for every pg of an OSDMap, kept in
+ * one flat table per pool so that a lookup is an index instead of a run
+ * of CRUSH plus the pg_temp and primary_temp lookups.
+ *
+ * A full update() maps every pg, optionally spread over several threads.
+ * Given the Incremental that produced the new map, update() recomputes
+ * only the pgs the Incremental can have moved:
+ *
+ *  - a new crush map, a full map, a changed max_osd, an OSD being
+ *    created or destroyed, or an OSD weight going up: everything
+ *  - a pool whose pg_num, pgp_num, size, type, rule or hashing changed,
+ *    or a new pool: that pool
+ *  - an OSD going up or down, its weight going down, or its primary
+ *    affinity changing: the pgs whose CRUSH mapping contains it (a lower
+ *    weight can only make CRUSH reject the OSD, never pick it)
+ *  - pg_temp or primary_temp changes: those pgs, plus every pg that has
+ *    a temp mapping, since those depend on the state of the temp OSDs
+ */
+class OSDMapMapping {
+  struct PoolMapping {
+    pg_pool_t pool;     ///< the pool as of the last update
+    unsigned width = 0; ///< max osds in a raw, up or acting set
+
+    /**
+     * one row per pg:
+     *
+     * up_primary, acting_primary, #raw, #up, #acting,
+     * raw[width], up[width], acting[width]
+     */
+    std::vector<int32_t> table;
+
+    size_t row_size() const {
+      return 5 + 3 * width;
+    }
+    void init(const pg_pool_t& p, unsigned w) {
+      pool = p;
+      width = w;
+      table.assign(row_size() * pool.get_pg_num(), -1);
+    }
+    const int32_t *row(ps_t ps) const {
+      return &table[ps * row_size()];
+    }
+    int32_t *row(ps_t ps) {
+      return &table[ps * row_size()];
+    }
+    bool raw_contains(ps_t ps, const std::vector<bool>& osds) const;
+    void set(ps_t ps, const vector<int>& raw,
+	     const vector<int>& up, int up_primary,
+	     const vector<int>& acting, int acting_primary);
+    void get(ps_t ps, vector<int> *up, int *up_primary,
+	     vector<int> *acting, int *acting_primary) const;
+  };
+
+  /// a range of pgs of one pool to (re)map
+  struct job_t {
+    int64_t pool_id;
+    PoolMapping *pm;
+    ps_t begin, end;
+    const std::vector<bool> *osds; ///< only pgs mapped to these, if set
+  };
+
+  std::map<int64_t, PoolMapping> pools;
+  epoch_t epoch = 0;
+
+  // osd state as of the last update, to tell what an Incremental changed
+  std::vector<uint8_t> osd_state;   ///< CEPH_OSD_EXISTS | CEPH_OSD_UP
+  std::vector<__u32> osd_weight;
+  std::vector<__u32> osd_affinity;
+  std::set<pg_t> temp_pgs;          ///< pgs with a pg_temp or primary_temp
+
+  uint64_t num_mapped = 0;          ///< pgs mapped by the last update
+
+  static unsigned _get_width(const OSDMap& map, int64_t pool_id,
+			     const pg_pool_t& pool);
+  static bool _same_mapping(const pg_pool_t& a, const pg_pool_t& b);
+  void _init_pool(const OSDMap& map, int64_t pool_id, const pg_pool_t& pool);
+  void _map_pg(const OSDMap& map, int64_t pool_id, PoolMapping& pm, ps_t ps);
+  void _run(const OSDMap& map, std::vector<job_t>& jobs, unsigned threads);
+  void _add_jobs(int64_t pool_id, PoolMapping& pm,
+		 const std::vector<bool> *osds, std::vector<job_t> *jobs);
+  void _snapshot(const OSDMap& map);
+
+public:
+  /// map every pg of map, using up to threads threads
+  void update(CephContext *cct, const OSDMap& map, unsigned threads = 1);
+
+  /**
+   * bring the table up to date with map, which inc was just applied to
+   *
+   * Falls back to a full update if the table is not at inc.epoch - 1.
+   */
+  void update(CephContext *cct, const OSDMap& map,
+	      const OSDMap::Incremental& inc, unsigned threads = 1);
+
+  /**
+   * look up a pg
+   *
+   * @return false if the pg is not in the table (unknown pool, or ps
+   *         beyond pg_num); the outputs are left alone then
+   */
+  bool get(pg_t pgid, vector<int> *up, int *up_primary,
+	   vector<int> *acting, int *acting_primary) const;
+
+  epoch_t get_epoch() const {
+    return epoch;
+  }
+  /// @return number of pgs the last update had to map
+  uint64_t get_num_mapped() const {
+    return num_mapped;
+  }
+  uint64_t get_num_pgs() const;
+
+  void clear() {
+    pools.clear();
+    epoch = 0;
+    osd_state.clear();
+    osd_weight.clear();
+    osd_affinity.clear();
+    temp_pgs.clear();
+    num_mapped = 0;
+  }
+};
+
+#endif
@@ -169,12 +169,18 @@ public:
   void mark_reached_pg() {
     mark_flag_point(flag_reached_pg, "reached_pg");
   }
+  void mark_delayed(const char *s) {
+    mark_flag_point(flag_delayed, s);
+  }
   void mark_delayed(const string& s) {
     mark_flag_point(flag_delayed, s);
   }
   void mark_started() {
     mark_flag_point(flag_started, "started");
   }
+  void mark_sub_op_sent(const char *s) {
+    mark_flag_point(flag_sub_op_sent, s);
+  }
   void mark_sub_op_sent(const string& s) {
     mark_flag_point(flag_sub_op_sent, s);
   }
@@ -197,6 +203,8 @@ public:
 
 private:
   void set_rmw_flags(int flags);
+  /// s must outlive the op
+  void mark_flag_point(uint8_t flag, const char *s);
   void mark_flag_point(uint8_t flag, const string& s);
 };
 
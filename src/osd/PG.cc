@@ -2223,9 +2223,10 @@ void PG::_finish_recovery(Context *c)
   unlock();
 }
 
-void PG::start_recovery_op(const hobject_t& soid)
+void PG::start_recovery_op(const hobject_t& soid, bool batched)
 {
   dout(10) << "start_recovery_op " << soid
+	   << (batched ? " batched" : "")
 #ifdef DEBUG_RECOVERY_OIDS
 	   << " (" << recovering_oids << ")"
 #endif
@@ -2236,7 +2237,9 @@ void PG::start_recovery_op(const hobject_t& soid)
   assert(recovering_oids.count(soid) == 0);
   recovering_oids.insert(soid);
 #endif
-  osd->start_recovery_op(this, soid);
+  if (batched)
+    batched_recovery_ops.insert(soid);
+  osd->start_recovery_op(this, soid, batched);
 }
 
 void PG::finish_recovery_op(const hobject_t& soid, bool dequeue)
@@ -2252,7 +2255,8 @@ void PG::finish_recovery_op(const hobject_t& soid, bool dequeue)
   assert(recovering_oids.count(soid));
   recovering_oids.erase(soid);
 #endif
-  osd->finish_recovery_op(this, soid, dequeue);
+  bool batched = batched_recovery_ops.erase(soid);
+  osd->finish_recovery_op(this, soid, dequeue, batched);
 
   if (!dequeue) {
     queue_recovery();
@@ -2391,6 +2395,8 @@ void PG::clear_recovery_state()
   pg_log.reset_recovery_pointers();
   finish_sync_event = 0;
 
+  while (!batched_recovery_ops.empty())
+    finish_recovery_op(*batched_recovery_ops.begin(), true);
   hobject_t soid;
   while (recovery_ops_active > 0) {
 #ifdef DEBUG_RECOVERY_OIDS
@@ -3892,6 +3898,13 @@ int PG::build_scrub_map_chunk(
   _scan_rollback_obs(rollback_obs, handle);
   _scan_snaps(map);
 
+  if (deep) {
+    uint64_t bytes = 0;
+    for (auto& p : map.objects)
+      bytes += p.second.size;
+    osd->charge_deep_scrub(bytes);
+  }
+
   dout(20) << __func__ << " done" << dendl;
   return 0;
 }
@@ -4143,6 +4156,23 @@ void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
  * scrubber.state encodes the current state of the scrub (refer to state diagram
  * for details).
  */
+struct C_PG_RequeueScrub : public Context {
+  PGRef pg;
+  OSDService *osd;
+  epoch_t epoch;
+  utime_t start;
+  C_PG_RequeueScrub(PG *p, OSDService *o, epoch_t e)
+    : pg(p), osd(o), epoch(e), start(ceph_clock_now()) {}
+  void finish(int r) {
+    pg->lock();
+    if (!pg->pg_has_reset_since(epoch)) {
+      osd->logger->tinc(l_osd_scrub_throttle_lat, ceph_clock_now() - start);
+      pg->requeue_scrub();
+    }
+    pg->unlock();
+  }
+};
+
 void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 {
   // check for map changes
@@ -4157,6 +4187,7 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
   bool done = false;
   int ret;
+  utime_t delay;
 
   while (!done) {
     dout(20) << "scrub state " << Scrubber::state_string(scrubber.state) << dendl;
@@ -4388,7 +4419,18 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
 	if (!(scrubber.end.is_max())) {
           scrubber.state = PG::Scrubber::NEW_CHUNK;
-	  requeue_scrub();
+	  if (scrubber.deep)
+	    delay = osd->get_deep_scrub_wait();
+	  if (delay > utime_t()) {
+	    dout(15) << __func__ << " deep scrub budget used up, next chunk in "
+		     << delay << dendl;
+	    Mutex::Locker l(osd->scrub_sleep_lock);
+	    osd->scrub_sleep_timer.add_event_after(
+	      (double)delay,
+	      new C_PG_RequeueScrub(this, osd, get_osdmap()->get_epoch()));
+	  } else {
+	    requeue_scrub();
+	  }
           done = true;
         } else {
           scrubber.state = PG::Scrubber::FINISH;
@@ -4695,9 +4737,10 @@ void PG::scrub_finish()
   }
 }
 
-void PG::share_pg_info()
+void PG::share_pg_info(
+  map<int, vector<pair<pg_notify_t, pg_interval_map_t> > > *info_map)
 {
-  dout(10) << "share_pg_info" << dendl;
+  dout(10) << "share_pg_info" << (info_map ? " (batched)" : "") << dendl;
 
   // share new pg_info_t with replicas
   assert(!actingbackfill.empty());
@@ -4710,21 +4753,23 @@ void PG::share_pg_info()
       peer_info[peer].last_epoch_started = info.last_epoch_started;
       peer_info[peer].history.merge(info.history);
     }
+    pg_notify_t notify(
+      peer.shard, pg_whoami.shard,
+      get_osdmap()->get_epoch(),
+      get_osdmap()->get_epoch(),
+      info);
+    if (info_map) {
+      (*info_map)[peer.osd].push_back(make_pair(notify, pg_interval_map_t()));
+      continue;
+    }
     MOSDPGInfo *m = new MOSDPGInfo(get_osdmap()->get_epoch());
-    m->pg_list.push_back(
-      make_pair(
-	pg_notify_t(
-	  peer.shard, pg_whoami.shard,
-	  get_osdmap()->get_epoch(),
-	  get_osdmap()->get_epoch(),
-	  info),
-	pg_interval_map_t()));
+    m->pg_list.push_back(make_pair(notify, pg_interval_map_t()));
     osd->send_message_osd_cluster(peer.osd, m, get_osdmap()->get_epoch());
   }
 }
 
 bool PG::append_log_entries_update_missing(
-  const mempool::osd::list<pg_log_entry_t> &entries,
+  const mempool::osd_pglog::list<pg_log_entry_t> &entries,
   ObjectStore::Transaction &t)
 {
   assert(!entries.empty());
@@ -4751,7 +4796,7 @@ bool PG::append_log_entries_update_missing(
 
 
 void PG::merge_new_log_entries(
-  const mempool::osd::list<pg_log_entry_t> &entries,
+  const mempool::osd_pglog::list<pg_log_entry_t> &entries,
   ObjectStore::Transaction &t)
 {
   dout(10) << __func__ << " " << entries << dendl;
@@ -6749,7 +6794,7 @@ PG::RecoveryState::Clean::Clean(my_context ctx)
   pg->finish_recovery(*context< RecoveryMachine >().get_on_safe_context_list());
   pg->mark_clean();
 
-  pg->share_pg_info();
+  pg->share_pg_info(context< RecoveryMachine >().get_info_map());
   pg->publish_stats_to_osd();
 
 }
@@ -7058,7 +7103,7 @@ boost::statechart::result PG::RecoveryState::Active::react(const AllReplicasActi
   pg->info.history.last_epoch_started = pg->info.last_epoch_started;
   pg->dirty_info = true;
 
-  pg->share_pg_info();
+  pg->share_pg_info(context< RecoveryMachine >().get_info_map());
   pg->publish_stats_to_osd();
 
   pg->check_local();
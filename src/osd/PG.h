@@ -516,6 +516,8 @@ public:
   bool recovery_queued;
 
   int recovery_ops_active;
+  /// recovery ops charged to the osd as part of a small object batch
+  set<hobject_t, hobject_t::BitwiseComparator> batched_recovery_ops;
   set<pg_shard_t> waiting_on_backfill;
 #ifdef DEBUG_RECOVERY_OIDS
   set<hobject_t, hobject_t::BitwiseComparator> recovering_oids;
@@ -1080,7 +1082,7 @@ public:
   void clear_recovery_state();
   virtual void _clear_recovery_state() = 0;
   virtual void check_recovery_sources(const OSDMapRef& newmap) = 0;
-  void start_recovery_op(const hobject_t& soid);
+  void start_recovery_op(const hobject_t& soid, bool batched = false);
   void finish_recovery_op(const hobject_t& soid, bool dequeue=false);
 
   void split_into(pg_t child_pgid, PG *child, unsigned split_bits);
@@ -2273,11 +2275,15 @@ public:
   unsigned get_scrub_priority();
 
   /// share pg info after a pg is active
-  void share_pg_info();
+  /// send info to the other shards, or add it to info_map to go out
+  /// with the rest of the peering batch
+  void share_pg_info(
+    map<int, vector<pair<pg_notify_t, pg_interval_map_t> > > *info_map =
+      nullptr);
 
 
   bool append_log_entries_update_missing(
-    const mempool::osd::list<pg_log_entry_t> &entries,
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries,
     ObjectStore::Transaction &t);
 
   /**
@@ -2285,7 +2291,7 @@ public:
    * actingbackfill logs and missings (also missing_loc)
    */
   void merge_new_log_entries(
-    const mempool::osd::list<pg_log_entry_t> &entries,
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries,
     ObjectStore::Transaction &t);
 
   void reset_interval_flush();
@@ -2398,6 +2404,7 @@ public:
   virtual void on_shutdown() = 0;
   virtual void check_blacklisted_watchers() = 0;
   virtual void get_watchers(std::list<obj_watch_item_t>&) = 0;
+  virtual void get_obc_cache_stats(obc_cache_stats_t *stats) = 0;
 
   virtual bool agent_work(int max) = 0;
   virtual bool agent_work(int max, int agent_flush_quota) = 0;
@@ -484,6 +484,34 @@ void PGBackend::be_scan_list(
   }
 }
 
+/*
+ * @return 0 once the whole object verified, -EOPNOTSUPP if the store
+ * keeps no checksums for it, -EIO on a checksum mismatch
+ */
+int PGBackend::be_verify_object(
+  const hobject_t &poid,
+  uint64_t stride,
+  ThreadPool::TPHandle &handle,
+  uint64_t *verified)
+{
+  ghobject_t oid(poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
+  uint64_t pos = 0;
+  int r;
+  while (true) {
+    handle.reset_tp_timeout();
+    r = store->verify(ch, oid, pos, stride);
+    if (r <= 0)
+      break;
+    pos += r;
+    if ((uint64_t)r < stride) {
+      r = 0;
+      break;
+    }
+  }
+  *verified = pos;
+  return r;
+}
+
 bool PGBackend::be_compare_scrub_objects(
   pg_shard_t auth_shard,
   const ScrubMap::object &auth,
@@ -550,6 +550,12 @@ typedef ceph::shared_ptr<const OSDMap> OSDMapRef;
      uint32_t seed,
      ScrubMap::object &o,
      ThreadPool::TPHandle &handle) = 0;
+   /// have the store check its own checksums of poid in stride sized pieces
+   int be_verify_object(
+     const hobject_t &poid,
+     uint64_t stride,
+     ThreadPool::TPHandle &handle,
+     uint64_t *verified);
 
    static PGBackend *build_pg_backend(
      const pg_pool_t &pool,
@@ -31,6 +31,68 @@ using namespace std;
 
 class CephContext;
 
+/**
+ * pg_log_entry_index_t - unique index from a field of a log entry to
+ * the entry
+ *
+ * The key is a pointer to the field in the indexed entry itself rather
+ * than a copy of it.  An hobject_t carries three strings, so a second
+ * copy of each indexed name used to be most of what the index cost per
+ * entry.  The flip side is that an entry must be unindexed (or the
+ * whole index cleared) before it leaves the log, as with the old
+ * pointer values.  set() re-points the key at the new entry when it
+ * replaces an older one, so the key always lives in the indexed entry.
+ */
+template <typename K, K pg_log_entry_t::*field>
+class pg_log_entry_index_t {
+  struct key_t {
+    // equal keys hash the same, so re-pointing this at an equal key in
+    // another entry leaves the node where it is
+    mutable const K *k;
+    explicit key_t(const K *k) : k(k) {}
+    bool operator==(const key_t &o) const {
+      return *k == *o.k;
+    }
+  };
+  struct key_hash_t {
+    size_t operator()(const key_t &key) const {
+      return std::hash<K>()(*key.k);
+    }
+  };
+  typedef mempool::osd_pglog::unordered_map<
+    key_t, pg_log_entry_t*, key_hash_t> map_t;
+  map_t m;
+
+public:
+  typedef typename map_t::const_iterator const_iterator;
+
+  const_iterator begin() const { return m.begin(); }
+  const_iterator end() const { return m.end(); }
+  const_iterator find(const K &k) const { return m.find(key_t(&k)); }
+  size_t count(const K &k) const { return m.count(key_t(&k)); }
+  size_t size() const { return m.size(); }
+  bool empty() const { return m.empty(); }
+  void clear() { m.clear(); }
+
+  /// @return the indexed entry for k, or nullptr
+  pg_log_entry_t *get(const K &k) const {
+    auto p = m.find(key_t(&k));
+    return p == m.end() ? nullptr : p->second;
+  }
+  /// index e under its field, replacing whatever was there
+  void set(pg_log_entry_t *e) {
+    const K *k = &(e->*field);
+    auto p = m.find(key_t(k));
+    if (p == m.end()) {
+      m.insert(std::make_pair(key_t(k), e));
+    } else {
+      p->first.k = k;
+      p->second = e;
+    }
+  }
+  void erase(const K &k) { m.erase(key_t(&k)); }
+};
+
 struct PGLog : DoutPrefixProvider {
   DoutPrefixProvider *prefix_provider;
   string gen_prefix() const {
@@ -79,9 +141,11 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
-    mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
+    // ptrs into log, keyed by the entries' own fields.  be careful!
+    mutable pg_log_entry_index_t<hobject_t, &pg_log_entry_t::soid> objects;
+    mutable pg_log_entry_index_t<osd_reqid_t, &pg_log_entry_t::reqid> caller_ops;
+    mutable mempool::osd_pglog::unordered_multimap<
+      osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
 
     // recovery pointers
     list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -97,7 +161,7 @@ public:
      * It's a reverse_iterator because rend() is a natural representation for
      * tail, and rbegin() works nicely for head.
      */
-    mempool::osd::list<pg_log_entry_t>::reverse_iterator
+    mempool::osd_pglog::list<pg_log_entry_t>::reverse_iterator
       rollback_info_trimmed_to_riter;
 
     template <typename F>
@@ -179,7 +243,7 @@ public:
       advance_can_rollback_to(head, [&](const pg_log_entry_t &entry) {});
     }
 
-    mempool::osd::list<pg_log_entry_t> rewind_from_head(eversion_t newhead) {
+    mempool::osd_pglog::list<pg_log_entry_t> rewind_from_head(eversion_t newhead) {
       auto divergent = pg_log_t::rewind_from_head(newhead);
       index();
       reset_rollback_info_trimmed_to_riter();
@@ -264,15 +328,14 @@ public:
       assert(replay_version);
       assert(user_version);
       assert(return_code);
-      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>::const_iterator p;
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      p = caller_ops.find(r);
-      if (p != caller_ops.end()) {
-	*replay_version = p->second->version;
-	*user_version = p->second->user_version;
-	*return_code = p->second->return_code;
+      const pg_log_entry_t *e = caller_ops.get(r);
+      if (e) {
+	*replay_version = e->version;
+	*user_version = e->user_version;
+	*return_code = e->return_code;
 	return true;
       }
 
@@ -281,7 +344,7 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
+      auto p = extra_caller_ops.find(r);
       if (p != extra_caller_ops.end()) {
 	for (vector<pair<osd_reqid_t, version_t> >::const_iterator i =
 	       p->second->extra_reqids.begin();
@@ -339,13 +402,13 @@ public:
 	   ++i) {
 	if (to_index & PGLOG_INDEXED_OBJECTS) {
 	  if (i->object_is_indexed()) {
-	    objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	    objects.set(const_cast<pg_log_entry_t*>(&(*i)));
 	  }
 	}
 
 	if (to_index & PGLOG_INDEXED_CALLER_OPS) {
 	  if (i->reqid_is_indexed()) {
-	    caller_ops[i->reqid] = const_cast<pg_log_entry_t*>(&(*i));
+	    caller_ops.set(const_cast<pg_log_entry_t*>(&(*i)));
 	  }
 	}
         
@@ -377,14 +440,14 @@ public:
 
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+        pg_log_entry_t *cur = objects.get(e.soid);
+        if (!cur || cur->version < e.version)
+          objects.set(&e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &e;
+	  caller_ops.set(&e);
         }
       }
       if (indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS) {
@@ -405,13 +468,14 @@ public:
     void unindex(pg_log_entry_t& e) {
       // NOTE: this only works if we remove from the _tail_ of the log!
       if (indexed_data & PGLOG_INDEXED_OBJECTS) {
-        if (objects.count(e.soid) && objects[e.soid]->version == e.version)
+        pg_log_entry_t *cur = objects.get(e.soid);
+        if (cur && cur->version == e.version)
           objects.erase(e.soid);
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	  // divergent merge_log indexes new before unindexing old
-          if (caller_ops.count(e.reqid) && caller_ops[e.reqid] == &e)
+          if (caller_ops.get(e.reqid) == &e)
             caller_ops.erase(e.reqid);    
         }
       }
@@ -420,8 +484,7 @@ public:
 	       e.extra_reqids.begin();
              j != e.extra_reqids.end();
              ++j) {
-          for (ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*>::iterator k =
-		 extra_caller_ops.find(j->first);
+          for (auto k = extra_caller_ops.find(j->first);
                k != extra_caller_ops.end() && k->first == j->first;
                ++k) {
             if (k->second == &e) {
@@ -452,11 +515,11 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        objects.set(&(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
-	  caller_ops[e.reqid] = &(log.back());
+	  caller_ops.set(&(log.back()));
         }
       }
       
@@ -711,10 +774,10 @@ public:
 
 protected:
   static void split_by_object(
-    mempool::osd::list<pg_log_entry_t> &entries,
-    map<hobject_t, mempool::osd::list<pg_log_entry_t>, hobject_t::BitwiseComparator> *out_entries) {
+    mempool::osd_pglog::list<pg_log_entry_t> &entries,
+    map<hobject_t, mempool::osd_pglog::list<pg_log_entry_t>, hobject_t::BitwiseComparator> *out_entries) {
     while (!entries.empty()) {
-      mempool::osd::list<pg_log_entry_t> &out_list = (*out_entries)[entries.front().soid];
+      mempool::osd_pglog::list<pg_log_entry_t> &out_list = (*out_entries)[entries.front().soid];
       out_list.splice(out_list.end(), entries, entries.begin());
     }
   }
@@ -743,7 +806,7 @@ protected:
   static void _merge_object_divergent_entries(
     const IndexedLog &log,               ///< [in] log to merge against
     const hobject_t &hoid,               ///< [in] object we are merging
-    const mempool::osd::list<pg_log_entry_t> &entries, ///< [in] entries for hoid to merge
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries, ///< [in] entries for hoid to merge
     const pg_info_t &info,              ///< [in] info for merging entries
     eversion_t olog_can_rollback_to,     ///< [in] rollback boundary
     missing_type &missing,              ///< [in,out] missing to adjust, use
@@ -788,8 +851,7 @@ protected:
 		       << " last_divergent_update: " << last_divergent_update
 		       << dendl;
 
-    ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-      log.objects.find(hoid);
+    auto objiter = log.objects.find(hoid);
     if (objiter != log.objects.end() &&
 	objiter->second->version >= first_divergent_update) {
       /// Case 1)
@@ -925,16 +987,16 @@ protected:
   template <typename missing_type>
   static void _merge_divergent_entries(
     const IndexedLog &log,               ///< [in] log to merge against
-    mempool::osd::list<pg_log_entry_t> &entries,       ///< [in] entries to merge
+    mempool::osd_pglog::list<pg_log_entry_t> &entries,       ///< [in] entries to merge
     const pg_info_t &oinfo,              ///< [in] info for merging entries
     eversion_t olog_can_rollback_to,     ///< [in] rollback boundary
     missing_type &omissing,              ///< [in,out] missing to adjust, use
     LogEntryHandler *rollbacker,         ///< [in] optional rollbacker object
     const DoutPrefixProvider *dpp        ///< [in] logging provider
     ) {
-    map<hobject_t, mempool::osd::list<pg_log_entry_t>, hobject_t::BitwiseComparator > split;
+    map<hobject_t, mempool::osd_pglog::list<pg_log_entry_t>, hobject_t::BitwiseComparator > split;
     split_by_object(entries, &split);
-    for (map<hobject_t, mempool::osd::list<pg_log_entry_t>, hobject_t::BitwiseComparator>::iterator i = split.begin();
+    for (map<hobject_t, mempool::osd_pglog::list<pg_log_entry_t>, hobject_t::BitwiseComparator>::iterator i = split.begin();
 	 i != split.end();
 	 ++i) {
       _merge_object_divergent_entries(
@@ -958,7 +1020,7 @@ protected:
     const pg_log_entry_t& oe,
     const pg_info_t& info,
     LogEntryHandler *rollbacker) {
-    mempool::osd::list<pg_log_entry_t> entries;
+    mempool::osd_pglog::list<pg_log_entry_t> entries;
     entries.push_back(oe);
     _merge_object_divergent_entries(
       log,
@@ -984,7 +1046,7 @@ public:
   static bool append_log_entries_update_missing(
     const hobject_t &last_backfill,
     bool last_backfill_bitwise,
-    const mempool::osd::list<pg_log_entry_t> &entries,
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries,
     bool maintain_rollback,
     IndexedLog *log,
     missing_type &missing,
@@ -1020,7 +1082,7 @@ public:
   bool append_new_log_entries(
     const hobject_t &last_backfill,
     bool last_backfill_bitwise,
-    const mempool::osd::list<pg_log_entry_t> &entries,
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries,
     LogEntryHandler *rollbacker) {
     bool invalidate_stats = append_log_entries_update_missing(
       last_backfill,
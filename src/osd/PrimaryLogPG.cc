@@ -181,17 +181,22 @@ class PrimaryLogPG::C_PG_ObjectContext : public Context {
 
 class PrimaryLogPG::C_OSD_OndiskWriteUnlock : public Context {
   ObjectContextRef obc, obc2, obc3;
+  vector<ObjectContextRef> more;
   public:
   C_OSD_OndiskWriteUnlock(
     ObjectContextRef o,
     ObjectContextRef o2 = ObjectContextRef(),
-    ObjectContextRef o3 = ObjectContextRef()) : obc(o), obc2(o2), obc3(o3) {}
+    ObjectContextRef o3 = ObjectContextRef(),
+    const vector<ObjectContextRef> &more = vector<ObjectContextRef>())
+    : obc(o), obc2(o2), obc3(o3), more(more) {}
   void finish(int r) {
     obc->ondisk_write_unlock();
     if (obc2)
       obc2->ondisk_write_unlock();
     if (obc3)
       obc3->ondisk_write_unlock();
+    for (auto &o : more)
+      o->ondisk_write_unlock();
   }
 };
 
@@ -1575,6 +1580,8 @@ PrimaryLogPG::PrimaryLogPG(OSDService *o, OSDMapRef curmap,
     PGBackend::build_pg_backend(
       _pool.info, curmap, this, coll_t(p), ch, o->store, cct)),
   object_contexts(o->cct, o->cct->_conf->osd_pg_object_context_cache_count),
+  object_contexts_enoent(
+    o->cct->_conf->osd_pg_object_context_enoent_cache_count),
   snapset_contexts_lock("PrimaryLogPG::snapset_contexts_lock"),
   backfills_in_flight(hobject_t::Comparator(true)),
   pending_backfill_updates(hobject_t::Comparator(true)),
@@ -1894,6 +1901,7 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
   if (write_ordered &&
       scrubber.write_blocked_by_scrub(head, get_sort_bitwise())) {
     dout(20) << __func__ << ": waiting for scrub" << dendl;
+    osd->logger->inc(l_osd_op_blocked_by_scrub);
     waiting_for_active.push_back(op);
     op->mark_delayed("waiting for scrub");
     return;
@@ -2124,6 +2132,9 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     return;
   }
 
+  if (r == 0 && do_fast_read(op, obc))
+    return;
+
   // src_oids
   map<hobject_t,ObjectContextRef, hobject_t::BitwiseComparator> src_obc;
   for (vector<OSDOp>::iterator p = m->ops.begin(); p != m->ops.end(); ++p) {
@@ -2322,6 +2333,106 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
   }
 }
 
+/*
+ * A lone READ or STAT of a head object on a replicated pool, with no
+ * write in flight on it, is answered here straight from the backend.
+ * This skips the OpContext (and its copy of the ops), the PGTransaction
+ * and the rw lock, which is most of what a small read costs us.  Every
+ * check do_op made up to this point still applies; anything unusual
+ * falls through to the normal path.
+ *
+ * @return true if the op was handled
+ */
+bool PrimaryLogPG::do_fast_read(OpRequestRef& op, ObjectContextRef& obc)
+{
+  MOSDOp *m = static_cast<MOSDOp*>(op->get_req());
+  if (!cct->_conf->osd_op_fast_read ||
+      pool.info.require_rollback() ||
+      m->ops.size() != 1 ||
+      !op->may_read() || op->may_write() || op->may_cache() ||
+      m->get_snapid() != CEPH_NOSNAP)
+    return false;
+
+  OSDOp& osd_op = m->ops[0];
+  ceph_osd_op& rop = osd_op.op;
+  switch (rop.op) {
+  case CEPH_OSD_OP_READ:
+  case CEPH_OSD_OP_SYNC_READ:
+  case CEPH_OSD_OP_STAT:
+    break;
+  default:
+    return false;
+  }
+
+  const object_info_t& oi = obc->obs.oi;
+  if (!obc->obs.exists || oi.is_whiteout() || oi.is_lost() ||
+      !obc->rwstate.empty())
+    return false;
+
+  dout(20) << __func__ << " " << oi.soid << " " << osd_op << dendl;
+  op->mark_started();
+
+  object_stat_sum_t delta_stats;
+  int result = 0;
+  uint64_t data_off = 0;
+
+  obc->ondisk_read_lock();
+  if (rop.op == CEPH_OSD_OP_STAT) {
+    ::encode(oi.size, osd_op.outdata);
+    ::encode(oi.mtime, osd_op.outdata);
+  } else {
+    // same extent rules as do_osd_ops
+    if (rop.extent.truncate_seq == 1 &&
+	rop.extent.truncate_size == (-1ULL)) {
+      rop.extent.truncate_size = 0;
+      rop.extent.truncate_seq = 0;
+    }
+    uint64_t size = oi.size;
+    if (oi.truncate_seq < rop.extent.truncate_seq &&
+	rop.extent.offset + rop.extent.length > rop.extent.truncate_size)
+      size = rop.extent.truncate_size;
+    if (rop.extent.length == 0)
+      rop.extent.length = size;
+    if (rop.extent.offset >= size) {
+      rop.extent.length = 0;
+    } else {
+      if (rop.extent.offset + rop.extent.length > size)
+	rop.extent.length = size - rop.extent.offset;
+      result = do_sync_read(oi, osd_op);
+    }
+    data_off = rop.extent.offset;
+    delta_stats.num_rd_kb += SHIFT_ROUND_UP(rop.extent.length, 10);
+  }
+  obc->ondisk_read_unlock();
+  delta_stats.num_rd++;
+  unstable_stats.add(delta_stats);
+
+  osd_op.rval = result;
+  if (result < 0 && (rop.flags & CEPH_OSD_OP_FLAG_FAILOK))
+    result = 0;
+  uint64_t bytes_read = osd_op.outdata.length();
+
+  MOSDOpReply *reply = new MOSDOpReply(m, 0, get_osdmap()->get_epoch(), 0,
+				       true);
+  reply->claim_op_out_data(m->ops);
+  reply->get_header().data_off = data_off;
+  if (result >= 0) {
+    log_op_stats(op, 0, bytes_read, utime_t());
+    publish_stats_to_osd();
+    reply->set_reply_versions(eversion_t(), oi.user_version);
+  }
+  reply->set_result(result);
+  reply->add_flags(CEPH_OSD_FLAG_ACK | CEPH_OSD_FLAG_ONDISK);
+  osd->send_message_osd_client(reply, m->get_connection());
+
+  utime_t prepare_latency = ceph_clock_now();
+  prepare_latency -= op->get_dequeued_time();
+  osd->logger->tinc(l_osd_op_prepare_lat, prepare_latency);
+  osd->logger->tinc(l_osd_op_r_prepare_lat, prepare_latency);
+  osd->logger->inc(l_osd_op_r_fast);
+  return true;
+}
+
 void PrimaryLogPG::record_write_error(OpRequestRef op, const hobject_t &soid,
 				      MOSDOpReply *orig_reply, int r)
 {
@@ -2329,7 +2440,7 @@ void PrimaryLogPG::record_write_error(OpRequestRef op, const hobject_t &soid,
   assert(op->may_write());
   const osd_reqid_t &reqid = static_cast<MOSDOp*>(op->get_req())->get_reqid();
   ObjectContextRef obc;
-  mempool::osd::list<pg_log_entry_t> entries;
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
   entries.push_back(pg_log_entry_t(pg_log_entry_t::ERROR, soid,
 				   get_next_version(), eversion_t(), 0,
 				   reqid, utime_t(), r));
@@ -3029,6 +3140,7 @@ void PrimaryLogPG::promote_object(ObjectContextRef obc,
     dout(10) << __func__ << " " << hoid
 	     << " blocked by scrub" << dendl;
     if (op) {
+      osd->logger->inc(l_osd_op_blocked_by_scrub);
       waiting_for_active.push_back(op);
       op->mark_delayed("waiting for scrub");
       dout(10) << __func__ << " " << hoid
@@ -3348,24 +3460,27 @@ void PrimaryLogPG::reply_ctx(OpContext *ctx, int r, eversion_t v, version_t uv)
 
 void PrimaryLogPG::log_op_stats(OpContext *ctx)
 {
-  OpRequestRef op = ctx->op;
+  log_op_stats(ctx->op, ctx->bytes_written, ctx->bytes_read,
+	       ctx->readable_stamp);
+}
+
+void PrimaryLogPG::log_op_stats(OpRequestRef op, uint64_t inb, uint64_t outb,
+				utime_t readable_stamp)
+{
   MOSDOp *m = static_cast<MOSDOp*>(op->get_req());
 
   utime_t now = ceph_clock_now();
   utime_t latency = now;
-  latency -= ctx->op->get_req()->get_recv_stamp();
+  latency -= op->get_req()->get_recv_stamp();
   utime_t process_latency = now;
-  process_latency -= ctx->op->get_dequeued_time();
+  process_latency -= op->get_dequeued_time();
 
   utime_t rlatency;
-  if (ctx->readable_stamp != utime_t()) {
-    rlatency = ctx->readable_stamp;
-    rlatency -= ctx->op->get_req()->get_recv_stamp();
+  if (readable_stamp != utime_t()) {
+    rlatency = readable_stamp;
+    rlatency -= op->get_req()->get_recv_stamp();
   }
 
-  uint64_t inb = ctx->bytes_written;
-  uint64_t outb = ctx->bytes_read;
-
   osd->logger->inc(l_osd_op);
 
   osd->logger->inc(l_osd_op_outb, outb);
@@ -3586,7 +3701,8 @@ void PrimaryLogPG::do_backfill(OpRequestRef op)
   }
 }
 
-PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_t &coid)
+bool PrimaryLogPG::trim_object(
+  bool first, const hobject_t &coid, OpContextUPtr *pctx)
 {
   // load clone info
   bufferlist bl;
@@ -3608,7 +3724,7 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
   set<snapid_t> old_snaps(coi.snaps.begin(), coi.snaps.end());
   if (old_snaps.empty()) {
     osd->clog->error() << __func__ << " No object info snaps for " << coid << "\n";
-    return NULL;
+    return false;
   }
 
   SnapSet& snapset = obc->ssc->snapset;
@@ -3617,7 +3733,7 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
 	   << " old snapset " << snapset << dendl;
   if (snapset.seq == 0) {
     osd->clog->error() << __func__ << " No snapset.seq for " << coid << "\n";
-    return NULL;
+    return false;
   }
 
   set<snapid_t> new_snaps;
@@ -3634,32 +3750,44 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
     p = std::find(snapset.clones.begin(), snapset.clones.end(), coid.snap);
     if (p == snapset.clones.end()) {
       osd->clog->error() << __func__ << " Snap " << coid.snap << " not in clones" << "\n";
-      return NULL;
+      return false;
     }
   }
 
-  OpContextUPtr ctx = simple_opc_create(obc);
-  ctx->snapset_obc = snapset_obc;
-
-  if (!ctx->lock_manager.get_snaptrimmer_write(
+  ObcLockManager manager;
+  if (!manager.get_snaptrimmer_write(
 	coid,
 	obc,
 	first)) {
-    close_op_ctx(ctx.release());
     dout(10) << __func__ << ": Unable to get a wlock on " << coid << dendl;
-    return NULL;
+    return false;
   }
 
-  if (!ctx->lock_manager.get_snaptrimmer_write(
+  // clones of one head share its snapset; a batch locks it once
+  bool have_snapset = *pctx && (*pctx)->lock_manager.has_lock(snapoid);
+  if (!have_snapset &&
+      !manager.get_snaptrimmer_write(
 	snapoid,
 	snapset_obc,
 	first)) {
-    close_op_ctx(ctx.release());
+    release_object_locks(manager);
     dout(10) << __func__ << ": Unable to get a wlock on " << snapoid << dendl;
-    return NULL;
+    return false;
   }
 
-  ctx->at_version = get_next_version();
+  if (!*pctx) {
+    *pctx = simple_opc_create(obc);
+    (*pctx)->snapset_obc = snapset_obc;
+    (*pctx)->at_version = get_next_version();
+  } else {
+    // append to the batch: carry on from its last log entry
+    (*pctx)->at_version.version++;
+    (*pctx)->batch_obcs.push_back(obc);
+    if (!have_snapset)
+      (*pctx)->batch_obcs.push_back(snapset_obc);
+  }
+  OpContext *ctx = pctx->get();
+  ctx->lock_manager.take_locks(std::move(manager));
 
   PGTransaction *t = ctx->op_t.get();
  
@@ -3713,7 +3841,7 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
 	pg_log_entry_t::DELETE,
 	coid,
 	ctx->at_version,
-	ctx->obs->oi.version,
+	coi.version,
 	0,
 	osd_reqid_t(),
 	ctx->mtime,
@@ -3759,6 +3887,20 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
   // save head snapset
   dout(10) << coid << " new snapset " << snapset << dendl;
 
+  // a batch logs the snapset once: a later clone of the same head
+  // replaces the batch's entry for it rather than adding another (EC
+  // keeps rollback info for the first entry of each object only)
+  eversion_t snapset_prior = snapset_obc->obs.oi.version;
+  if (have_snapset) {
+    for (auto i = ctx->log.begin(); i != ctx->log.end(); ++i) {
+      if (i->soid == snapoid) {
+	snapset_prior = i->prior_version;
+	ctx->log.erase(i);
+	break;
+      }
+    }
+  }
+
   if (snapset.clones.empty() && !snapset.head_exists) {
     dout(10) << coid << " removing " << snapoid << dendl;
     ctx->log.push_back(
@@ -3766,14 +3908,14 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
 	pg_log_entry_t::DELETE,
 	snapoid,
 	ctx->at_version,
-	ctx->snapset_obc->obs.oi.version,
+	snapset_prior,
 	0,
 	osd_reqid_t(),
 	ctx->mtime,
 	0)
       );
 
-    ctx->snapset_obc->obs.exists = false;
+    snapset_obc->obs.exists = false;
     
     t->remove(snapoid);
   } else {
@@ -3786,16 +3928,15 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
 	pg_log_entry_t::MODIFY,
 	snapoid,
 	ctx->at_version,
-	ctx->snapset_obc->obs.oi.version,
+	snapset_prior,
 	0,
 	osd_reqid_t(),
 	ctx->mtime,
 	0)
       );
 
-    ctx->snapset_obc->obs.oi.prior_version =
-      ctx->snapset_obc->obs.oi.version;
-    ctx->snapset_obc->obs.oi.version = ctx->at_version;
+    snapset_obc->obs.oi.prior_version = snapset_prior;
+    snapset_obc->obs.oi.version = ctx->at_version;
 
     map <string, bufferlist> attrs;
     bl.clear();
@@ -3803,12 +3944,12 @@ PrimaryLogPG::OpContextUPtr PrimaryLogPG::trim_object(bool first, const hobject_
     attrs[SS_ATTR].claim(bl);
 
     bl.clear();
-    ::encode(ctx->snapset_obc->obs.oi, bl, get_osdmap()->get_up_osd_features());
+    ::encode(snapset_obc->obs.oi, bl, get_osdmap()->get_up_osd_features());
     attrs[OI_ATTR].claim(bl);
     t->setattrs(snapoid, attrs);
   }
 
-  return ctx;
+  return true;
 }
 
 void PrimaryLogPG::kick_snap_trim()
@@ -4328,6 +4469,37 @@ void PrimaryLogPG::maybe_create_new_object(
   }
 }
 
+int PrimaryLogPG::do_sync_read(const object_info_t& oi, OSDOp& osd_op)
+{
+  const hobject_t& soid = oi.soid;
+  ceph_osd_op& op = osd_op.op;
+  int result = 0;
+  int r = pgbackend->objects_read_sync(
+    soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
+  if (r >= 0)
+    op.extent.length = r;
+  else {
+    result = r;
+    op.extent.length = 0;
+  }
+  dout(10) << " read got " << r << " / " << op.extent.length
+	   << " bytes from obj " << soid << dendl;
+
+  // whole object?  can we verify the checksum?
+  if (op.extent.length == oi.size && oi.is_data_digest()) {
+    uint32_t crc = osd_op.outdata.crc32c(-1);
+    if (oi.data_digest != crc) {
+      osd->clog->error() << info.pgid << std::hex
+			 << " full-object read crc 0x" << crc
+			 << " != expected 0x" << oi.data_digest
+			 << std::dec << " on " << soid;
+      // FIXME fall back to replica or something?
+      result = -EIO;
+    }
+  }
+  return result;
+}
+
 int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 {
   int result = 0;
@@ -4466,29 +4638,9 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 				soid, op.flags))));
 	  dout(10) << " async_read noted for " << soid << dendl;
 	} else {
-	  int r = pgbackend->objects_read_sync(
-	    soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
-	  if (r >= 0)
-	    op.extent.length = r;
-	  else {
+	  int r = do_sync_read(oi, osd_op);
+	  if (r < 0)
 	    result = r;
-	    op.extent.length = 0;
-	  }
-	  dout(10) << " read got " << r << " / " << op.extent.length
-		   << " bytes from obj " << soid << dendl;
-
-	  // whole object?  can we verify the checksum?
-	  if (op.extent.length == oi.size && oi.is_data_digest()) {
-	    uint32_t crc = osd_op.outdata.crc32c(-1);
-	    if (oi.data_digest != crc) {
-	      osd->clog->error() << info.pgid << std::hex
-				 << " full-object read crc 0x" << crc
-				 << " != expected 0x" << oi.data_digest
-				 << std::dec << " on " << soid;
-	      // FIXME fall back to replica or something?
-	      result = -EIO;
-	    }
-	  }
 	}
 	if (first_read) {
 	  first_read = false;
@@ -6729,13 +6881,22 @@ void PrimaryLogPG::do_osd_op_effects(OpContext *ctx, const ConnectionRef& conn)
       dout(10) << "notify_ack " << make_pair(p->watch_cookie.get(), p->notify_id) << dendl;
     else
       dout(10) << "notify_ack " << make_pair("NULL", p->notify_id) << dendl;
+    if (p->watch_cookie) {
+      // watchers are keyed by (cookie, entity), so go straight to it
+      // instead of scanning every watcher of the object for each ack
+      auto i = ctx->obc->watchers.find(
+	make_pair(p->watch_cookie.get(), entity));
+      if (i != ctx->obc->watchers.end()) {
+	dout(10) << "acking notify on watch " << i->first << dendl;
+	i->second->notify_ack(p->notify_id, p->reply_bl);
+      }
+      continue;
+    }
     for (map<pair<uint64_t, entity_name_t>, WatchRef>::iterator i =
 	   ctx->obc->watchers.begin();
 	 i != ctx->obc->watchers.end();
 	 ++i) {
       if (i->first.second != entity) continue;
-      if (p->watch_cookie &&
-	  p->watch_cookie.get() != i->first.first) continue;
       dout(10) << "acking notify on watch " << i->first << dendl;
       i->second->notify_ack(p->notify_id, p->reply_bl);
     }
@@ -8634,13 +8795,18 @@ void PrimaryLogPG::issue_repop(RepGather *repop, OpContext *ctx)
     unlock_snapset_obc = true;
     ctx->op_t->add_obc(ctx->snapset_obc);
   }
+  for (auto &obc : ctx->batch_obcs) {
+    obc->ondisk_write_lock();
+    ctx->op_t->add_obc(obc);
+  }
 
   Context *on_all_commit = new C_OSD_RepopCommit(this, repop);
   Context *on_all_applied = new C_OSD_RepopApplied(this, repop);
   Context *onapplied_sync = new C_OSD_OndiskWriteUnlock(
     ctx->obc,
     ctx->clone_obc,
-    unlock_snapset_obc ? ctx->snapset_obc : ObjectContextRef());
+    unlock_snapset_obc ? ctx->snapset_obc : ObjectContextRef(),
+    ctx->batch_obcs);
   if (!(ctx->log.empty())) {
     assert(ctx->at_version >= projected_last_update);
     projected_last_update = ctx->at_version;
@@ -8755,7 +8921,7 @@ void PrimaryLogPG::simple_opc_submit(OpContextUPtr ctx)
 
 
 void PrimaryLogPG::submit_log_entries(
-  const mempool::osd::list<pg_log_entry_t> &entries,
+  const mempool::osd_pglog::list<pg_log_entry_t> &entries,
   ObcLockManager &&manager,
   boost::optional<std::function<void(void)> > &&_on_complete,
   OpRequestRef op,
@@ -9057,6 +9223,36 @@ void PrimaryLogPG::handle_watch_timeout(WatchRef watch)
   simple_opc_submit(std::move(ctx));
 }
 
+bool PrimaryLogPG::is_known_enoent(const hobject_t& soid)
+{
+  eversion_t v;
+  if (!object_contexts_enoent.lookup(soid, &v))
+    return false;
+  // every write to the object since the lookup is in the log unless
+  // the log has been trimmed past it
+  if (pg_log.get_tail() <= v) {
+    const pg_log_entry_t *e = pg_log.get_log().logged_object(soid) ?
+      pg_log.get_log().objects.get(soid) : nullptr;
+    if (!e || e->version <= v)
+      return true;
+  }
+  object_contexts_enoent.clear(soid);
+  return false;
+}
+
+void PrimaryLogPG::clear_object_contexts()
+{
+  pinned_object_contexts.clear();
+  object_contexts_enoent.clear();
+  object_contexts.clear();
+}
+
+void PrimaryLogPG::get_obc_cache_stats(obc_cache_stats_t *stats)
+{
+  *stats = obc_cache_stats;
+  stats->pinned = pinned_object_contexts.size();
+}
+
 ObjectContextRef PrimaryLogPG::create_object_context(const object_info_t& oi,
 						     SnapSetContext *ssc)
 {
@@ -9066,6 +9262,7 @@ ObjectContextRef PrimaryLogPG::create_object_context(const object_info_t& oi,
   obc->obs.oi = oi;
   obc->obs.exists = false;
   obc->ssc = ssc;
+  object_contexts_enoent.clear(oi.soid);
   if (ssc)
     register_snapset_context(ssc);
   dout(10) << "create_object_context " << (void*)obc.get() << " " << oi.soid << " " << dendl;
@@ -9088,10 +9285,24 @@ ObjectContextRef PrimaryLogPG::get_object_context(const hobject_t& soid,
   osd->logger->inc(l_osd_object_ctx_cache_total);
   if (obc) {
     osd->logger->inc(l_osd_object_ctx_cache_hit);
+    ++obc_cache_stats.hits;
     dout(10) << __func__ << ": found obc in cache: " << obc
 	     << dendl;
+    unsigned pin_hits = cct->_conf->osd_pg_object_context_pin_hits;
+    if (pin_hits && ++obc->cache_hits == pin_hits &&
+	pinned_object_contexts.size() <
+	  (unsigned)cct->_conf->osd_pg_object_context_pin_count) {
+      dout(10) << __func__ << ": pinning hot obc " << soid << dendl;
+      pinned_object_contexts[soid] = obc;
+    }
+  } else if (!attrs && !can_create && is_known_enoent(soid)) {
+    ++obc_cache_stats.enoent_hits;
+    dout(10) << __func__ << ": no obc for soid " << soid
+	     << " (cached) and !can_create" << dendl;
+    return ObjectContextRef();   // -ENOENT!
   } else {
     dout(10) << __func__ << ": obc NOT found in cache: " << soid << dendl;
+    ++obc_cache_stats.misses;
     // check disk
     bufferlist bv;
     if (attrs) {
@@ -9104,6 +9315,8 @@ ObjectContextRef PrimaryLogPG::get_object_context(const hobject_t& soid,
 	  dout(10) << __func__ << ": no obc for soid "
 		   << soid << " and !can_create"
 		   << dendl;
+	  if (cct->_conf->osd_pg_object_context_enoent_cache_count)
+	    object_contexts_enoent.add(soid, pg_log.get_head());
 	  return ObjectContextRef();   // -ENOENT!
 	}
 
@@ -9139,6 +9352,7 @@ ObjectContextRef PrimaryLogPG::get_object_context(const hobject_t& soid,
     obc->destructor_callback = new C_PG_ObjectContext(this, obc.get());
     obc->obs.oi = oi;
     obc->obs.exists = true;
+    object_contexts_enoent.clear(soid);
 
     obc->ssc = get_snapset_context(
       soid, true,
@@ -9920,7 +10134,7 @@ void PrimaryLogPG::mark_all_unfound_lost(
   pg_log.get_log().print(*_dout);
   *_dout << dendl;
 
-  mempool::osd::list<pg_log_entry_t> log_entries;
+  mempool::osd_pglog::list<pg_log_entry_t> log_entries;
 
   utime_t mtime = ceph_clock_now();
   map<hobject_t, pg_missing_item, hobject_t::ComparatorWithDefault>::const_iterator m =
@@ -10151,7 +10365,7 @@ void PrimaryLogPG::on_shutdown()
   pgbackend->on_change();
 
   context_registry_on_change();
-  object_contexts.clear();
+  clear_object_contexts();
 
   osd->remote_reserver.cancel_reservation(info.pgid);
   osd->local_reserver.cancel_reservation(info.pgid);
@@ -10319,7 +10533,7 @@ void PrimaryLogPG::on_change(ObjectStore::Transaction *t)
   // we don't want to cache object_contexts through the interval change
   // NOTE: we actually assert that all currently live references are dead
   // by the time the flush for the next interval completes.
-  object_contexts.clear();
+  clear_object_contexts();
 
   // should have been cleared above by finishing all of the degraded objects
   assert(objects_blocked_on_degraded_snap.empty());
@@ -11053,10 +11267,16 @@ uint64_t PrimaryLogPG::recover_backfill(
 
   unsigned ops = 0;
   vector<boost::tuple<hobject_t, eversion_t,
-                      ObjectContextRef, vector<pg_shard_t> > > to_push;
+                      ObjectContextRef, vector<pg_shard_t>, bool> > to_push;
   vector<boost::tuple<hobject_t, eversion_t, pg_shard_t> > to_remove;
   set<hobject_t, hobject_t::BitwiseComparator> add_to_stat;
 
+  // small objects go out osd_max_push_objects to a push message, so let
+  // that many of them share one op
+  uint64_t small_size = cct->_conf->osd_recovery_small_object_size;
+  unsigned batch_max = cct->_conf->osd_max_push_objects;
+  unsigned batch_len = 0;
+
   for (set<pg_shard_t>::iterator i = backfill_targets.begin();
        i != backfill_targets.end();
        ++i) {
@@ -11066,7 +11286,9 @@ uint64_t PrimaryLogPG::recover_backfill(
   }
   backfill_info.trim_to(last_backfill_started);
 
-  while (ops < max) {
+  while (ops < max || (batch_len && batch_len < batch_max)) {
+    // past max we may only top up the open batch of small objects
+    bool batch_only = ops >= max;
     if (cmp(backfill_info.begin, earliest_peer_backfill(),
 	    get_sort_bitwise()) <= 0 &&
 	!backfill_info.extends_to_end() && backfill_info.empty()) {
@@ -11079,7 +11301,7 @@ uint64_t PrimaryLogPG::recover_backfill(
 
     dout(20) << "   my backfill interval " << backfill_info << dendl;
 
-    bool sent_scan = false;
+    bool sent_scan = false, scan_later = false;
     for (set<pg_shard_t>::iterator i = backfill_targets.begin();
 	 i != backfill_targets.end();
 	 ++i) {
@@ -11089,6 +11311,10 @@ uint64_t PrimaryLogPG::recover_backfill(
       dout(20) << " peer shard " << bt << " backfill " << pbi << dendl;
       if (cmp(pbi.begin, backfill_info.begin, get_sort_bitwise()) <= 0 &&
 	  !pbi.extends_to_end() && pbi.empty()) {
+	if (batch_only) {
+	  scan_later = true;
+	  break;
+	}
 	dout(10) << " scanning peer osd." << bt << " from " << pbi.end << dendl;
 	epoch_t e = get_osdmap()->get_epoch();
 	MOSDPGScan *m = new MOSDPGScan(
@@ -11102,6 +11328,9 @@ uint64_t PrimaryLogPG::recover_backfill(
       }
     }
 
+    if (scan_later)
+      break;
+
     // Count simultaneous scans as a single op and let those complete
     if (sent_scan) {
       ops++;
@@ -11233,6 +11462,11 @@ uint64_t PrimaryLogPG::recover_backfill(
       if (!need_ver_targs.empty() || !missing_targs.empty()) {
 	ObjectContextRef obc = get_object_context(backfill_info.begin, false);
 	assert(obc);
+	bool batched = batch_max > 1 &&
+	  obc->obs.oi.size <= small_size &&
+	  !obc->obs.oi.is_omap();
+	if (batch_only && !batched)
+	  break;
 	if (obc->get_recovery_read()) {
 	  if (!need_ver_targs.empty()) {
 	    dout(20) << " BACKFILL replacing " << check
@@ -11248,10 +11482,19 @@ uint64_t PrimaryLogPG::recover_backfill(
 	  all_push.insert(all_push.end(), missing_targs.begin(), missing_targs.end());
 
 	  to_push.push_back(
-	    boost::tuple<hobject_t, eversion_t, ObjectContextRef, vector<pg_shard_t> >
-	    (backfill_info.begin, obj_v, obc, all_push));
-	  // Count all simultaneous pushes of the same object as a single op
-	  ops++;
+	    boost::tuple<hobject_t, eversion_t, ObjectContextRef,
+	                 vector<pg_shard_t>, bool>
+	    (backfill_info.begin, obj_v, obc, all_push, batched));
+	  // Count all simultaneous pushes of the same object as a single op,
+	  // and a batch of small objects as one op too
+	  if (!batched) {
+	    ops++;
+	  } else if (batch_len == 0 || batch_len == batch_max) {
+	    ops++;
+	    batch_len = 1;
+	  } else {
+	    batch_len++;
+	  }
 	} else {
 	  *work_started = true;
 	  dout(20) << "backfill blocking on " << backfill_info.begin
@@ -11307,7 +11550,7 @@ uint64_t PrimaryLogPG::recover_backfill(
   for (unsigned i = 0; i < to_push.size(); ++i) {
     handle.reset_tp_timeout();
     prep_backfill_object_push(to_push[i].get<0>(), to_push[i].get<1>(),
-	    to_push[i].get<2>(), to_push[i].get<3>(), h);
+	    to_push[i].get<2>(), to_push[i].get<3>(), to_push[i].get<4>(), h);
   }
   pgbackend->run_recovery_op(h, get_recovery_op_priority());
 
@@ -11403,9 +11646,11 @@ void PrimaryLogPG::prep_backfill_object_push(
   hobject_t oid, eversion_t v,
   ObjectContextRef obc,
   vector<pg_shard_t> peers,
+  bool batched,
   PGBackend::RecoveryHandle *h)
 {
-  dout(10) << "push_backfill_object " << oid << " v " << v << " to peers " << peers << dendl;
+  dout(10) << "push_backfill_object " << oid << " v " << v << " to peers " << peers
+	   << (batched ? " batched" : "") << dendl;
   assert(!peers.empty());
 
   backfills_in_flight.insert(oid);
@@ -11417,7 +11662,7 @@ void PrimaryLogPG::prep_backfill_object_push(
 
   assert(!recovering.count(oid));
 
-  start_recovery_op(oid);
+  start_recovery_op(oid, batched);
   recovering.insert(make_pair(oid, obc));
 
   // We need to take the read_lock here in order to flush in-progress writes
@@ -11699,7 +11944,7 @@ void PrimaryLogPG::hit_set_create()
   HitSet::Params params(pool.info.hit_set_params);
 
   dout(20) << __func__ << " " << params << dendl;
-  if (pool.info.hit_set_params.get_type() == HitSet::TYPE_BLOOM) {
+  if (HitSet::is_bloom_type(pool.info.hit_set_params.get_type())) {
     BloomHitSet::Params *p =
       static_cast<BloomHitSet::Params*>(params.impl.get());
 
@@ -12643,6 +12888,10 @@ void PrimaryLogPG::agent_estimate_temp(const hobject_t& oid, int *temp)
   assert(hit_set);
   assert(temp);
   *temp = 0;
+  // get every set we may look at loading before testing any of them
+  hit_set->prefetch(oid);
+  for (auto& p : agent_state->hit_set_map)
+    p.second->prefetch(oid);
   if (hit_set->contains(oid))
     *temp = 1000000;
   unsigned i = 0;
@@ -13313,8 +13562,11 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
 
   ldout(pg->cct, 10) << "AwaitAsyncWork: trimming snap " << snap_to_trim << dendl;
 
+  // up to osd_pg_max_concurrent_snap_trims repops in flight, each
+  // trimming a batch of clones in one transaction
   vector<hobject_t> to_trim;
-  unsigned max = pg->cct->_conf->osd_pg_max_concurrent_snap_trims;
+  unsigned batch = pg->osd->get_snap_trim_batch();
+  unsigned max = pg->cct->_conf->osd_pg_max_concurrent_snap_trims * batch;
   to_trim.reserve(max);
   int r = pg->snap_mapper.get_next_objects_to_trim(
     snap_to_trim,
@@ -13349,11 +13601,32 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
   }
   assert(!to_trim.empty());
 
+  OpContextUPtr ctx;
+  vector<hobject_t> batched;
+  auto submit = [&]() {
+    in_flight.insert(batched.begin(), batched.end());
+    ctx->register_on_success(
+      [pg, batched, &in_flight]() {
+	for (auto &object : batched) {
+	  assert(in_flight.find(object) != in_flight.end());
+	  in_flight.erase(object);
+	}
+	if (in_flight.empty())
+	  pg->snap_trimmer_machine.process_event(RepopsComplete());
+      });
+    pg->simple_opc_submit(std::move(ctx));
+    batched.clear();
+  };
+
   for (auto &&object: to_trim) {
     // Get next
     ldout(pg->cct, 10) << "AwaitAsyncWork react trimming " << object << dendl;
-    OpContextUPtr ctx = pg->trim_object(in_flight.empty(), object);
-    if (!ctx) {
+    if (ctx && !pg->trim_object(false, object, &ctx)) {
+      // send what we have and try this one on its own
+      submit();
+    }
+    if (!ctx &&
+	!pg->trim_object(in_flight.empty(), object, &ctx)) {
       ldout(pg->cct, 10) << "could not get write lock on obj "
 			 << object << dendl;
       if (in_flight.empty()) {
@@ -13368,17 +13641,12 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
       }
     }
 
-    in_flight.insert(object);
-    ctx->register_on_success(
-      [pg, object, &in_flight]() {
-	assert(in_flight.find(object) != in_flight.end());
-	in_flight.erase(object);
-	if (in_flight.empty())
-	  pg->snap_trimmer_machine.process_event(RepopsComplete());
-      });
-
-    pg->simple_opc_submit(std::move(ctx));
+    batched.push_back(object);
+    if (batched.size() >= batch)
+      submit();
   }
+  if (ctx)
+    submit();
 
   return transit< WaitRepops >();
 }
@@ -24,6 +24,7 @@
 #include "TierAgentState.h"
 #include "messages/MOSDOpReply.h"
 #include "common/sharedptr_registry.hpp"
+#include "common/simple_cache.hpp"
 #include "ReplicatedBackend.h"
 #include "PGTransaction.h"
 
@@ -507,6 +508,7 @@ public:
     map<hobject_t,ObjectContextRef, hobject_t::BitwiseComparator> src_obc;
     ObjectContextRef clone_obc;    // if we created a clone
     ObjectContextRef snapset_obc;  // if we created/deleted a snapdir
+    vector<ObjectContextRef> batch_obcs; // further objects written (snap trim)
 
     int data_off;        // FIXME: we may want to kill this msgr hint off at some point!
 
@@ -855,7 +857,7 @@ protected:
    * Also used to store error log entries for dup detection.
    */
   void submit_log_entries(
-    const mempool::osd::list<pg_log_entry_t> &entries,
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries,
     ObcLockManager &&manager,
     boost::optional<std::function<void(void)> > &&on_complete,
     OpRequestRef op = OpRequestRef(),
@@ -926,6 +928,19 @@ protected:
 
   // projected object info
   SharedLRU<hobject_t, ObjectContext, hobject_t::ComparatorWithDefault> object_contexts;
+  /**
+   * objects found not to exist, with the log head as of the lookup
+   *
+   * An entry only stands while the log still covers everything since
+   * then and has nothing newer for the object; see is_known_enoent().
+   * Creating or loading an obc for the object drops it as well.
+   */
+  SimpleLRU<hobject_t, eversion_t, hobject_t::BitwiseComparator> object_contexts_enoent;
+  /// hot object contexts, kept cached through scans that churn the lru
+  map<hobject_t, ObjectContextRef, hobject_t::BitwiseComparator> pinned_object_contexts;
+  obc_cache_stats_t obc_cache_stats;
+  bool is_known_enoent(const hobject_t& soid);
+  void clear_object_contexts();
   // map from oid.snapdir() to SnapSetContext *
   map<hobject_t, SnapSetContext*, hobject_t::BitwiseComparator> snapset_contexts;
   Mutex snapset_contexts_lock;
@@ -937,6 +952,7 @@ protected:
   void check_blacklisted_obc_watchers(ObjectContextRef obc);
   void check_blacklisted_watchers() override;
   void get_watchers(list<obj_watch_item_t> &pg_watchers) override;
+  void get_obc_cache_stats(obc_cache_stats_t *stats) override;
   void get_obc_watchers(ObjectContextRef obc, list<obj_watch_item_t> &pg_watchers);
 public:
   void handle_watch_timeout(WatchRef watch);
@@ -1088,6 +1104,8 @@ protected:
   void reply_ctx(OpContext *ctx, int err, eversion_t v, version_t uv);
   void make_writeable(OpContext *ctx);
   void log_op_stats(OpContext *ctx);
+  void log_op_stats(OpRequestRef op, uint64_t inb, uint64_t outb,
+		    utime_t readable_stamp);
 
   void write_update_size_and_usage(object_stat_sum_t& stats, object_info_t& oi,
 				   interval_set<uint64_t>& modified, uint64_t offset,
@@ -1205,6 +1223,7 @@ protected:
   void prep_backfill_object_push(
     hobject_t oid, eversion_t v, ObjectContextRef obc,
     vector<pg_shard_t> peers,
+    bool batched,
     PGBackend::RecoveryHandle *h);
   void send_remove_op(const hobject_t& oid, eversion_t v, pg_shard_t peer);
 
@@ -1346,6 +1365,7 @@ public:
     OpRequestRef& op,
     ThreadPool::TPHandle &handle) override;
   void do_op(OpRequestRef& op) override;
+  bool do_fast_read(OpRequestRef& op, ObjectContextRef& obc);
   void record_write_error(OpRequestRef op, const hobject_t &soid,
 			  MOSDOpReply *orig_reply, int r);
   bool pg_op_must_wait(MOSDOp *op);
@@ -1357,11 +1377,12 @@ public:
     ThreadPool::TPHandle &handle) override;
   void do_backfill(OpRequestRef op) override;
 
-  OpContextUPtr trim_object(bool first, const hobject_t &coid);
+  bool trim_object(bool first, const hobject_t &coid, OpContextUPtr *ctx);
   void snap_trimmer(epoch_t e) override;
   void kick_snap_trim() override;
   void snap_trimmer_scrub_complete() override;
   int do_osd_ops(OpContext *ctx, vector<OSDOp>& ops);
+  int do_sync_read(const object_info_t& oi, OSDOp& osd_op);
 
   int _get_tmap(OpContext *ctx, bufferlist *header, bufferlist *vals);
   int do_tmap2omap(OpContext *ctx, unsigned flags);
@@ -732,25 +732,37 @@ void ReplicatedBackend::be_deep_scrub(
   bufferhash h(seed), oh(seed);
   bufferlist bl, hdrbl;
   int r;
-  __u64 pos = 0;
+  uint64_t pos = 0;
 
   uint32_t fadvise_flags = CEPH_OSD_OP_FLAG_FADVISE_SEQUENTIAL | CEPH_OSD_OP_FLAG_FADVISE_DONTNEED;
 
-  while (true) {
-    handle.reset_tp_timeout();
-    r = store->read(
-	  ch,
-	  ghobject_t(
-	    poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-	  pos,
-	  cct->_conf->osd_deep_scrub_stride, bl,
-	  fadvise_flags, true);
-    if (r <= 0)
-      break;
+  // a store checksummed object verifies in place; its checksums are
+  // local to the store though, so there is no digest to compare
+  r = -EOPNOTSUPP;
+  if (cct->_conf->osd_deep_scrub_csum_only)
+    r = be_verify_object(poid, cct->_conf->osd_deep_scrub_stride, handle, &pos);
+  if (r == -EOPNOTSUPP) {
+    pos = 0;
+    while (true) {
+      handle.reset_tp_timeout();
+      r = store->read(
+	    ch,
+	    ghobject_t(
+	      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+	    pos,
+	    cct->_conf->osd_deep_scrub_stride, bl,
+	    fadvise_flags, true);
+      if (r <= 0)
+	break;
 
-    h << bl;
-    pos += bl.length();
-    bl.clear();
+      h << bl;
+      pos += bl.length();
+      bl.clear();
+    }
+    if (r != -EIO) {
+      o.digest = h.digest();
+      o.digest_present = true;
+    }
   }
   if (r == -EIO) {
     dout(25) << __func__ << "  " << poid << " got "
@@ -758,8 +770,6 @@ void ReplicatedBackend::be_deep_scrub(
     o.read_error = true;
     return;
   }
-  o.digest = h.digest();
-  o.digest_present = true;
 
   bl.clear();
   r = store->omap_get_header(
@@ -978,9 +988,10 @@ Message * ReplicatedBackend::generate_subop(
   eversion_t pg_roll_forward_to,
   hobject_t new_temp_oid,
   hobject_t discard_temp_oid,
-  const vector<pg_log_entry_t> &log_entries,
+  const bufferlist &log_bl,
   boost::optional<pg_hit_set_history_t> &hset_hist,
-  ObjectStore::Transaction &op_t,
+  const bufferlist &op_t_bl,
+  unsigned op_t_data_off,
   pg_shard_t peer,
   const pg_info_t &pinfo)
 {
@@ -1003,11 +1014,11 @@ Message * ReplicatedBackend::generate_subop(
     ObjectStore::Transaction t;
     ::encode(t, wr->get_data());
   } else {
-    ::encode(op_t, wr->get_data());
-    wr->get_header().data_off = op_t.get_data_alignment();
+    wr->set_data(op_t_bl);
+    wr->get_header().data_off = op_t_data_off;
   }
 
-  ::encode(log_entries, wr->logbl);
+  wr->logbl = log_bl;
 
   if (pinfo.is_incomplete())
     wr->pg_stats = pinfo.stats;  // reflects backfill progress
@@ -1046,6 +1057,17 @@ void ReplicatedBackend::issue_op(
     if (op->op)
       op->op->mark_sub_op_sent(ss.str());
   }
+
+  // encode the transaction and log entries once; each replica's message
+  // shares the same buffers
+  bufferlist op_t_bl, log_bl;
+  unsigned op_t_data_off = 0;
+  if (parent->get_actingbackfill_shards().size() > 1) {
+    ::encode(op_t, op_t_bl);
+    op_t_data_off = op_t.get_data_alignment();
+    ::encode(log_entries, log_bl);
+  }
+
   for (set<pg_shard_t>::const_iterator i =
 	 parent->get_actingbackfill_shards().begin();
        i != parent->get_actingbackfill_shards().end();
@@ -1064,9 +1086,10 @@ void ReplicatedBackend::issue_op(
       pg_roll_forward_to,
       new_temp_oid,
       discard_temp_oid,
-      log_entries,
+      log_bl,
       hset_hist,
-      op_t,
+      op_t_bl,
+      op_t_data_off,
       peer,
       pinfo);
 
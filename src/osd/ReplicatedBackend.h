@@ -365,6 +365,7 @@ public:
     );
 
 private:
+  /// op_t_bl and log_bl are encoded once by the caller and shared
   Message * generate_subop(
     const hobject_t &soid,
     const eversion_t &at_version,
@@ -374,9 +375,10 @@ private:
     eversion_t pg_roll_forward_to,
     hobject_t new_temp_oid,
     hobject_t discard_temp_oid,
-    const vector<pg_log_entry_t> &log_entries,
+    const bufferlist &log_bl,
     boost::optional<pg_hit_set_history_t> &hset_history,
-    ObjectStore::Transaction &op_t,
+    const bufferlist &op_t_bl,
+    unsigned op_t_data_off,
     pg_shard_t peer,
     const pg_info_t &pinfo);
   void issue_op(
@@ -51,6 +51,22 @@ int OSDriver::get_next(
   }
 }
 
+int OSDriver::get_next_n(
+  const std::string &key,
+  unsigned max,
+  std::vector<pair<std::string, bufferlist> > *out)
+{
+  ObjectMap::ObjectMapIterator iter =
+    os->get_omap_iterator(cid, hoid);
+  if (!iter) {
+    ceph_abort();
+    return -EINVAL;
+  }
+  for (iter->upper_bound(key); iter->valid() && max > 0; iter->next(), --max)
+    out->push_back(make_pair(iter->key(), iter->value()));
+  return 0;
+}
+
 struct Mapping {
   snapid_t snap;
   hobject_t hoid;
@@ -254,26 +270,31 @@ int SnapMapper::get_next_objects_to_trim(
        ++i) {
     string prefix(get_prefix(snap) + *i);
     string pos = prefix;
-    while (out->size() < max) {
-      pair<string, bufferlist> next;
-      r = backend.get_next(pos, &next);
+    bool done = false;
+    while (!done && out->size() < max) {
+      // one range scan per batch instead of one lookup per key
+      vector<pair<string, bufferlist> > next;
+      r = backend.get_next_n(pos, max - out->size(), &next);
       if (r != 0) {
 	break; // Done
       }
 
-      if (next.first.substr(0, prefix.size()) !=
-	  prefix) {
-	break; // Done with this prefix
-      }
+      for (auto &&k : next) {
+	if (k.first.substr(0, prefix.size()) !=
+	    prefix) {
+	  done = true;
+	  break; // Done with this prefix
+	}
 
-      assert(is_mapping(next.first));
+	assert(is_mapping(k.first));
 
-      pair<snapid_t, hobject_t> next_decoded(from_raw(next));
-      assert(next_decoded.first == snap);
-      assert(check(next_decoded.second));
+	pair<snapid_t, hobject_t> next_decoded(from_raw(k));
+	assert(next_decoded.first == snap);
+	assert(check(next_decoded.second));
 
-      out->push_back(next_decoded.second);
-      pos = next.first;
+	out->push_back(next_decoded.second);
+	pos = k.first;
+      }
     }
   }
   if (out->size() == 0) {
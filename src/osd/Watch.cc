@@ -40,6 +40,7 @@ Notify::Notify(
     complete(false),
     discarded(false),
     timed_out(false),
+    num_pending(0),
     payload(payload),
     timeout(timeout),
     cookie(cookie),
@@ -101,13 +102,16 @@ void Notify::do_timeout()
   timed_out = true;         // we will send the client an error code
   maybe_complete_notify();
   assert(complete);
-  set<WatchRef> _watchers;
+  vector<WatchRef> _watchers;
   _watchers.swap(watchers);
+  num_pending = 0;
   lock.Unlock();
 
-  for (set<WatchRef>::iterator i = _watchers.begin();
+  for (vector<WatchRef>::iterator i = _watchers.begin();
        i != _watchers.end();
        ++i) {
+    if (!*i)
+      continue;  // acked or removed
     boost::intrusive_ptr<PrimaryLogPG> pg((*i)->get_pg());
     pg->lock();
     if (!(*i)->is_discarded()) {
@@ -144,51 +148,58 @@ void Notify::unregister_cb()
   }
 }
 
-void Notify::start_watcher(WatchRef watch)
+unsigned Notify::start_watcher(WatchRef watch)
 {
   Mutex::Locker l(lock);
   dout(10) << "start_watcher" << dendl;
-  watchers.insert(watch);
+  watchers.push_back(watch);
+  ++num_pending;
+  return watchers.size() - 1;
 }
 
-void Notify::complete_watcher(WatchRef watch, bufferlist& reply_bl)
+void Notify::complete_watcher(unsigned slot, bufferlist& reply_bl)
 {
   Mutex::Locker l(lock);
   dout(10) << "complete_watcher" << dendl;
   if (is_discarded())
     return;
-  assert(watchers.count(watch));
-  watchers.erase(watch);
-  notify_replies.insert(make_pair(make_pair(watch->get_watcher_gid(),
-					    watch->get_cookie()),
+  assert(slot < watchers.size() && watchers[slot]);
+  notify_replies.insert(make_pair(make_pair(watchers[slot]->get_watcher_gid(),
+					    watchers[slot]->get_cookie()),
 				  reply_bl));
+  watchers[slot].reset();
+  --num_pending;
   maybe_complete_notify();
 }
 
-void Notify::complete_watcher_remove(WatchRef watch)
+void Notify::complete_watcher_remove(unsigned slot)
 {
   Mutex::Locker l(lock);
   dout(10) << __func__ << dendl;
   if (is_discarded())
     return;
-  assert(watchers.count(watch));
-  watchers.erase(watch);
+  assert(slot < watchers.size() && watchers[slot]);
+  watchers[slot].reset();
+  --num_pending;
   maybe_complete_notify();
 }
 
 void Notify::maybe_complete_notify()
 {
   dout(10) << "maybe_complete_notify -- "
-	   << watchers.size()
+	   << num_pending
 	   << " in progress watchers " << dendl;
-  if (watchers.empty() || timed_out) {
+  if (num_pending == 0 || timed_out) {
     // prepare reply
     bufferlist bl;
     ::encode(notify_replies, bl);
     list<pair<uint64_t,uint64_t> > missed;
-    for (set<WatchRef>::iterator p = watchers.begin(); p != watchers.end(); ++p) {
-      missed.push_back(make_pair((*p)->get_watcher_gid(),
-				 (*p)->get_cookie()));
+    for (vector<WatchRef>::iterator p = watchers.begin();
+	 p != watchers.end();
+	 ++p) {
+      if (*p)
+	missed.push_back(make_pair((*p)->get_watcher_gid(),
+				   (*p)->get_cookie()));
     }
     ::encode(missed, bl);
 
@@ -212,6 +223,7 @@ void Notify::discard()
   discarded = true;
   unregister_cb();
   watchers.clear();
+  num_pending = 0;
 }
 
 void Notify::init()
@@ -372,10 +384,10 @@ void Watch::connect(ConnectionRef con, bool _will_ping)
   if (sessionref) {
     sessionref->wstate.addWatch(self.lock());
     sessionref->put();
-    for (map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.begin();
+    for (auto i = in_progress_notifies.begin();
 	 i != in_progress_notifies.end();
 	 ++i) {
-      send_notify(i->second);
+      send_notify(i->second.first);
     }
   }
   if (will_ping) {
@@ -397,10 +409,10 @@ void Watch::disconnect()
 void Watch::discard()
 {
   dout(10) << "discard" << dendl;
-  for (map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.begin();
+  for (auto i = in_progress_notifies.begin();
        i != in_progress_notifies.end();
        ++i) {
-    i->second->discard();
+    i->second.first->discard();
   }
   discard_state();
 }
@@ -438,10 +450,10 @@ void Watch::remove(bool send_disconnect)
 					 CEPH_WATCH_EVENT_DISCONNECT, empty));
     conn->send_message(reply);
   }
-  for (map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.begin();
+  for (auto i = in_progress_notifies.begin();
        i != in_progress_notifies.end();
        ++i) {
-    i->second->complete_watcher_remove(self.lock());
+    i->second.first->complete_watcher_remove(i->second.second);
   }
   discard_state();
 }
@@ -462,8 +474,8 @@ void Watch::start_notify(NotifyRef notif)
     }
   }
   dout(10) << "start_notify " << notif->notify_id << dendl;
-  in_progress_notifies[notif->notify_id] = notif;
-  notif->start_watcher(self.lock());
+  unsigned slot = notif->start_watcher(self.lock());
+  in_progress_notifies[notif->notify_id] = make_pair(notif, slot);
   if (connected())
     send_notify(notif);
 }
@@ -487,9 +499,9 @@ void Watch::send_notify(NotifyRef notif)
 void Watch::notify_ack(uint64_t notify_id, bufferlist& reply_bl)
 {
   dout(10) << "notify_ack" << dendl;
-  map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.find(notify_id);
+  auto i = in_progress_notifies.find(notify_id);
   if (i != in_progress_notifies.end()) {
-    i->second->complete_watcher(self.lock(), reply_bl);
+    i->second.first->complete_watcher(i->second.second, reply_bl);
     in_progress_notifies.erase(i);
   }
 }
@@ -56,7 +56,13 @@ class Notify {
   bool complete;
   bool discarded;
   bool timed_out;  ///< true if the notify timed out
-  set<WatchRef> watchers;
+  /**
+   * the watchers this notify was sent to, indexed by the slot each was
+   * given in start_watcher(); a slot is cleared when its watcher acks
+   * or goes away, so completion is a counter rather than set lookups
+   */
+  vector<WatchRef> watchers;
+  unsigned num_pending;  ///< watchers we are still waiting on
 
   bufferlist payload;
   uint32_t timeout;
@@ -76,7 +82,7 @@ class Notify {
     return discarded || complete;
   }
 
-  /// Sends notify completion if watchers.empty() or timeout
+  /// Sends notify completion if no watchers are pending or timeout
   void maybe_complete_notify();
 
   /// Called on Notify timeout
@@ -102,7 +108,7 @@ public:
   string gen_dbg_prefix() {
     stringstream ss;
     ss << "Notify(" << make_pair(cookie, notify_id) << " "
-       << " watchers=" << watchers.size()
+       << " watchers=" << num_pending
        << ") ";
     return ss.str();
   }
@@ -122,19 +128,19 @@ public:
   /// Call after creation to initialize
   void init();
 
-  /// Called once per watcher prior to init()
-  void start_watcher(
+  /// Called once per watcher prior to init(); @return the watcher's slot
+  unsigned start_watcher(
     WatchRef watcher ///< [in] watcher to complete
     );
 
   /// Called once per NotifyAck
   void complete_watcher(
-    WatchRef watcher, ///< [in] watcher to complete
+    unsigned slot, ///< [in] slot of the watcher to complete
     bufferlist& reply_bl ///< [in] reply buffer from the notified watcher
     );
   /// Called when a watcher unregisters or times out
   void complete_watcher_remove(
-    WatchRef watcher ///< [in] watcher to complete
+    unsigned slot ///< [in] slot of the watcher to complete
     );
 
   /// Called when the notify is canceled due to a new peering interval
@@ -159,7 +165,8 @@ class Watch {
   boost::intrusive_ptr<PrimaryLogPG> pg;
   ceph::shared_ptr<ObjectContext> obc;
 
-  std::map<uint64_t, NotifyRef> in_progress_notifies;
+  /// notify_id -> (notify, our slot in it)
+  std::map<uint64_t, pair<NotifyRef, unsigned> > in_progress_notifies;
 
   // Could have watch_info_t here, but this file includes osd_types.h
   uint32_t timeout; ///< timeout in seconds
@@ -0,0 +1,152 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_OSD_MCLOCKOPQUEUE_H
+#define CEPH_OSD_MCLOCKOPQUEUE_H
+
+#include "common/mClockPriorityQueue.h"
+#include "msg/msg_types.h"
+
+#include <ostream>
+
+/// what an item on the OSD op queue does, for QoS purposes
+enum class osd_op_type_t {
+  client_op,	///< request from a client
+  osd_subop,	///< replica or shard op from a peer OSD
+  bg_snaptrim,
+  bg_recovery,
+  bg_scrub,
+};
+
+inline std::ostream& operator<<(std::ostream& out, osd_op_type_t t)
+{
+  switch (t) {
+  case osd_op_type_t::client_op: return out << "client_op";
+  case osd_op_type_t::osd_subop: return out << "osd_subop";
+  case osd_op_type_t::bg_snaptrim: return out << "bg_snaptrim";
+  case osd_op_type_t::bg_recovery: return out << "bg_recovery";
+  case osd_op_type_t::bg_scrub: return out << "bg_scrub";
+  }
+  return out << "unknown";
+}
+
+/**
+ * mClock client of the OSD op queue.
+ *
+ * Client ops are scheduled per client and pool, so every client of a
+ * pool gets the pool's reservation, weight and limit of its own.  Peer
+ * OSD ops are scheduled per peer.  Background work is scheduled as one
+ * client per op type, whatever PG or owner it belongs to.
+ */
+struct mClockOpClient {
+  osd_op_type_t type;
+  int64_t pool;
+  entity_inst_t owner;
+
+  mClockOpClient(osd_op_type_t t, int64_t p, const entity_inst_t& o)
+    : type(t), pool(p), owner(o) {}
+
+  friend bool operator<(const mClockOpClient& a, const mClockOpClient& b) {
+    if (a.type != b.type)
+      return a.type < b.type;
+    if (a.pool != b.pool)
+      return a.pool < b.pool;
+    return a.owner < b.owner;
+  }
+  friend bool operator==(const mClockOpClient& a, const mClockOpClient& b) {
+    return a.type == b.type && a.pool == b.pool && a.owner == b.owner;
+  }
+  friend std::ostream& operator<<(std::ostream& out, const mClockOpClient& c) {
+    out << c.type;
+    if (c.type == osd_op_type_t::client_op)
+      out << " pool " << c.pool << " " << c.owner;
+    else if (c.type == osd_op_type_t::osd_subop)
+      out << " " << c.owner;
+    return out;
+  }
+};
+
+/**
+ * OSD op queue adapter around mClockQueue.
+ *
+ * The OpQueue interface only hands us the owner of an item; the op type
+ * and pool are pulled out of the item itself by the classify function,
+ * and the settings for the resulting client come from info.
+ */
+template <typename T>
+class mClockOpQueue : public OpQueue<T, entity_inst_t>
+{
+public:
+  typedef std::function<std::pair<osd_op_type_t, int64_t>(const T&)> classify_func;
+  typedef std::function<mClockClientInfo(const mClockOpClient&)> info_func;
+
+private:
+  classify_func classify;
+  mClockQueue<T, mClockOpClient> queue;
+
+  mClockOpClient get_client(const entity_inst_t& owner, const T& item) const {
+    auto c = classify(item);
+    switch (c.first) {
+    case osd_op_type_t::client_op:
+      return mClockOpClient(c.first, c.second, owner);
+    case osd_op_type_t::osd_subop:
+      return mClockOpClient(c.first, -1, owner);
+    default:
+      return mClockOpClient(c.first, -1, entity_inst_t());
+    }
+  }
+
+public:
+  mClockOpQueue(classify_func classify, info_func info, unsigned cost_unit)
+    : classify(classify), queue(info, cost_unit) {}
+
+  unsigned length() const override final {
+    return queue.length();
+  }
+  void remove_by_filter(std::function<bool (T)> f) override final {
+    queue.remove_by_filter(f);
+  }
+  void remove_by_class(entity_inst_t owner, std::list<T> *out) override final {
+    queue.remove_by_key_filter(
+      [&owner](const mClockOpClient& c) { return c.owner == owner; }, out);
+  }
+  void enqueue_strict(entity_inst_t owner, unsigned priority,
+		      T item) override final {
+    queue.enqueue_strict(get_client(owner, item), priority, item);
+  }
+  void enqueue_strict_front(entity_inst_t owner, unsigned priority,
+			    T item) override final {
+    queue.enqueue_strict_front(get_client(owner, item), priority, item);
+  }
+  void enqueue(entity_inst_t owner, unsigned priority, unsigned cost,
+	       T item) override final {
+    queue.enqueue(get_client(owner, item), priority, cost, item);
+  }
+  void enqueue_front(entity_inst_t owner, unsigned priority, unsigned cost,
+		     T item) override final {
+    queue.enqueue_front(get_client(owner, item), priority, cost, item);
+  }
+  bool empty() const override final {
+    return queue.empty();
+  }
+  double ready_in() const override final {
+    return queue.ready_in();
+  }
+  T dequeue() override final {
+    return queue.dequeue();
+  }
+  void dump(ceph::Formatter *f) const override final {
+    queue.dump(f);
+  }
+};
+
+#endif
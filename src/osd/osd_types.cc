@@ -967,7 +967,13 @@ static opt_mapping_t opt_mapping = boost::assign::map_list_of
            ("csum_max_block", pool_opts_t::opt_desc_t(
 	     pool_opts_t::CSUM_MAX_BLOCK, pool_opts_t::INT))
            ("csum_min_block", pool_opts_t::opt_desc_t(
-	     pool_opts_t::CSUM_MIN_BLOCK, pool_opts_t::INT));
+	     pool_opts_t::CSUM_MIN_BLOCK, pool_opts_t::INT))
+           ("qos_reservation", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_RESERVATION, pool_opts_t::DOUBLE))
+           ("qos_weight", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_WEIGHT, pool_opts_t::DOUBLE))
+           ("qos_limit", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_LIMIT, pool_opts_t::DOUBLE));
 
 bool pool_opts_t::is_opt_name(const std::string& name) {
     return opt_mapping.find(name) != opt_mapping.end();
@@ -4489,6 +4495,17 @@ void watch_info_t::generate_test_instances(list<watch_info_t*>& o)
   o.back()->addr = ea;
 }
 
+void obc_cache_stats_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("hits", hits);
+  f->dump_unsigned("misses", misses);
+  f->dump_unsigned("enoent_hits", enoent_hits);
+  f->dump_unsigned("pinned", pinned);
+  uint64_t total = hits + misses + enoent_hits;
+  f->dump_float("hit_rate",
+		total ? (double)(hits + enoent_hits) / (double)total : 0.0);
+}
+
 
 // -- object_info_t --
 
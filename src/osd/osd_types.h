@@ -994,6 +994,9 @@ public:
     CSUM_TYPE,
     CSUM_MAX_BLOCK,
     CSUM_MIN_BLOCK,
+    QOS_RESERVATION,
+    QOS_WEIGHT,
+    QOS_LIMIT,
   };
 
   enum type_t {
@@ -2920,14 +2923,14 @@ protected:
   eversion_t rollback_info_trimmed_to;
 
 public:
-  mempool::osd::list<pg_log_entry_t> log;  // the actual log.
+  mempool::osd_pglog::list<pg_log_entry_t> log;  // the actual log.
   
   pg_log_t() = default;
   pg_log_t(const eversion_t &last_update,
 	   const eversion_t &log_tail,
 	   const eversion_t &can_rollback_to,
 	   const eversion_t &rollback_info_trimmed_to,
-	   mempool::osd::list<pg_log_entry_t> &&entries)
+	   mempool::osd_pglog::list<pg_log_entry_t> &&entries)
     : head(last_update), tail(log_tail), can_rollback_to(can_rollback_to),
       rollback_info_trimmed_to(rollback_info_trimmed_to),
       log(std::move(entries)) {}
@@ -2958,7 +2961,7 @@ public:
 
 
   pg_log_t split_out_child(pg_t child_pgid, unsigned split_bits) {
-    mempool::osd::list<pg_log_entry_t> oldlog, childlog;
+    mempool::osd_pglog::list<pg_log_entry_t> oldlog, childlog;
     oldlog.swap(log);
 
     eversion_t old_tail;
@@ -2982,11 +2985,11 @@ public:
       std::move(childlog));
   }
 
-  mempool::osd::list<pg_log_entry_t> rewind_from_head(eversion_t newhead) {
+  mempool::osd_pglog::list<pg_log_entry_t> rewind_from_head(eversion_t newhead) {
     assert(newhead >= tail);
 
-    mempool::osd::list<pg_log_entry_t>::iterator p = log.end();
-    mempool::osd::list<pg_log_entry_t> divergent;
+    mempool::osd_pglog::list<pg_log_entry_t>::iterator p = log.end();
+    mempool::osd_pglog::list<pg_log_entry_t> divergent;
     while (true) {
       if (p == log.begin()) {
 	// yikes, the whole thing is divergent!
@@ -4147,6 +4150,9 @@ public:
   // attr cache
   map<string, bufferlist> attr_cache;
 
+  /// times found in the PG's object context cache; see pin_count
+  unsigned cache_hits;
+
   struct RWState {
     enum State {
       RWNONE,
@@ -4404,6 +4410,7 @@ public:
       destructor_callback(0),
       lock("PrimaryLogPG::ObjectContext::lock"),
       unstable_writes(0), readers(0), writers_waiting(0), readers_waiting(0),
+      cache_hits(0),
       blocked(false), requeue_scrub_on_unblock(false) {}
 
   ~ObjectContext() {
@@ -4507,6 +4514,17 @@ public:
   bool empty() const {
     return locks.empty();
   }
+  bool has_lock(const hobject_t &hoid) const {
+    return locks.count(hoid);
+  }
+  /// take over the locks held by other
+  void take_locks(ObcLockManager &&other) {
+    for (auto &p : other.locks) {
+      assert(locks.find(p.first) == locks.end());
+      locks.insert(p);
+    }
+    other.locks.clear();
+  }
   bool get_lock_type(
     ObjectContext::RWState::State type,
     const hobject_t &hoid,
@@ -4853,6 +4871,22 @@ struct obj_watch_item_t {
   watch_item_t wi;
 };
 
+/// object context cache counters of a pg, for dump_object_context_cache
+struct obc_cache_stats_t {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t enoent_hits = 0;  ///< lookups answered by the negative cache
+  uint64_t pinned = 0;       ///< object contexts pinned right now
+
+  void add(const obc_cache_stats_t& o) {
+    hits += o.hits;
+    misses += o.misses;
+    enoent_hits += o.enoent_hits;
+    pinned += o.pinned;
+  }
+  void dump(Formatter *f) const;
+};
+
 /**
  * obj list watch response format
  *
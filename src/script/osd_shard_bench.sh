@@ -0,0 +1,53 @@
+#!/bin/bash
+#
+# Compare the default op shard model with osd_op_run_to_completion.
+#
+# For every object store and shard mode a fresh single-OSD vstart
+# cluster is created and 4k rados bench write and random read runs are
+# made against it; IOPS and average latency are printed per run.
+#
+# Run from the build directory:
+#
+#   ../src/script/osd_shard_bench.sh [store...]
+#
+#   store    memstore and/or bluestore (default: both)
+#
+# SECS (default 30), THREADS (default 64), SIZE (default 4096) and
+# SHARDS (default 5) control the runs.  Extra OSD options can be given
+# in EXTRA_CONF, e.g. EXTRA_CONF="osd_op_shard_cpus = 2-5".
+
+set -e
+
+SECS=${SECS:-30}
+THREADS=${THREADS:-64}
+SIZE=${SIZE:-4096}
+SHARDS=${SHARDS:-5}
+STORES=${@:-memstore bluestore}
+SRC=$(dirname $0)/..
+
+bench() {
+    bin/rados -p bench bench $SECS $1 -b $SIZE -t $THREADS $2 2>/dev/null | \
+        awk -F: '/^Average IOPS/ {iops=$2} /^Average Latency/ {lat=$2}
+                 END {printf "%10d %12.6f", iops, lat}'
+}
+
+printf "%-10s %-18s %10s %12s %10s %12s\n" \
+    store mode write_iops write_lat_s read_iops read_lat_s
+for store in $STORES; do
+    for rtc in false true; do
+        MON=1 OSD=1 MDS=0 MGR=1 $SRC/vstart.sh -n -l -X --$store \
+            -o "osd_op_num_shards = $SHARDS
+	osd_op_run_to_completion = $rtc
+	$EXTRA_CONF" >/dev/null 2>&1
+        bin/ceph osd pool create bench 64 >/dev/null 2>&1
+        bin/ceph osd pool set bench size 1 >/dev/null 2>&1
+        while bin/ceph pg stat 2>/dev/null | \
+                grep -Eq 'creating|peering|activating|inactive|unknown'; do
+            sleep 1
+        done
+        if [ $rtc = true ]; then mode=run-to-completion; else mode=default; fi
+        printf "%-10s %-18s %s %s\n" $store $mode \
+            "$(bench write --no-cleanup)" "$(bench rand)"
+        $SRC/stop.sh >/dev/null 2>&1
+    done
+done
@@ -10,4 +10,7 @@
      --test-random           do random placements
      --test-map-pg <pgid>    map a pgid to osds
      --test-map-object <objectname> [--pool <poolid>] map an object to osds
+     --test-mapping-bench [--mapping-threads <n>]
+                             time building the pg mapping table, lookups,
+                             and updating it for an osd going down
   [1]
@@ -117,6 +117,69 @@ TEST(ClsHello, Loud) {
   ASSERT_EQ(0, destroy_one_pool_pp(pool_name, cluster));
 }
 
+static int get_keys(IoCtx& ioctx, const std::set<std::string>& keys,
+		    std::map<std::string, bufferlist> *vals)
+{
+  bufferlist in, out;
+  ::encode(keys, in);
+  int r = ioctx.exec("myobject", "hello", "get_keys", in, out);
+  if (r < 0)
+    return r;
+  bufferlist::iterator p = out.begin();
+  ::decode(*vals, p);
+  return 0;
+}
+
+static int remove_keys(IoCtx& ioctx, const std::set<std::string>& keys)
+{
+  bufferlist in, out;
+  ::encode(keys, in);
+  return ioctx.exec("myobject", "hello", "remove_keys", in, out);
+}
+
+TEST(ClsHello, MultiKeyOmap) {
+  Rados cluster;
+  std::string pool_name = get_temp_pool_name();
+  ASSERT_EQ("", create_one_pool_pp(pool_name, cluster));
+  IoCtx ioctx;
+  cluster.ioctx_create(pool_name.c_str(), ioctx);
+
+  std::map<std::string, bufferlist> vals;
+  ASSERT_EQ(-ENOENT, get_keys(ioctx, {"a"}, &vals));
+
+  std::map<std::string, bufferlist> omap;
+  omap["a"].append("1");
+  omap["b"].append("2");
+  omap["c"].append("3");
+  ASSERT_EQ(0, ioctx.omap_set("myobject", omap));
+
+  // only the keys that exist come back
+  ASSERT_EQ(0, get_keys(ioctx, {"a", "c", "x"}, &vals));
+  ASSERT_EQ(2u, vals.size());
+  ASSERT_EQ(std::string("1"), vals["a"].to_str());
+  ASSERT_EQ(std::string("3"), vals["c"].to_str());
+  ASSERT_EQ(0, get_keys(ioctx, {"x", "y"}, &vals));
+  ASSERT_TRUE(vals.empty());
+  ASSERT_EQ(0, get_keys(ioctx, {}, &vals));
+  ASSERT_TRUE(vals.empty());
+
+  // keys that do not exist are ignored
+  ASSERT_EQ(0, remove_keys(ioctx, {"a", "x"}));
+  ASSERT_EQ(0, remove_keys(ioctx, {"y"}));
+  ASSERT_EQ(0, get_keys(ioctx, {"a", "b", "c"}, &vals));
+  ASSERT_EQ(2u, vals.size());
+  ASSERT_EQ(0u, vals.count("a"));
+  ASSERT_EQ(std::string("2"), vals["b"].to_str());
+  ASSERT_EQ(std::string("3"), vals["c"].to_str());
+
+  ASSERT_EQ(0, remove_keys(ioctx, {"b", "c"}));
+  std::map<std::string, bufferlist> left;
+  ASSERT_EQ(0, ioctx.omap_get_vals("myobject", "", 10, &left));
+  ASSERT_TRUE(left.empty());
+
+  ASSERT_EQ(0, destroy_one_pool_pp(pool_name, cluster));
+}
+
 TEST(ClsHello, BadMethods) {
   Rados cluster;
   std::string pool_name = get_temp_pool_name();
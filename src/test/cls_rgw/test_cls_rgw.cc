@@ -373,6 +373,93 @@ TEST(cls_rgw, index_suggest)
   test_stats(ioctx, bucket_oid, 0, num_objs / 2, total_size);
 }
 
+static void suggest(char op, const string& obj, uint64_t size,
+		    bufferlist& updates)
+{
+  rgw_bucket_dir_entry dirent;
+  dirent.key.name = obj;
+  dirent.exists = (op == CEPH_RGW_UPDATE);
+  dirent.meta.category = 0;
+  dirent.meta.size = size;
+  dirent.meta.accounted_size = size;
+  cls_rgw_encode_suggestion(op, dirent, updates);
+}
+
+static void list_index(librados::IoCtx& ioctx, string& oid,
+		       map<string, rgw_bucket_dir_entry> *entries)
+{
+  map<int, string> oids;
+  oids[0] = oid;
+  map<int, struct rgw_cls_list_ret> results;
+  ASSERT_EQ(0, CLSRGWIssueBucketList(ioctx, cls_rgw_obj_key(), "", 1000,
+				     false, oids, results, 8)());
+  *entries = results[0].dir.m;
+}
+
+/* several changes in one call, some to the same key */
+TEST(cls_rgw, index_suggest_multiple)
+{
+  string bucket_oid = str_int("bucket", 4);
+
+  OpMgr mgr;
+
+  ObjectWriteOperation *op = mgr.write_op();
+  cls_rgw_bucket_init(*op);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  /* create obj-0 .. obj-2 */
+  int epoch = 0;
+  for (int i = 0; i < 3; i++) {
+    string obj = str_int("obj", i);
+    string tag = str_int("tag", i);
+    string loc = str_int("loc", i);
+
+    index_prepare(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, obj, loc);
+
+    rgw_bucket_dir_entry_meta meta;
+    meta.category = 0;
+    meta.size = 1024;
+    index_complete(mgr, ioctx, bucket_oid, CLS_RGW_OP_ADD, tag, ++epoch, obj, meta);
+  }
+  test_stats(ioctx, bucket_oid, 0, 3, 3 * 1024);
+
+  bufferlist updates;
+  /* remove followed by update */
+  suggest(CEPH_RGW_REMOVE, "obj-0", 0, updates);
+  suggest(CEPH_RGW_UPDATE, "obj-0", 2048, updates);
+  /* update followed by remove */
+  suggest(CEPH_RGW_UPDATE, "obj-1", 4096, updates);
+  suggest(CEPH_RGW_REMOVE, "obj-1", 0, updates);
+  /* two updates */
+  suggest(CEPH_RGW_UPDATE, "obj-2", 100, updates);
+  suggest(CEPH_RGW_UPDATE, "obj-2", 200, updates);
+  /* a new entry, and a removal of one that does not exist */
+  suggest(CEPH_RGW_UPDATE, "obj-3", 512, updates);
+  suggest(CEPH_RGW_REMOVE, "obj-4", 0, updates);
+
+  op = mgr.write_op();
+  cls_rgw_suggest_changes(*op, updates);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  map<string, rgw_bucket_dir_entry> entries;
+  list_index(ioctx, bucket_oid, &entries);
+  ASSERT_EQ(3u, entries.size());
+  ASSERT_EQ(2048u, entries["obj-0"].meta.size);
+  ASSERT_EQ(0u, entries.count("obj-1"));
+  ASSERT_EQ(200u, entries["obj-2"].meta.size);
+  ASSERT_EQ(512u, entries["obj-3"].meta.size);
+  test_stats(ioctx, bucket_oid, 0, 3, 2048 + 200 + 512);
+
+  /* the same changes again leave things as they are */
+  op = mgr.write_op();
+  cls_rgw_suggest_changes(*op, updates);
+  ASSERT_EQ(0, ioctx.operate(bucket_oid, op));
+
+  list_index(ioctx, bucket_oid, &entries);
+  ASSERT_EQ(3u, entries.size());
+  test_stats(ioctx, bucket_oid, 0, 3, 2048 + 200 + 512);
+}
+
 /* test garbage collection */
 static void create_obj(cls_rgw_obj& obj, int i, int j)
 {
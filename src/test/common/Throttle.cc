@@ -417,6 +417,76 @@ TEST(BackoffThrottle, oversaturated)
   ASSERT_GT(results.second.count(), 0.0005);
 }
 
+TEST(AdaptiveThrottle, shrink_and_grow)
+{
+  Throttle msgs(g_ceph_context, "adaptive_test_msgs", 100);
+  Throttle bytes(g_ceph_context, "adaptive_test_bytes", 1000);
+  Throttle unlimited(g_ceph_context, "adaptive_test_unlimited", 0);
+  {
+    AdaptiveThrottle at(g_ceph_context, "adaptive_test", .01, .2, .1);
+    at.add_throttle(&msgs);
+    at.add_throttle(&bytes);
+    at.add_throttle(&unlimited);
+    ASSERT_EQ(100, msgs.get_max());
+
+    // no samples, no change
+    at.update();
+    ASSERT_EQ(1.0, at.get_scale());
+
+    // within the dead band
+    at.add_sample(utime_t(0, 10000000));
+    at.update();
+    ASSERT_EQ(1.0, at.get_scale());
+
+    // too slow: multiplicative decrease, bounded by min_scale
+    for (int i = 0; i < 100; ++i) {
+      at.add_sample(utime_t(0, 50000000));
+      at.update();
+    }
+    ASSERT_DOUBLE_EQ(.1, at.get_scale());
+    ASSERT_EQ(10, msgs.get_max());
+    ASSERT_EQ(100, bytes.get_max());
+    ASSERT_EQ(0, unlimited.get_max());
+
+    // fast again: additive increase back up to the configured max
+    at.add_sample(utime_t(0, 1000000));
+    at.update();
+    ASSERT_LT(.1, at.get_scale());
+    ASSERT_LT(10, msgs.get_max());
+    for (int i = 0; i < 100; ++i) {
+      at.add_sample(utime_t(0, 1000000));
+      at.update();
+    }
+    ASSERT_EQ(1.0, at.get_scale());
+    ASSERT_EQ(100, msgs.get_max());
+
+    at.add_sample(utime_t(0, 50000000));
+    at.update();
+    ASSERT_GT(100, msgs.get_max());
+  }
+  // restored on destruction
+  ASSERT_EQ(100, msgs.get_max());
+  ASSERT_EQ(1000, bytes.get_max());
+}
+
+TEST(AdaptiveThrottle, grow_when_idle)
+{
+  AdaptiveThrottle at(g_ceph_context, "adaptive_test_idle", .01, .2, .1);
+  at.add_sample(utime_t(0, 50000000));
+  at.update();
+  ASSERT_DOUBLE_EQ(.8, at.get_scale());
+  at.update();
+  ASSERT_DOUBLE_EQ(.8, at.get_scale());
+
+  // with nobody waiting on us, give capacity back
+  at.set_grow_when_idle(true);
+  at.update();
+  ASSERT_DOUBLE_EQ(.85, at.get_scale());
+  for (int i = 0; i < 10; ++i)
+    at.update();
+  ASSERT_EQ(1.0, at.get_scale());
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
@@ -13,6 +13,7 @@
 
 #include "include/stringify.h"
 #include "common/bloom_filter.hpp"
+#include "common/blocked_bloom_filter.hpp"
 
 TEST(BloomFilter, Basic) {
   bloom_filter bf(10, .1, 1);
@@ -303,3 +304,96 @@ TEST(BloomFilter, Assignement) {
   ASSERT_EQ(2U, bf1.element_count());
   ASSERT_EQ(1U, bf2.element_count());
 }
+
+TEST(BlockedBloomFilter, Basic) {
+  blocked_bloom_filter bf(10, .1, 1);
+  bf.insert(123);
+  bf.insert(456);
+
+  ASSERT_TRUE(bf.contains(123));
+  ASSERT_TRUE(bf.contains(456));
+  ASSERT_EQ(2U, bf.element_count());
+  ASSERT_FALSE(bf.is_full());
+}
+
+TEST(BlockedBloomFilter, Empty) {
+  blocked_bloom_filter bf;
+  for (int i=0; i<100; ++i)
+    ASSERT_FALSE(bf.contains(i));
+  ASSERT_EQ(0.0, bf.density());
+}
+
+TEST(BlockedBloomFilter, SweepInt) {
+  std::cout.setf(std::ios_base::fixed, std::ios_base::floatfield);
+  std::cout.precision(5);
+  std::cout << "# max\tfpp\tactual\tsize\tprobes\tdensity\tapprox_element_count" << std::endl;
+  for (int ex = 3; ex < 12; ex += 2) {
+    for (float fpp = .001; fpp < .5; fpp *= 4.0) {
+      int max = 2 << ex;
+      blocked_bloom_filter bf(max, fpp, 1);
+
+      // sequential values, as object hashes in a test pool would be
+      for (int n = 0; n < max; n++)
+	bf.insert(n);
+      for (int n = 0; n < max; n++)
+	ASSERT_TRUE(bf.contains(n));
+
+      int test = max * 100;
+      int hit = 0;
+      for (int n = 0; n < test; n++)
+	if (bf.contains(100000 + n))
+	  hit++;
+
+      double actual = (double)hit / (double)test;
+      std::cout << max << "\t" << fpp << "\t" << actual << "\t" << bf.size()
+		<< "\t" << bf.probe_count() << "\t" << bf.density()
+		<< "\t" << bf.approx_unique_element_count() << std::endl;
+      ASSERT_TRUE(actual < fpp * 2);
+      ASSERT_GT(bf.approx_unique_element_count(), max * .9);
+      ASSERT_LE(bf.approx_unique_element_count(), max);
+    }
+  }
+}
+
+TEST(BlockedBloomFilter, Batch) {
+  blocked_bloom_filter bf(1000, .01, 1);
+  std::vector<uint32_t> vals;
+  for (uint32_t n = 0; n < 1000; ++n) {
+    bf.insert(n * 7);
+    vals.push_back(n * 7);
+    vals.push_back(n * 7 + 1);
+  }
+  std::unique_ptr<bool[]> out(new bool[vals.size()]);
+  bf.contains(vals.data(), vals.size(), out.get());
+  for (size_t i = 0; i < vals.size(); ++i)
+    ASSERT_EQ(bf.contains(vals[i]), out[i]);
+
+  blocked_bloom_filter empty;
+  empty.contains(vals.data(), vals.size(), out.get());
+  for (size_t i = 0; i < vals.size(); ++i)
+    ASSERT_FALSE(out[i]);
+}
+
+TEST(BlockedBloomFilter, EncodeAndAssign) {
+  blocked_bloom_filter bf1(100, .01, 3), bf2;
+  for (uint32_t n = 0; n < 50; ++n)
+    bf1.insert(n);
+
+  bufferlist bl;
+  ::encode(bf1, bl);
+  bufferlist::iterator p = bl.begin();
+  ::decode(bf2, p);
+  ASSERT_EQ(bf1.size(), bf2.size());
+  ASSERT_EQ(bf1.probe_count(), bf2.probe_count());
+  ASSERT_EQ(50U, bf2.element_count());
+  for (uint32_t n = 0; n < 50; ++n)
+    ASSERT_TRUE(bf2.contains(n));
+
+  blocked_bloom_filter bf3;
+  bf3 = bf1;
+  bf1.insert(1000);
+  ASSERT_EQ(51U, bf1.element_count());
+  ASSERT_EQ(50U, bf3.element_count());
+  for (uint32_t n = 0; n < 50; ++n)
+    ASSERT_TRUE(bf3.contains(n));
+}
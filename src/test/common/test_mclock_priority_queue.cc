@@ -0,0 +1,223 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "common/mClockPriorityQueue.h"
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+struct Op {
+  unsigned client;
+  unsigned seq;
+  double arrival;
+};
+
+class mClockQueueTest : public testing::Test
+{
+protected:
+  typedef mClockQueue<Op, unsigned> Queue;
+
+  double now = 0;
+  map<unsigned, mClockClientInfo> infos;
+
+  Queue *create_queue() {
+    return new Queue(
+      [this](const unsigned& c) { return infos[c]; },
+      0, 300,
+      [this]() { return now; });
+  }
+  Op op(unsigned client, unsigned seq) {
+    Op o = { client, seq, now };
+    return o;
+  }
+};
+
+TEST_F(mClockQueueTest, strict_first)
+{
+  unique_ptr<Queue> q(create_queue());
+  q->enqueue(1, 0, 0, op(1, 0));
+  q->enqueue_strict(1, 10, op(1, 1));
+  q->enqueue_strict(2, 20, op(2, 2));
+  q->enqueue_strict_front(3, 10, op(3, 3));
+  ASSERT_EQ(4u, q->length());
+  EXPECT_EQ(2u, q->dequeue().seq);
+  EXPECT_EQ(3u, q->dequeue().seq);
+  EXPECT_EQ(1u, q->dequeue().seq);
+  EXPECT_EQ(0u, q->dequeue().seq);
+  EXPECT_TRUE(q->empty());
+}
+
+TEST_F(mClockQueueTest, fifo_per_client)
+{
+  unique_ptr<Queue> q(create_queue());
+  for (unsigned i = 0; i < 10; ++i)
+    q->enqueue(1, 0, 0, op(1, i));
+  q->enqueue_front(1, 0, 0, op(1, 100));
+  EXPECT_EQ(100u, q->dequeue().seq);
+  for (unsigned i = 0; i < 10; ++i)
+    EXPECT_EQ(i, q->dequeue().seq);
+  EXPECT_TRUE(q->empty());
+}
+
+TEST_F(mClockQueueTest, weight)
+{
+  infos[1] = mClockClientInfo(0, 1, 0);
+  infos[2] = mClockClientInfo(0, 3, 0);
+  unique_ptr<Queue> q(create_queue());
+  for (unsigned i = 0; i < 400; ++i) {
+    q->enqueue(1, 0, 0, op(1, i));
+    q->enqueue(2, 0, 0, op(2, i));
+  }
+  map<unsigned, unsigned> served;
+  for (unsigned i = 0; i < 400; ++i)
+    served[q->dequeue().client]++;
+  EXPECT_NEAR(100u, served[1], 2);
+  EXPECT_NEAR(300u, served[2], 2);
+}
+
+TEST_F(mClockQueueTest, reservation)
+{
+  // client 1 is reserved 100 ops/s but has a tiny weight
+  infos[1] = mClockClientInfo(100, 1, 0);
+  infos[2] = mClockClientInfo(0, 1000, 0);
+  unique_ptr<Queue> q(create_queue());
+  for (unsigned i = 0; i < 1000; ++i) {
+    q->enqueue(1, 0, 0, op(1, i));
+    q->enqueue(2, 0, 0, op(2, i));
+  }
+  // serve 1000 ops/s for one second
+  map<unsigned, unsigned> served;
+  for (unsigned i = 0; i < 1000; ++i) {
+    now += .001;
+    served[q->dequeue().client]++;
+  }
+  EXPECT_NEAR(100u + 900u / 1001, served[1], 3);
+}
+
+TEST_F(mClockQueueTest, limit)
+{
+  infos[1] = mClockClientInfo(0, 1, 10);
+  unique_ptr<Queue> q(create_queue());
+  for (unsigned i = 0; i < 5; ++i)
+    q->enqueue(1, 0, 0, op(1, i));
+  EXPECT_EQ(0, q->ready_in());
+  q->dequeue();
+  // the next op may only go .1s after the first
+  EXPECT_NEAR(.1, q->ready_in(), 1e-9);
+  now += .05;
+  EXPECT_NEAR(.05, q->ready_in(), 1e-9);
+  now += .05;
+  EXPECT_EQ(0, q->ready_in());
+  EXPECT_EQ(1u, q->dequeue().seq);
+  // dequeue() ignores the limit if asked anyway
+  EXPECT_EQ(2u, q->dequeue().seq);
+}
+
+TEST_F(mClockQueueTest, remove)
+{
+  unique_ptr<Queue> q(create_queue());
+  for (unsigned i = 0; i < 10; ++i) {
+    q->enqueue(i % 2, 0, 0, op(i % 2, i));
+    q->enqueue_strict(i % 2, 100, op(i % 2, i + 100));
+  }
+  list<Op> removed;
+  q->remove_by_class(1, &removed);
+  ASSERT_EQ(10u, removed.size());
+  for (auto& o : removed)
+    EXPECT_EQ(1u, o.client);
+  EXPECT_EQ(10u, q->length());
+  list<unsigned> seen;
+  q->remove_by_filter([&seen](Op o) {
+      seen.push_back(o.seq);
+      return o.seq % 4 == 0;
+    });
+  // back to front: normal items newest first, then the strict ones
+  EXPECT_EQ(list<unsigned>({8, 6, 4, 2, 0, 108, 106, 104, 102, 100}), seen);
+  EXPECT_EQ(4u, q->length());
+  while (!q->empty()) {
+    Op o = q->dequeue();
+    EXPECT_EQ(0u, o.client);
+    EXPECT_NE(0u, o.seq % 4);
+  }
+}
+
+/*
+ * Noisy neighbour simulation.
+ *
+ * A server completing `capacity` ops/s is shared by `noisy` clients that
+ * each offer far more than their fair share and one quiet client offering
+ * `quiet_rate` ops/s, which is more than its fair share by weight alone.
+ * Arrivals are open loop.  Returns the ops/s the quiet client got and
+ * the 99th percentile of its queueing delay.
+ */
+static void simulate(double quiet_res, double noisy_lim,
+		     double *quiet_iops, double *quiet_p99, double *noisy_iops)
+{
+  const double capacity = 1000, quiet_rate = 100, noisy_rate = 500;
+  const unsigned noisy = 20;
+  const double duration = 20;
+
+  double now = 0;
+  mClockQueue<Op, unsigned> q(
+    [=](const unsigned& c) {
+      return c == 0 ? mClockClientInfo(quiet_res, 1, 0) :
+	mClockClientInfo(0, 1, noisy_lim);
+    },
+    0, 300, [&now]() { return now; });
+
+  vector<double> next_arrival(noisy + 1, 0);
+  vector<double> waits;
+  unsigned noisy_done = 0;
+  for (unsigned slot = 0; slot < capacity * duration; ++slot) {
+    now = slot / capacity;
+    for (unsigned c = 0; c <= noisy; ++c) {
+      double rate = c ? noisy_rate : quiet_rate;
+      while (next_arrival[c] <= now) {
+	Op o = { c, 0, next_arrival[c] };
+	q.enqueue(c, 0, 0, o);
+	next_arrival[c] += 1 / rate;
+      }
+    }
+    if (q.empty() || q.ready_in() > 0)
+      continue;
+    Op o = q.dequeue();
+    if (o.client == 0)
+      waits.push_back(now - o.arrival);
+    else
+      ++noisy_done;
+  }
+  sort(waits.begin(), waits.end());
+  *quiet_iops = waits.size() / duration;
+  *quiet_p99 = waits.empty() ? 0 : waits[waits.size() * 99 / 100];
+  *noisy_iops = noisy_done / duration;
+  cout << "  quiet res " << quiet_res << " noisy lim " << noisy_lim
+       << ": quiet " << *quiet_iops << " ops/s p99 wait " << *quiet_p99
+       << "s, noisy " << *noisy_iops << " ops/s" << std::endl;
+}
+
+TEST(mClockQueueSim, noisy_neighbor)
+{
+  double iops, p99, noisy;
+
+  // by weight alone the quiet client gets 1/21 of the server
+  simulate(0, 0, &iops, &p99, &noisy);
+  EXPECT_LT(iops, 60);
+  EXPECT_GT(p99, 1.0);
+
+  // a reservation covering its demand isolates it from the noise
+  simulate(100, 0, &iops, &p99, &noisy);
+  EXPECT_GT(iops, 99);
+  EXPECT_LT(p99, .02);
+  EXPECT_GT(noisy, 890);
+
+  // limits cap the noisy clients even when the server has room
+  simulate(100, 20, &iops, &p99, &noisy);
+  EXPECT_GT(iops, 99);
+  EXPECT_LT(noisy, 401);
+}
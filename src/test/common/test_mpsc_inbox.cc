@@ -0,0 +1,59 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "common/MPSCInbox.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(MPSCInbox, fifo)
+{
+  MPSCInbox<int> inbox;
+  EXPECT_TRUE(inbox.empty());
+  EXPECT_TRUE(inbox.push(1));
+  EXPECT_FALSE(inbox.push(2));
+  EXPECT_FALSE(inbox.push(3));
+  EXPECT_FALSE(inbox.empty());
+  std::vector<int> got;
+  EXPECT_EQ(3u, inbox.take_all([&got](int&& i) { got.push_back(i); }));
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), got);
+  EXPECT_TRUE(inbox.empty());
+  EXPECT_EQ(0u, inbox.take_all([](int&&) {}));
+}
+
+TEST(MPSCInbox, move_only)
+{
+  MPSCInbox<std::unique_ptr<int>> inbox;
+  inbox.push(std::unique_ptr<int>(new int(7)));
+  int v = 0;
+  inbox.take_all([&v](std::unique_ptr<int>&& p) { v = *p; });
+  EXPECT_EQ(7, v);
+  // leftovers are freed with the inbox
+  inbox.push(std::unique_ptr<int>(new int(8)));
+}
+
+TEST(MPSCInbox, producers_keep_order)
+{
+  const unsigned producers = 4, per_producer = 100000;
+  MPSCInbox<std::pair<unsigned, unsigned>> inbox;
+  std::vector<std::thread> threads;
+  for (unsigned p = 0; p < producers; ++p) {
+    threads.emplace_back([&inbox, p, per_producer]() {
+	for (unsigned i = 0; i < per_producer; ++i)
+	  inbox.push(std::make_pair(p, i));
+      });
+  }
+  std::vector<unsigned> next(producers, 0);
+  unsigned total = 0;
+  while (total < producers * per_producer) {
+    total += inbox.take_all([&next](std::pair<unsigned, unsigned>&& i) {
+	ASSERT_EQ(next[i.first], i.second);
+	++next[i.first];
+      });
+  }
+  for (auto& t : threads)
+    t.join();
+  EXPECT_TRUE(inbox.empty());
+}
@@ -0,0 +1,143 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "common/TrackedOp.h"
+#include "common/Formatter.h"
+#include "global/global_context.h"
+#include "include/stringify.h"
+
+class TestOp : public TrackedOp {
+public:
+  typedef ceph::shared_ptr<TestOp> Ref;
+  int id;
+  TestOp(int id, OpTracker *tracker)
+    : TrackedOp(tracker, ceph_clock_now()), id(id) {}
+  void _dump_op_descriptor_unlocked(ostream& stream) const override {
+    stream << "test_op(" << id << ")";
+  }
+  void _dump(Formatter *f) const override {
+    dump_events(f);
+  }
+};
+
+static string dump(OpTracker& t, bool historic)
+{
+  JSONFormatter f;
+  if (historic)
+    t.dump_historic_ops(&f);
+  else
+    t.dump_ops_in_flight(&f);
+  stringstream ss;
+  f.flush(ss);
+  return ss.str();
+}
+
+TEST(OpTracker, Events)
+{
+  OpTracker t(g_ceph_context, true, 4);
+  t.set_history_size_and_duration(20, 600);
+  {
+    TestOp::Ref op = t.create_request<TestOp, int>(1);
+    for (int i = 0; i < 40; ++i)
+      op->mark_event("static");
+    string s = "dynamic " + stringify(7);
+    const char *copy = op->mark_event(s);
+    ASSERT_TRUE(copy);
+    s.clear();
+    ASSERT_STREQ("dynamic 7", copy);
+    ASSERT_STREQ("dynamic 7", op->state_string());
+
+    string in_flight = dump(t, false);
+    ASSERT_NE(string::npos, in_flight.find("test_op(1)"));
+    ASSERT_NE(string::npos, in_flight.find("\"dynamic 7\""));
+    ASSERT_NE(string::npos, in_flight.find("\"num_ops\":1"));
+  }
+  string in_flight = dump(t, false);
+  ASSERT_NE(string::npos, in_flight.find("\"num_ops\":0"));
+  string history = dump(t, true);
+  ASSERT_NE(string::npos, history.find("test_op(1)"));
+  ASSERT_NE(string::npos, history.find("\"event\":\"done\""));
+  t.on_shutdown();
+}
+
+TEST(OpTracker, Untracked)
+{
+  OpTracker t(g_ceph_context, false, 4);
+  TestOp::Ref op = t.create_request<TestOp, int>(1);
+  op->mark_event("static");
+  ASSERT_EQ(nullptr, op->mark_event(string("dynamic")));
+  ASSERT_STREQ("", op->state_string());
+}
+
+TEST(OpTracker, HistoryKeepsSlowest)
+{
+  OpTracker t(g_ceph_context, true, 4);
+  t.set_history_size_and_duration(4, 600);
+  for (int i = 0; i < 32; ++i) {
+    TestOp::Ref op = t.create_request<TestOp, int>(i);
+    if (i == 5)
+      usleep(20000);
+  }
+  string history = dump(t, true);
+  ASSERT_NE(string::npos, history.find("test_op(5)"));
+  size_t n = 0;
+  for (size_t p = history.find("\"description\""); p != string::npos;
+       p = history.find("\"description\"", p + 1))
+    ++n;
+  ASSERT_EQ(4u, n);
+  t.on_shutdown();
+}
+
+TEST(OpTracker, HistorySlowOpsInOneShard)
+{
+  OpTracker t(g_ceph_context, true, 4);
+  t.set_history_size_and_duration(8, 600);
+  // every 8th op is slow, so all 8 slow ops share a shard
+  for (int i = 0; i < 64; ++i) {
+    TestOp::Ref op = t.create_request<TestOp, int>(i);
+    if (i % 8 == 0)
+      usleep(10000);
+  }
+  string history = dump(t, true);
+  for (int i = 0; i < 64; i += 8)
+    ASSERT_NE(string::npos, history.find("test_op(" + stringify(i) + ")"));
+  size_t n = 0;
+  for (size_t p = history.find("\"description\""); p != string::npos;
+       p = history.find("\"description\"", p + 1))
+    ++n;
+  ASSERT_EQ(8u, n);
+  t.on_shutdown();
+}
+
+TEST(OpTracker, Concurrent)
+{
+  OpTracker t(g_ceph_context, true, 4);
+  t.set_history_size_and_duration(20, 600);
+  std::atomic<bool> stop(false);
+  std::thread reader([&]() {
+      while (!stop) {
+	dump(t, false);
+	vector<string> warnings;
+	t.check_ops_in_flight(warnings);
+      }
+    });
+  vector<std::thread> writers;
+  for (int w = 0; w < 4; ++w) {
+    writers.emplace_back([&t, w]() {
+	for (int i = 0; i < 2000; ++i) {
+	  TestOp::Ref op = t.create_request<TestOp, int>(w * 10000 + i);
+	  op->mark_event("one");
+	  op->mark_event(string("two"));
+	}
+      });
+  }
+  for (auto& w : writers)
+    w.join();
+  stop = true;
+  reader.join();
+  ASSERT_NE(string::npos, dump(t, false).find("\"num_ops\":0"));
+  t.on_shutdown();
+}
@@ -14,6 +14,9 @@ TYPE(BitVector<2>)
 TYPE(bloom_filter)
 TYPE(compressible_bloom_filter)
 
+#include "common/blocked_bloom_filter.hpp"
+TYPE(blocked_bloom_filter)
+
 #include "test_ceph_time.h"
 TYPE(real_time_wrapper)
 
@@ -107,6 +110,7 @@ TYPE(ECSubReadReply)
 TYPE_NONDETERMINISTIC(ExplicitHashHitSet)
 TYPE_NONDETERMINISTIC(ExplicitObjectHitSet)
 TYPE(BloomHitSet)
+TYPE(BlockedBloomHitSet)
 TYPE_NONDETERMINISTIC(HitSet)   // because some subclasses are
 TYPE(HitSet::Params)
 
@@ -151,6 +151,120 @@ TEST(ErasureCodeTest, encode_misaligned_non_contiguous)
   }
 }
 
+TEST(ErasureCodeTest, minimum_to_decode_with_cost)
+{
+  ErasureCodeTest erasure_code(2, 2, 1024);
+  set<int> want_to_read;
+  want_to_read.insert(0);
+  map<int, int> available;
+  set<int> minimum;
+
+  // all equal: same as minimum_to_decode
+  for (int i = 0; i < 4; i++)
+    available[i] = 1;
+  ASSERT_EQ(0, erasure_code.minimum_to_decode_with_cost(want_to_read,
+							 available,
+							 &minimum));
+  EXPECT_EQ(want_to_read, minimum);
+
+  // reading two cheap chunks beats reading an expensive one
+  available[0] = 10;
+  available[1] = 10;
+  minimum.clear();
+  ASSERT_EQ(0, erasure_code.minimum_to_decode_with_cost(want_to_read,
+							 available,
+							 &minimum));
+  EXPECT_EQ(set<int>({2, 3}), minimum);
+
+  // but not when it costs the same
+  available[0] = 2;
+  minimum.clear();
+  ASSERT_EQ(0, erasure_code.minimum_to_decode_with_cost(want_to_read,
+							 available,
+							 &minimum));
+  EXPECT_EQ(want_to_read, minimum);
+
+  // not enough chunks
+  available.clear();
+  available[3] = 1;
+  minimum.clear();
+  EXPECT_EQ(-EIO, erasure_code.minimum_to_decode_with_cost(want_to_read,
+							    available,
+							    &minimum));
+}
+
+/*
+ * A k+1 code whose coding chunk is the XOR of the data chunks
+ */
+class ErasureCodeXorTest : public ErasureCodeTest {
+public:
+  ErasureCodeXorTest(unsigned int _k, unsigned int _chunk_size) :
+    ErasureCodeTest(_k, 1, _chunk_size) {}
+
+  virtual int encode_chunks(const set<int> &want_to_encode,
+			    map<int, bufferlist> *encoded) {
+    char *parity = (*encoded)[k].c_str();
+    memset(parity, 0, chunk_size);
+    for (unsigned int i = 0; i < k; i++) {
+      const char *data = (*encoded)[i].c_str();
+      for (unsigned int j = 0; j < chunk_size; j++)
+	parity[j] ^= data[j];
+    }
+    return 0;
+  }
+  virtual bool supports_parity_delta() const { return true; }
+};
+
+TEST(ErasureCodeTest, encode_delta)
+{
+  unsigned int k = 4;
+  unsigned chunk_size = ErasureCode::SIMD_ALIGN * 2 + 3;
+
+  {
+    ErasureCodeTest erasure_code(k, 1, chunk_size);
+    map<int, bufferlist> delta, parity;
+    delta[0].append_zero(chunk_size);
+    parity[k].append_zero(chunk_size);
+    ASSERT_EQ(-EOPNOTSUPP, erasure_code.encode_delta(delta, &parity));
+  }
+
+  ErasureCodeXorTest erasure_code(k, chunk_size);
+  set<int> want_to_encode;
+  for (unsigned int i = 0; i < erasure_code.get_chunk_count(); i++)
+    want_to_encode.insert(i);
+  string data;
+  for (unsigned int i = 0; i < k * chunk_size; i++)
+    data.push_back('A' + i % 26);
+  bufferlist in;
+  in.append(data);
+  map<int, bufferlist> encoded;
+  ASSERT_EQ(0, erasure_code.encode(want_to_encode, in, &encoded));
+
+  // overwrite part of chunks 1 and 3
+  string new_data = data;
+  for (unsigned int i = 10; i < chunk_size; i++)
+    new_data[chunk_size + i] = 'x';
+  for (unsigned int i = 0; i < 7; i++)
+    new_data[3 * chunk_size + i] = 'y';
+  map<int, bufferlist> delta;
+  for (int c : {1, 3}) {
+    bufferlist &bl = delta[c];
+    for (unsigned int i = 0; i < chunk_size; i++)
+      bl.append((char)(data[c * chunk_size + i] ^ new_data[c * chunk_size + i]));
+  }
+  map<int, bufferlist> parity;
+  parity[k] = encoded[k];
+  ASSERT_EQ(0, erasure_code.encode_delta(delta, &parity));
+
+  bufferlist new_in;
+  new_in.append(new_data);
+  map<int, bufferlist> new_encoded;
+  ASSERT_EQ(0, erasure_code.encode(want_to_encode, new_in, &new_encoded));
+  ASSERT_TRUE(new_encoded[k].contents_equal(parity[k]));
+  // the old parity is left alone
+  ASSERT_FALSE(encoded[k].contents_equal(parity[k]));
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
@@ -32,6 +32,7 @@ class IsaErasureCodeTest : public ::testing::Test {
 public:
   void compare_chunks(bufferlist &in, map<int, bufferlist> &encoded);
   void encode_decode(unsigned object_size); 
+  void encode_delta(ErasureCodeIsaDefault &Isa, bool all_parity);
 };
 
 void IsaErasureCodeTest::compare_chunks(bufferlist &in, map<int, bufferlist> &encoded)
@@ -187,6 +188,96 @@ TEST_F(IsaErasureCodeTest, encode_decode)
   encode_decode(4096 + 1);
 }
 
+//
+// Overwrite a random part of some data chunks and check that the old
+// coding chunks updated with encode_delta match those of the new data.
+// all_parity updates every coding chunk (ec_encode_data_update or, for
+// m == 1, the xor path), otherwise a single one (the generic path).
+//
+void IsaErasureCodeTest::encode_delta(ErasureCodeIsaDefault &Isa,
+				      bool all_parity)
+{
+  unsigned k = Isa.get_data_chunk_count();
+  unsigned n = Isa.get_chunk_count();
+  unsigned chunk_size = Isa.get_chunk_size(k * 4096 + 1);
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; i++)
+    want_to_encode.insert(i);
+
+  string data;
+  for (unsigned i = 0; i < k * chunk_size; i++)
+    data.push_back(rand());
+  bufferlist in;
+  in.append(data);
+  map<int, bufferlist> encoded;
+  ASSERT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+
+  // one chunk is always overwritten, the others half of the time
+  string new_data = data;
+  unsigned always = rand() % k;
+  map<int, bufferlist> delta;
+  for (unsigned c = 0; c < k; c++) {
+    if (c != always && rand() % 2)
+      continue;
+    unsigned off = rand() % chunk_size;
+    unsigned len = 1 + rand() % (chunk_size - off);
+    for (unsigned i = 0; i < len; i++)
+      new_data[c * chunk_size + off + i] = rand();
+    bufferlist &bl = delta[c];
+    for (unsigned i = 0; i < chunk_size; i++)
+      bl.append((char)(data[c * chunk_size + i] ^
+		       new_data[c * chunk_size + i]));
+  }
+
+  map<int, bufferlist> parity;
+  if (all_parity) {
+    for (unsigned i = k; i < n; i++)
+      parity[i] = encoded[i];
+  } else {
+    unsigned i = k + rand() % (n - k);
+    parity[i] = encoded[i];
+  }
+  map<int, string> old_parity;
+  for (auto &p : parity)
+    old_parity[p.first] = string(p.second.c_str(), chunk_size);
+  ASSERT_EQ(0, Isa.encode_delta(delta, &parity));
+
+  bufferlist new_in;
+  new_in.append(new_data);
+  map<int, bufferlist> new_encoded;
+  ASSERT_EQ(0, Isa.encode(want_to_encode, new_in, &new_encoded));
+  for (auto &p : parity) {
+    ASSERT_EQ(chunk_size, p.second.length());
+    EXPECT_EQ(0, memcmp(new_encoded[p.first].c_str(), p.second.c_str(),
+			chunk_size));
+    // the buffers passed in are not modified
+    EXPECT_EQ(0, memcmp(old_parity[p.first].c_str(),
+			encoded[p.first].c_str(), chunk_size));
+  }
+}
+
+TEST_F(IsaErasureCodeTest, encode_delta)
+{
+  const int matrices[] = { ErasureCodeIsaDefault::kVandermonde,
+			   ErasureCodeIsaDefault::kCauchy };
+  const char *km[][2] = { { "2", "1" }, { "4", "1" }, { "4", "2" },
+			  { "6", "3" }, { "12", "4" } };
+  for (auto matrix : matrices) {
+    for (auto &p : km) {
+      ErasureCodeIsaDefault Isa(tcache, matrix);
+      ErasureCodeProfile profile;
+      profile["k"] = p[0];
+      profile["m"] = p[1];
+      ASSERT_EQ(0, Isa.init(profile, &cerr));
+      EXPECT_TRUE(Isa.supports_parity_delta());
+      for (int i = 0; i < 20; i++) {
+	encode_delta(Isa, true);
+	encode_delta(Isa, false);
+      }
+    }
+  }
+}
+
 TEST_F(IsaErasureCodeTest, minimum_to_decode)
 {
   ErasureCodeIsaDefault Isa(tcache);
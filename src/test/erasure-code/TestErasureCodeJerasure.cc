@@ -277,6 +277,100 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+//
+// Overwrite a random part of some data chunks and check that the old
+// coding chunks updated with encode_delta match those of the new data.
+//
+static void encode_delta(ErasureCodeJerasure &jerasure, bool all_parity)
+{
+  unsigned k = jerasure.get_data_chunk_count();
+  unsigned n = jerasure.get_chunk_count();
+  unsigned chunk_size = jerasure.get_chunk_size(k * 4096 + 1);
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; i++)
+    want_to_encode.insert(i);
+
+  string data;
+  for (unsigned i = 0; i < k * chunk_size; i++)
+    data.push_back(rand());
+  bufferlist in;
+  in.append(data);
+  map<int, bufferlist> encoded;
+  ASSERT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+
+  // one chunk is always overwritten, the others half of the time
+  string new_data = data;
+  unsigned always = rand() % k;
+  map<int, bufferlist> delta;
+  for (unsigned c = 0; c < k; c++) {
+    if (c != always && rand() % 2)
+      continue;
+    unsigned off = rand() % chunk_size;
+    unsigned len = 1 + rand() % (chunk_size - off);
+    for (unsigned i = 0; i < len; i++)
+      new_data[c * chunk_size + off + i] = rand();
+    bufferlist &bl = delta[c];
+    for (unsigned i = 0; i < chunk_size; i++)
+      bl.append((char)(data[c * chunk_size + i] ^
+		       new_data[c * chunk_size + i]));
+  }
+
+  map<int, bufferlist> parity;
+  if (all_parity) {
+    for (unsigned i = k; i < n; i++)
+      parity[i] = encoded[i];
+  } else {
+    unsigned i = k + rand() % (n - k);
+    parity[i] = encoded[i];
+  }
+  ASSERT_EQ(0, jerasure.encode_delta(delta, &parity));
+
+  bufferlist new_in;
+  new_in.append(new_data);
+  map<int, bufferlist> new_encoded;
+  ASSERT_EQ(0, jerasure.encode(want_to_encode, new_in, &new_encoded));
+  for (auto &p : parity) {
+    ASSERT_EQ(chunk_size, p.second.length());
+    EXPECT_TRUE(new_encoded[p.first].contents_equal(p.second));
+  }
+}
+
+TEST(ErasureCodeTest, encode_delta)
+{
+  const char *km[][2] = { { "2", "1" }, { "4", "2" }, { "6", "3" },
+			  { "10", "4" } };
+  const char *ws[] = { "8", "16", "32" };
+  for (auto w : ws) {
+    for (auto &p : km) {
+      ErasureCodeJerasureReedSolomonVandermonde jerasure;
+      ErasureCodeProfile profile;
+      profile["k"] = p[0];
+      profile["m"] = p[1];
+      profile["w"] = w;
+      ASSERT_EQ(0, jerasure.init(profile, &cerr));
+      EXPECT_TRUE(jerasure.supports_parity_delta());
+      for (int i = 0; i < 20; i++) {
+	encode_delta(jerasure, true);
+	encode_delta(jerasure, false);
+      }
+    }
+  }
+
+  // the bit matrix codes don't support it
+  ErasureCodeJerasureCauchyGood jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  ASSERT_EQ(0, jerasure.init(profile, &cerr));
+  EXPECT_FALSE(jerasure.supports_parity_delta());
+  map<int, bufferlist> delta, parity;
+  unsigned chunk_size = jerasure.get_chunk_size(4 * 4096);
+  delta[0].append_zero(chunk_size);
+  parity[4].append_zero(chunk_size);
+  EXPECT_EQ(-EOPNOTSUPP, jerasure.encode_delta(delta, &parity));
+}
+
 TEST(ErasureCodeTest, create_ruleset)
 {
   CrushWrapper *c = new CrushWrapper;
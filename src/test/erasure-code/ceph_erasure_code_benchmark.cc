@@ -32,6 +32,7 @@
 #include "include/utime.h"
 #include "erasure-code/ErasureCodePlugin.h"
 #include "erasure-code/ErasureCode.h"
+#include "osd/ECUtil.h"
 #include "ceph_erasure_code_benchmark.h"
 
 namespace po = boost::program_options;
@@ -49,7 +50,7 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     ("plugin,p", po::value<string>()->default_value("jerasure"),
      "erasure code plugin name")
     ("workload,w", po::value<string>()->default_value("encode"),
-     "run either encode or decode")
+     "run either encode, decode or recover")
     ("erasures,e", po::value<int>()->default_value(1),
      "number of erasures when decoding")
     ("erased", po::value<vector<int> >(),
@@ -61,6 +62,10 @@ int ErasureCodeBench::setup(int argc, char** argv) {
      " the first chunk, then the second etc.)")
     ("parameter,P", po::value<vector<string> >(),
      "add a parameter to the erasure code profile")
+    ("objects,o", po::value<int>()->default_value(16),
+     "number of objects of --size bytes recovered together (recover)")
+    ("stripe-width", po::value<int>()->default_value(4096),
+     "pool stripe width (recover)")
     ;
 
   po::variables_map vm;
@@ -113,6 +118,8 @@ int ErasureCodeBench::setup(int argc, char** argv) {
   plugin = vm["plugin"].as<string>();
   workload = vm["workload"].as<string>();
   erasures = vm["erasures"].as<int>();
+  objects = vm["objects"].as<int>();
+  stripe_width = vm["stripe-width"].as<int>();
   if (vm.count("erasures-generation") > 0 &&
       vm["erasures-generation"].as<string>() == "exhaustive")
     exhaustive_erasures = true;
@@ -143,6 +150,8 @@ int ErasureCodeBench::run() {
 
   if (workload == "encode")
     return encode();
+  else if (workload == "recover")
+    return recover();
   else
     return decode();
 }
@@ -326,6 +335,118 @@ int ErasureCodeBench::decode()
   return 0;
 }
 
+/*
+ * Rebuild the erased chunks of --objects objects at once, the way
+ * the OSD recovers a batch of objects: read the chunks picked by
+ * minimum_to_decode_with_cost from each object and decode all of the
+ * objects in one pass.  Prints the elapsed time, the objects recovered
+ * per second and the bytes read per byte recovered.
+ */
+int ErasureCodeBench::recover()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf->erasure_code_dir,
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+  if (erasure_code->get_data_chunk_count() != (unsigned int)k ||
+      (erasure_code->get_chunk_count() - erasure_code->get_data_chunk_count()
+       != (unsigned int)m)) {
+    cout << "parameter k is " << k << "/m is " << m << ". But data chunk count is "
+      << erasure_code->get_data_chunk_count() <<"/parity chunk count is "
+      << erasure_code->get_chunk_count() - erasure_code->get_data_chunk_count() << endl;
+    return -EINVAL;
+  }
+  if (objects <= 0 || stripe_width <= 0) {
+    cout << "--objects and --stripe-width must be > 0" << endl;
+    return -EINVAL;
+  }
+
+  ECUtil::stripe_info_t sinfo(
+    k, k * erasure_code->get_chunk_size(stripe_width));
+  uint64_t object_size =
+    sinfo.logical_to_next_stripe_offset(in_size);
+  bufferlist in;
+  for (uint64_t i = 0; i < object_size; i++)
+    in.append((char)(rand() & 0xff));
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+  map<int,bufferlist> encoded;
+  code = ECUtil::encode(sinfo, erasure_code, in, want_to_encode, &encoded);
+  if (code)
+    return code;
+
+  // the same chunks are lost for every object, as when an OSD fails
+  set<int> want_to_read(erased.begin(), erased.end());
+  while (want_to_read.size() < (unsigned)erasures)
+    want_to_read.insert(rand() % (k + m));
+  map<int, int> available;
+  for (int i = 0; i < k + m; i++) {
+    if (!want_to_read.count(i))
+      available[i] = 1;
+  }
+  set<int> minimum;
+  code = erasure_code->minimum_to_decode_with_cost(want_to_read, available,
+						   &minimum);
+  if (code)
+    return code;
+  if (verbose) {
+    map<int,bufferlist> chunks;
+    for (set<int>::iterator i = minimum.begin(); i != minimum.end(); ++i)
+      chunks[*i];
+    display_chunks(chunks, erasure_code->get_chunk_count());
+  }
+
+  uint64_t bytes_read = 0, bytes_recovered = 0;
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    map<int,bufferlist> chunks;
+    for (int j = 0; j < objects; j++) {
+      for (set<int>::iterator c = minimum.begin(); c != minimum.end(); ++c) {
+	chunks[*c].append(encoded[*c]);
+	bytes_read += encoded[*c].length();
+      }
+    }
+    map<int,bufferlist> decoded;
+    map<int,bufferlist*> target;
+    for (set<int>::iterator c = want_to_read.begin();
+	 c != want_to_read.end();
+	 ++c)
+      target[*c] = &decoded[*c];
+    code = ECUtil::decode(sinfo, erasure_code, chunks, target);
+    if (code)
+      return code;
+    for (set<int>::iterator c = want_to_read.begin();
+	 c != want_to_read.end();
+	 ++c) {
+      bytes_recovered += decoded[*c].length();
+      if (i == 0) {
+	bufferlist expected;
+	expected.substr_of(decoded[*c], 0, encoded[*c].length());
+	if (!expected.contents_equal(encoded[*c])) {
+	  cerr << "chunk " << *c
+	       << " content and recovered content are different" << endl;
+	  return -1;
+	}
+      }
+    }
+  }
+  utime_t end_time = ceph_clock_now();
+  double elapsed = end_time - begin_time;
+  cout << elapsed << "\t"
+       << (elapsed > 0 ? max_iterations * objects / elapsed : 0) << "\t"
+       << (bytes_recovered ? (double)bytes_read / bytes_recovered : 0)
+       << endl;
+  return 0;
+}
+
 int main(int argc, char** argv) {
   ErasureCodeBench ecbench;
   try {
@@ -451,6 +451,64 @@ TEST_F(LibRadosIoPP, RemoveTestPP) {
   ASSERT_EQ(-ENOENT, ioctx.read("foo", bl2, sizeof(buf), 0));
 }
 
+TEST_F(LibRadosIoPP, MissingThenCreatePP) {
+  bufferlist bl;
+  uint64_t size;
+  time_t mtime;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(-ENOENT, ioctx.stat("foo", &size, &mtime));
+    ASSERT_EQ(-ENOENT, ioctx.read("foo", bl, 128, 0));
+  }
+  char buf[128];
+  memset(buf, 0xaa, sizeof(buf));
+  bufferlist bl1;
+  bl1.append(buf, sizeof(buf));
+  ASSERT_EQ(0, ioctx.write_full("foo", bl1));
+  bufferlist bl2;
+  ASSERT_EQ((int)sizeof(buf), ioctx.read("foo", bl2, sizeof(buf), 0));
+  ASSERT_EQ(0, memcmp(bl2.c_str(), buf, sizeof(buf)));
+}
+
+TEST_F(LibRadosIoPP, RemoveRecreatePP) {
+  char buf[128];
+  for (int i = 0; i < 3; ++i) {
+    memset(buf, 0xaa + i, sizeof(buf));
+    bufferlist bl1;
+    bl1.append(buf, sizeof(buf));
+    ASSERT_EQ(0, ioctx.write_full("foo", bl1));
+    bufferlist bl2;
+    ASSERT_EQ((int)sizeof(buf), ioctx.read("foo", bl2, sizeof(buf), 0));
+    ASSERT_EQ(0, memcmp(bl2.c_str(), buf, sizeof(buf)));
+    ASSERT_EQ(0, ioctx.remove("foo"));
+    bufferlist bl3;
+    ASSERT_EQ(-ENOENT, ioctx.read("foo", bl3, sizeof(buf), 0));
+    ASSERT_EQ(-ENOENT, ioctx.read("foo", bl3, sizeof(buf), 0));
+  }
+}
+
+TEST_F(LibRadosIoPP, MissingThenCreateAfterLogTrimPP) {
+  // keep everything in one pg so that its log is trimmed past the
+  // lookup and the create of foo, and foo's obc is pushed out of the cache
+  ioctx.locator_set_key("trim");
+  bufferlist bl;
+  ASSERT_EQ(-ENOENT, ioctx.read("foo", bl, 128, 0));
+  char buf[128];
+  memset(buf, 0xaa, sizeof(buf));
+  bufferlist bl1;
+  bl1.append(buf, sizeof(buf));
+  ASSERT_EQ(0, ioctx.write_full("foo", bl1));
+  bufferlist bl2;
+  bl2.append("bar");
+  for (int i = 0; i < 2000; ++i) {
+    char oid[32];
+    snprintf(oid, sizeof(oid), "bar%d", i % 200);
+    ASSERT_EQ(0, ioctx.write_full(oid, bl2));
+  }
+  bufferlist bl3;
+  ASSERT_EQ((int)sizeof(buf), ioctx.read("foo", bl3, sizeof(buf), 0));
+  ASSERT_EQ(0, memcmp(bl3.c_str(), buf, sizeof(buf)));
+}
+
 TEST_F(LibRadosIo, XattrsRoundTrip) {
   char buf[128];
   char attr1[] = "attr1";
@@ -1090,6 +1090,23 @@ int cls_cxx_map_get_val(cls_method_context_t hctx, const string &key,
   return 0;
 }
 
+int cls_cxx_map_get_vals_by_keys(cls_method_context_t hctx,
+                                 const std::set<string> &keys,
+                                 std::map<string, bufferlist> *vals) {
+  vals->clear();
+  for (auto& key : keys) {
+    bufferlist bl;
+    int r = cls_cxx_map_get_val(hctx, key, &bl);
+    if (r == -ENOENT) {
+      continue;
+    } else if (r < 0) {
+      return r;
+    }
+    (*vals)[key].claim(bl);
+  }
+  return vals->size();
+}
+
 int cls_cxx_map_get_vals(cls_method_context_t hctx, const string &start_obj,
                          const string &filter_prefix, uint64_t max_to_get,
                          std::map<string, bufferlist> *vals) {
@@ -1108,6 +1125,13 @@ int cls_cxx_map_remove_key(cls_method_context_t hctx, const string &key) {
   return ctx->io_ctx_impl->omap_rm_keys(ctx->oid, keys);
 }
 
+int cls_cxx_map_remove_keys(cls_method_context_t hctx,
+                            const std::set<string> &keys) {
+  librados::TestClassHandler::MethodContext *ctx =
+    reinterpret_cast<librados::TestClassHandler::MethodContext*>(hctx);
+  return ctx->io_ctx_impl->omap_rm_keys(ctx->oid, keys);
+}
+
 int cls_cxx_map_set_val(cls_method_context_t hctx, const string &key,
                         bufferlist *inbl) {
   std::map<std::string, bufferlist> m;
@@ -0,0 +1,487 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Self contained messenger benchmark.
+ *
+ * A server messenger and a set of client messengers are started in the
+ * same process and talk over loopback, so a run only depends on the
+ * messenger implementation selected by ms_type (and, for async, by
+ * ms_async_transport_type).  Each client messenger owns one connection;
+ * connections are spread round robin over the sending threads.  Every
+ * MOSDOp carries a per connection sequence number as its tid, which the
+ * server echoes back in an MOSDOpReply straight from fast dispatch, so
+ * the measured latency is the messenger round trip and nothing else.
+ *
+ * The report contains throughput, latency percentiles taken from a
+ * log-linear (HDR style) histogram and the process CPU time divided by
+ * the number of messages exchanged.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "common/ceph_argparse.h"
+#include "common/Cond.h"
+#include "common/Cycles.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "common/strtol.h"
+#include "global/global_init.h"
+#include "include/str_list.h"
+#include "msg/Messenger.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+
+/**
+ * Log-linear latency histogram.
+ *
+ * Values below 2^SUB_BITS get a bucket each; above that every power of
+ * two range is split into 2^SUB_BITS equal buckets, which bounds the
+ * relative error of a reported percentile to 2^-SUB_BITS (~3%).
+ */
+class LatencyHistogram {
+  static const unsigned SUB_BITS = 5;
+  static const uint64_t SUB = 1ull << SUB_BITS;
+  vector<uint64_t> buckets;
+  uint64_t count = 0;
+  uint64_t max = 0;
+  uint64_t sum = 0;
+
+  static unsigned index(uint64_t v) {
+    if (v < SUB)
+      return v;
+    unsigned shift = (63 - __builtin_clzll(v)) - SUB_BITS;
+    return SUB + shift * SUB + ((v >> shift) - SUB);
+  }
+  static uint64_t upper_bound(unsigned idx) {
+    if (idx < 2 * SUB)
+      return idx;
+    unsigned shift = idx / SUB - 1;
+    return ((SUB + idx % SUB + 1) << shift) - 1;
+  }
+
+ public:
+  LatencyHistogram() : buckets(SUB * (64 - SUB_BITS + 1), 0) {}
+
+  void add(uint64_t v) {
+    ++buckets[index(v)];
+    ++count;
+    sum += v;
+    if (v > max)
+      max = v;
+  }
+  void merge(const LatencyHistogram& o) {
+    for (unsigned i = 0; i < buckets.size(); ++i)
+      buckets[i] += o.buckets[i];
+    count += o.count;
+    sum += o.sum;
+    if (o.max > max)
+      max = o.max;
+  }
+  uint64_t get_count() const { return count; }
+  uint64_t get_max() const { return max; }
+  uint64_t get_mean() const { return count ? sum / count : 0; }
+  uint64_t percentile(double p) const {
+    if (!count)
+      return 0;
+    uint64_t want = (uint64_t)(p / 100.0 * count + 0.5);
+    if (want == 0)
+      want = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < buckets.size(); ++i) {
+      seen += buckets[i];
+      if (seen >= want)
+	return std::min(upper_bound(i), max);
+    }
+    return max;
+  }
+};
+
+/**
+ * Message payload sizes to draw from.  Parsed from a comma separated
+ * list of SIZE[*WEIGHT] entries, e.g. "4096" or "512*8,4096*4,65536".
+ */
+class SizeDistribution {
+  vector<bufferlist> payloads;
+  vector<uint32_t> sizes;
+  vector<double> weights;
+
+ public:
+  int parse(const string& spec, ostream& err) {
+    list<string> entries;
+    get_str_list(spec, ",", entries);
+    for (auto& e : entries) {
+      string s = e, w = "1";
+      size_t star = e.find('*');
+      if (star != string::npos) {
+	s = e.substr(0, star);
+	w = e.substr(star + 1);
+      }
+      string serr;
+      uint64_t size = strict_sistrtoll(s.c_str(), &serr);
+      if (!serr.empty()) {
+	err << "bad size '" << s << "': " << serr;
+	return -EINVAL;
+      }
+      uint64_t weight = strict_strtoll(w.c_str(), 10, &serr);
+      if (!serr.empty() || weight == 0) {
+	err << "bad weight '" << w << "'";
+	return -EINVAL;
+      }
+      sizes.push_back(size);
+      weights.push_back(weight);
+      bufferptr ptr(size);
+      memset(ptr.c_str(), 0, size);
+      payloads.push_back(bufferlist());
+      payloads.back().append(ptr);
+    }
+    if (sizes.empty()) {
+      err << "empty size list";
+      return -EINVAL;
+    }
+    return 0;
+  }
+  discrete_distribution<unsigned> distribution() const {
+    return discrete_distribution<unsigned>(weights.begin(), weights.end());
+  }
+  const bufferlist& payload(unsigned i) const { return payloads[i]; }
+  void dump(ostream& out) const {
+    for (unsigned i = 0; i < sizes.size(); ++i)
+      out << (i ? "," : "") << sizes[i] << "*" << weights[i];
+  }
+};
+
+class ServerDispatcher : public Dispatcher {
+ public:
+  ServerDispatcher() : Dispatcher(g_ceph_context) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OP;
+  }
+  void ms_handle_fast_connect(Connection *con) override {}
+  void ms_handle_fast_accept(Connection *con) override {}
+  bool ms_dispatch(Message *m) override { m->put(); return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  void ms_fast_dispatch(Message *m) override {
+    MOSDOp *op = static_cast<MOSDOp*>(m);
+    m->get_connection()->send_message(new MOSDOpReply(op, 0, 0, 0, false));
+    m->put();
+  }
+  bool ms_verify_authorizer(Connection *con, int peer_type, int protocol,
+			    bufferlist& authorizer, bufferlist& authorizer_reply,
+			    bool& isvalid, CryptoKey& session_key) override {
+    isvalid = true;
+    return true;
+  }
+};
+
+struct BenchConfig {
+  string addr = "127.0.0.1:16800";
+  int conns = 1;
+  int threads = 1;
+  int depth = 16;
+  uint64_t ops = 100000;
+  SizeDistribution sizes;
+};
+
+class ClientThread;
+
+/// one client messenger with its single connection to the server
+struct ClientConn : public Dispatcher {
+  ClientThread *thread;
+  Messenger *msgr = nullptr;
+  ConnectionRef con;
+  uint64_t sent = 0;
+  uint64_t inflight = 0;
+  /// send timestamp (cycles) of each outstanding tid, indexed by tid % depth
+  vector<uint64_t> stamps;
+
+  ClientConn(ClientThread *t, int depth)
+    : Dispatcher(g_ceph_context), thread(t), stamps(depth, 0) {}
+
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OPREPLY;
+  }
+  void ms_handle_fast_connect(Connection *con) override {}
+  void ms_handle_fast_accept(Connection *con) override {}
+  bool ms_dispatch(Message *m) override { m->put(); return true; }
+  void ms_fast_dispatch(Message *m) override;
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  bool ms_verify_authorizer(Connection *con, int peer_type, int protocol,
+			    bufferlist& authorizer, bufferlist& authorizer_reply,
+			    bool& isvalid, CryptoKey& session_key) override {
+    isvalid = true;
+    return true;
+  }
+};
+
+class ClientThread : public Thread {
+  const BenchConfig& conf;
+  object_t oid;
+  object_locator_t oloc;
+  pg_t pgid;
+  std::mt19937 rng;
+
+ public:
+  Mutex lock;
+  Cond cond;
+  vector<ClientConn*> conns;
+  LatencyHistogram hist;
+  uint64_t bytes = 0;
+
+  ClientThread(const BenchConfig& c, int seed)
+    : conf(c), oid("perf_msgr"), oloc(1, 1), rng(seed),
+      lock("ClientThread::lock") {}
+  ~ClientThread() {
+    for (auto c : conns)
+      delete c;
+  }
+
+  void *entry() override {
+    auto dist = conf.sizes.distribution();
+    Mutex::Locker l(lock);
+    while (true) {
+      bool busy = false;
+      bool done = true;
+      for (auto c : conns) {
+	if (c->sent < conf.ops || c->inflight)
+	  done = false;
+	if (c->sent == conf.ops || c->inflight == (uint64_t)conf.depth)
+	  continue;
+	bufferlist data = conf.sizes.payload(dist(rng));
+	// write() claims data
+	uint64_t len = data.length();
+	uint64_t tid = c->sent++;
+	MOSDOp *m = new MOSDOp(0, tid, oid, oloc, pgid, 0, 0, 0);
+	m->write(0, len, data);
+	bytes += len;
+	c->stamps[tid % conf.depth] = Cycles::rdtsc();
+	c->inflight++;
+	lock.Unlock();
+	c->con->send_message(m);
+	lock.Lock();
+	busy = true;
+      }
+      if (done)
+	break;
+      if (!busy)
+	cond.Wait(lock);
+    }
+    return 0;
+  }
+};
+
+void ClientConn::ms_fast_dispatch(Message *m)
+{
+  uint64_t now = Cycles::rdtsc();
+  uint64_t tid = m->get_tid();
+  m->put();
+  Mutex::Locker l(thread->lock);
+  // a connection never has more than depth ops in flight and replies come
+  // back in order, so the slot still holds this tid's send time.
+  thread->hist.add(Cycles::to_nanoseconds(now - stamps[tid % stamps.size()]));
+  inflight--;
+  thread->cond.Signal();
+}
+
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+}
+
+static int run(const BenchConfig& conf)
+{
+  const string type = g_conf->ms_type;
+  entity_addr_t addr;
+  if (!addr.parse(conf.addr.c_str())) {
+    cerr << "unable to parse address " << conf.addr << std::endl;
+    return -EINVAL;
+  }
+
+  ServerDispatcher server_dispatcher;
+  Messenger *server = Messenger::create(g_ceph_context, type,
+					entity_name_t::OSD(0), "server",
+					getpid(), 0);
+  server->set_default_policy(Messenger::Policy::stateless_server(0, 0));
+  int r = server->bind(addr);
+  if (r < 0) {
+    cerr << "unable to bind to " << addr << ": " << cpp_strerror(r) << std::endl;
+    delete server;
+    return r;
+  }
+  server->add_dispatcher_head(&server_dispatcher);
+  server->start();
+  addr = server->get_myaddr();
+
+  vector<ClientThread*> threads;
+  for (int i = 0; i < conf.threads; ++i)
+    threads.push_back(new ClientThread(conf, i));
+  for (int i = 0; i < conf.conns; ++i) {
+    ClientThread *t = threads[i % conf.threads];
+    ClientConn *c = new ClientConn(t, conf.depth);
+    c->msgr = Messenger::create(g_ceph_context, type,
+				entity_name_t::CLIENT(i), "client",
+				getpid() + i + 1, 0);
+    c->msgr->set_default_policy(Messenger::Policy::lossless_client(0, 0));
+    c->msgr->add_dispatcher_head(c);
+    c->msgr->start();
+    c->con = c->msgr->get_connection(entity_inst_t(entity_name_t::OSD(0), addr));
+    t->conns.push_back(c);
+  }
+
+  Cycles::init();
+  double cpu_start = cpu_seconds();
+  uint64_t start = Cycles::rdtsc();
+  for (auto t : threads)
+    t->create("perf_msgr");
+  for (auto t : threads)
+    t->join();
+  uint64_t elapsed = Cycles::rdtsc() - start;
+  double cpu = cpu_seconds() - cpu_start;
+
+  LatencyHistogram hist;
+  uint64_t bytes = 0;
+  for (auto t : threads) {
+    hist.merge(t->hist);
+    bytes += t->bytes;
+  }
+  double secs = Cycles::to_seconds(elapsed);
+  uint64_t msgs = hist.get_count();
+
+  cout << std::fixed << std::setprecision(2);
+  cout << "ms_type: " << type;
+  if (type == "async")
+    cout << "+" << g_conf->ms_async_transport_type;
+  cout << std::endl;
+  cout << "conns: " << conf.conns << std::endl;
+  cout << "threads: " << conf.threads << std::endl;
+  cout << "depth: " << conf.depth << std::endl;
+  cout << "sizes: ";
+  conf.sizes.dump(cout);
+  cout << std::endl;
+  cout << "ops: " << msgs << std::endl;
+  cout << "seconds: " << secs << std::endl;
+  cout << "ops/s: " << msgs / secs << std::endl;
+  cout << "MB/s: " << bytes / secs / (1024 * 1024) << std::endl;
+  cout << "cpu_us/op: " << (msgs ? cpu * 1000000 / msgs : 0) << std::endl;
+  cout << "lat_mean_us: " << hist.get_mean() / 1000.0 << std::endl;
+  const pair<const char*, double> pcts[] = {
+    { "p50", 50 }, { "p90", 90 }, { "p99", 99 }, { "p99.9", 99.9 },
+    { "p99.99", 99.99 } };
+  for (auto& p : pcts)
+    cout << "lat_" << p.first << "_us: " << hist.percentile(p.second) / 1000.0
+	 << std::endl;
+  cout << "lat_max_us: " << hist.get_max() / 1000.0 << std::endl;
+
+  for (auto t : threads) {
+    for (auto c : t->conns) {
+      c->msgr->shutdown();
+      c->msgr->wait();
+      delete c->msgr;
+    }
+    delete t;
+  }
+  server->shutdown();
+  server->wait();
+  delete server;
+  return 0;
+}
+
+static void usage(const char *name)
+{
+  cout << "usage: " << name << " [options]\n"
+       << "  --addr IP:PORT      address the server binds to (default 127.0.0.1:16800)\n"
+       << "  --conns N           client connections, one messenger each (default 1)\n"
+       << "  --threads N         sending threads, connections are spread over them (default 1)\n"
+       << "  --depth N           max messages in flight per connection (default 16)\n"
+       << "  --ops N             messages sent per connection (default 100000)\n"
+       << "  --sizes LIST        payload sizes as SIZE[*WEIGHT],... (default 4096)\n"
+       << "\nThe messenger is selected with the usual --ms_type and\n"
+       << "--ms_async_transport_type options.\n";
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  BenchConfig conf;
+  string sizes = "4096";
+  std::string val;
+  std::ostringstream err;
+  for (auto i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage(argv[0]);
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "--addr", (char*)NULL)) {
+      conf.addr = val;
+    } else if (ceph_argparse_witharg(args, i, &conf.conns, err, "--conns", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &conf.threads, err, "--threads", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &conf.depth, err, "--depth", (char*)NULL)) {
+    } else if (ceph_argparse_witharg(args, i, &val, "--ops", (char*)NULL)) {
+      string interr;
+      conf.ops = strict_strtoll(val.c_str(), 10, &interr);
+      if (!interr.empty())
+	err << "--ops: " << interr;
+    } else if (ceph_argparse_witharg(args, i, &val, "--sizes", (char*)NULL)) {
+      sizes = val;
+    } else {
+      cerr << "unrecognized argument: " << *i << std::endl;
+      usage(argv[0]);
+      return 1;
+    }
+    if (!err.str().empty()) {
+      cerr << err.str() << std::endl;
+      return 1;
+    }
+  }
+  if (conf.conns <= 0 || conf.threads <= 0 || conf.depth <= 0) {
+    cerr << "--conns, --threads and --depth must be positive" << std::endl;
+    return 1;
+  }
+  if (conf.threads > conf.conns)
+    conf.threads = conf.conns;
+  if (conf.sizes.parse(sizes, err) < 0) {
+    cerr << "--sizes: " << err.str() << std::endl;
+    return 1;
+  }
+
+  return run(conf) < 0 ? 1 : 0;
+}
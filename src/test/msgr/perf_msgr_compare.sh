@@ -0,0 +1,56 @@
+#!/bin/bash
+#
+# Run ceph_perf_msgr against each messenger implementation over loopback
+# and print one line per implementation, so changes to a messenger can be
+# compared against the others (and against an earlier build) at a glance.
+#
+# Usage: perf_msgr_compare.sh [stack...] [-- ceph_perf_msgr options]
+#
+#   stack    simple, async+posix, async+dpdk or async+rdma
+#            (default: simple async+posix)
+#
+# Everything after -- is handed to ceph_perf_msgr unchanged, e.g.
+#
+#   perf_msgr_compare.sh -- --conns 16 --threads 4 --sizes 4096*8,65536
+#
+# The dpdk and rdma stacks need their usual ms_dpdk_* / ms_async_rdma_*
+# settings, which can be supplied through CEPH_ARGS.
+#
+# Exits non-zero if a stack reports no throughput, which lets make check
+# run it as a smoke test of the benchmark.
+
+set -e
+
+BIN=${BIN:-${CEPH_BIN:-$(dirname $0)}}
+
+stacks=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --) shift; break ;;
+        *) stacks+=("$1"); shift ;;
+    esac
+done
+[ ${#stacks[@]} -gt 0 ] || stacks=(simple async+posix)
+
+printf "%-14s %10s %10s %10s %10s %10s %10s %10s\n" \
+    stack ops/s MB/s cpu_us/op p50_us p99_us p99.9_us max_us
+for stack in "${stacks[@]}"; do
+    case "$stack" in
+        simple) opts="--ms_type=simple" ;;
+        async+*) opts="--ms_type=async --ms_async_transport_type=${stack#async+}" ;;
+        *) echo "unknown stack $stack" >&2; exit 1 ;;
+    esac
+    out=$($BIN/ceph_perf_msgr $opts --log_file=/dev/null "$@")
+    field() { echo "$out" | sed -n "s|^$1: ||p"; }
+    printf "%-14s %10s %10s %10s %10s %10s %10s %10s\n" $stack \
+        $(field ops/s) $(field MB/s) $(field cpu_us/op) \
+        $(field lat_p50_us) $(field lat_p99_us) \
+        $(field lat_p99.9_us) $(field lat_max_us)
+    for f in ops/s MB/s; do
+        if ! awk -v v="$(field $f)" 'BEGIN { exit !(v > 0) }'; then
+            echo "$stack: no $f reported" >&2
+            failed=1
+        fi
+    done
+done
+exit ${failed:-0}
@@ -0,0 +1,59 @@
+#!/bin/bash
+#
+# Connection count scaling benchmark for the async+rdma messenger.
+#
+# Runs ceph_perf_msgr_server/ceph_perf_msgr_client over a soft-RoCE (rxe)
+# device so the RDMA stack can be exercised without RDMA capable NICs.
+# For each connection count the client opens that many messengers (one
+# connection each) against a single server and the aggregate message rate
+# is reported, together with the number of memory regions the server holds
+# on the rdma device.
+#
+# Usage: [NETDEV=eth0] [IP=a.b.c.d] perf_msgr_rdma_rxe.sh [conns...]
+#
+#   NETDEV   ethernet device to attach rxe to (default: first non-lo device)
+#   IP       address of NETDEV to bind the server to
+#   conns    connection counts to test (default: 1 8 64 256)
+#
+# Requires the rdma_rxe module and the rdma tool from iproute2, and root
+# to create the rxe link. Extra ceph options can be passed through
+# CEPH_ARGS, e.g. CEPH_ARGS="--ms_async_rdma_reg_cache_bytes=268435456".
+
+set -e
+
+NETDEV=${NETDEV:-$(ip -o link show | awk -F': ' '$2 != "lo" {print $2; exit}')}
+IP=${IP:-$(ip -o -4 addr show dev $NETDEV | awk '{split($4, a, "/"); print a[1]; exit}')}
+CONNS=${@:-1 8 64 256}
+
+PORT=${PORT:-16789}
+IOS=${IOS:-20000}
+DEPTH=${DEPTH:-16}
+MSG_LEN=${MSG_LEN:-4096}
+SERVER_THREADS=${SERVER_THREADS:-4}
+BIN=${BIN:-$(dirname $0)}
+
+RXE=rxe_$NETDEV
+if ! rdma link show $RXE/1 >/dev/null 2>&1; then
+    modprobe rdma_rxe
+    rdma link add $RXE type rxe netdev $NETDEV
+fi
+
+export CEPH_ARGS="$CEPH_ARGS --ms_type=async --ms_async_transport_type=rdma \
+    --ms_async_rdma_device_name=$RXE --ms_async_rdma_roce_ver=1 \
+    --log_file=/dev/null"
+
+$BIN/ceph_perf_msgr_server $IP:$PORT $SERVER_THREADS 0 &
+SERVER=$!
+trap "kill $SERVER 2>/dev/null" EXIT
+sleep 2
+
+printf "%8s %12s %12s %10s %8s\n" conns msgs usec msgs/s mrs
+for n in $CONNS; do
+    ios=$((IOS / n))
+    [ $ios -gt 0 ] || ios=1
+    usec=$($BIN/ceph_perf_msgr_client $IP:$PORT $n $DEPTH $ios 0 $MSG_LEN 2>&1 | \
+        sed -n 's/.*run time \([0-9]*\)us.*/\1/p')
+    total=$((ios * n))
+    mrs=$(rdma resource show mr 2>/dev/null | grep -c "pid $SERVER " || true)
+    printf "%8d %12d %12d %10d %8s\n" $n $total $usec $((total * 1000000 / usec)) $mrs
+done
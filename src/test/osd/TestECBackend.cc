@@ -17,6 +17,9 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "osd/ECTransaction.h"
+#include "erasure-code/ErasureCode.h"
+#include "global/global_context.h"
 #include "gtest/gtest.h"
 
 TEST(ECUtil, stripe_info_t)
@@ -58,3 +61,196 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+/*
+ * A k=3, m=2 linear code: the first coding chunk is the XOR of the data
+ * chunks, the second XORs data chunk i rotated by i bytes.
+ */
+class ErasureCodeLinearTest : public ErasureCode {
+public:
+  static const unsigned k = 3;
+  static const unsigned m = 2;
+
+  int init(ErasureCodeProfile &profile, ostream *ss) override {
+    return 0;
+  }
+  int create_ruleset(const string &name,
+		     CrushWrapper &crush,
+		     ostream *ss) const override {
+    return 0;
+  }
+  unsigned int get_chunk_count() const override { return k + m; }
+  unsigned int get_data_chunk_count() const override { return k; }
+  unsigned int get_chunk_size(unsigned int object_size) const override {
+    return (object_size + k - 1) / k;
+  }
+  bool supports_parity_delta() const override { return true; }
+  int encode_chunks(const set<int> &want_to_encode,
+		    map<int, bufferlist> *encoded) override {
+    unsigned chunk_size = (*encoded)[0].length();
+    char *p0 = (*encoded)[k].c_str();
+    char *p1 = (*encoded)[k + 1].c_str();
+    memset(p0, 0, chunk_size);
+    memset(p1, 0, chunk_size);
+    for (unsigned i = 0; i < k; i++) {
+      const char *d = (*encoded)[i].c_str();
+      for (unsigned j = 0; j < chunk_size; j++) {
+	p0[j] ^= d[j];
+	p1[j] ^= d[(j + i) % chunk_size];
+      }
+    }
+    return 0;
+  }
+};
+
+TEST(ECUtil, encode_delta)
+{
+  const unsigned k = ErasureCodeLinearTest::k;
+  const unsigned m = ErasureCodeLinearTest::m;
+  const uint64_t chunk_size = 256;
+  const unsigned stripes = 4;
+  ErasureCodeInterfaceRef ec_impl(new ErasureCodeLinearTest);
+  ECUtil::stripe_info_t sinfo(k, k * chunk_size);
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  set<int> want;
+  for (unsigned i = 0; i < k + m; i++)
+    want.insert(i);
+
+  string data;
+  for (unsigned i = 0; i < stripes * stripe_width; i++)
+    data.push_back(rand());
+  bufferlist in;
+  in.append(data);
+  map<int, bufferlist> encoded;
+  ASSERT_EQ(0, ECUtil::encode(sinfo, ec_impl, in, want, &encoded));
+
+  // overwrite parts of data chunks 0 and 2 in some of the stripes
+  string new_data = data;
+  const pair<uint64_t, uint64_t> writes[] = {
+    { 10, 50 },                                       // chunk 0, stripe 0
+    { stripe_width + 2 * chunk_size + 5, 100 },       // chunk 2, stripe 1
+    { 3 * stripe_width, chunk_size },                 // chunk 0, stripe 3
+    { 3 * stripe_width + 3 * chunk_size - 1, 1 },     // chunk 2, stripe 3
+  };
+  for (auto &w : writes) {
+    for (uint64_t i = w.first; i < w.first + w.second; i++)
+      new_data[i] = rand();
+  }
+  bufferlist new_in;
+  new_in.append(new_data);
+  map<int, bufferlist> new_encoded;
+  ASSERT_EQ(0, ECUtil::encode(sinfo, ec_impl, new_in, want, &new_encoded));
+  ASSERT_TRUE(encoded[1].contents_equal(new_encoded[1]));
+
+  map<int, bufferlist> old_data, changed, parity;
+  for (int i : { 0, 2 }) {
+    old_data[i] = encoded[i];
+    changed[i] = new_encoded[i];
+  }
+  for (unsigned i = k; i < k + m; i++)
+    parity[i] = encoded[i];
+  ASSERT_EQ(0, ECUtil::encode_delta(sinfo, ec_impl, old_data, changed,
+				    &parity));
+  ASSERT_EQ(m, parity.size());
+  for (unsigned i = k; i < k + m; i++) {
+    ASSERT_TRUE(new_encoded[i].contents_equal(parity[i]));
+  }
+
+  // one coding chunk on its own
+  parity.clear();
+  parity[k + 1] = encoded[k + 1];
+  ASSERT_EQ(0, ECUtil::encode_delta(sinfo, ec_impl, old_data, changed,
+				    &parity));
+  ASSERT_TRUE(new_encoded[k + 1].contents_equal(parity[k + 1]));
+}
+
+class ECTransactionTestDpp : public DoutPrefixProvider {
+public:
+  string gen_prefix() const override { return "test "; }
+  CephContext *get_cct() const override { return g_ceph_context; }
+  unsigned get_subsys() const override { return ceph_subsys_osd; }
+};
+
+TEST(ECTransaction, plan_parity_delta)
+{
+  const unsigned k = 4;
+  const unsigned m = 2;
+  const uint64_t chunk_size = 4096;
+  const uint64_t stripe_width = k * chunk_size;
+  const uint64_t size = 4 * stripe_width;
+  ECUtil::stripe_info_t sinfo(k, stripe_width);
+  ECTransactionTestDpp dpp;
+  hobject_t oid(object_t("foo"), "", CEPH_NOSNAP, 0, 1, "");
+  hobject_t oid2(object_t("bar"), "", CEPH_NOSNAP, 0, 1, "");
+  auto get_hinfo = [&](const hobject_t &) {
+    ECUtil::HashInfoRef hinfo(new ECUtil::HashInfo(k + m));
+    hinfo->set_projected_total_logical_size(sinfo, size);
+    return hinfo;
+  };
+  auto plan_for = [&](std::function<void(PGTransaction*)> f) {
+    PGTransactionUPtr t(new PGTransaction);
+    f(t.get());
+    return ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp);
+  };
+  auto write = [](PGTransaction *t, const hobject_t &o,
+		  uint64_t off, uint64_t len) {
+    bufferlist bl;
+    bl.append_zero(len);
+    t->write(o, off, len, bl);
+  };
+
+  {
+    // inside one chunk
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, stripe_width + chunk_size + 10, 100);
+      });
+    ASSERT_TRUE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+    ASSERT_EQ(set<int>{1}, plan.delta_chunks[oid]);
+  }
+  {
+    // across two chunks of different stripes
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, stripe_width - 10, 20);
+      });
+    ASSERT_TRUE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+    ASSERT_EQ((set<int>{0, 3}), plan.delta_chunks[oid]);
+  }
+  {
+    // three of four chunks: the whole stripe is cheaper
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, 10, 2 * chunk_size);
+      });
+    ASSERT_FALSE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+    ASSERT_TRUE(plan.delta_chunks.empty());
+  }
+  {
+    // full stripe
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, stripe_width, stripe_width);
+      });
+    ASSERT_FALSE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+  }
+  {
+    // past the end
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, size + 10, 100);
+      });
+    ASSERT_FALSE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+  }
+  {
+    // with a truncate
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, 10, 100);
+	t->truncate(oid, size - stripe_width);
+      });
+    ASSERT_FALSE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+  }
+  {
+    // more than one object
+    auto plan = plan_for([&](PGTransaction *t) {
+	write(t, oid, 10, 100);
+	write(t, oid2, 10, 100);
+      });
+    ASSERT_FALSE(ECTransaction::plan_parity_delta(sinfo, k, m, plan, &dpp));
+  }
+}
@@ -1,6 +1,7 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 #include "gtest/gtest.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 #include "global/global_context.h"
 #include "global/global_init.h"
@@ -411,3 +412,171 @@ TEST_F(OSDMapTest, PrimaryAffinity) {
     osdmap.set_primary_affinity(1, 0x10000);
   }
 }
+
+TEST_F(OSDMapTest, MappingTable) {
+  set_up_map();
+
+  OSDMapMapping mapping;
+  auto check = [&]() {
+    for (auto& p : osdmap.get_pools()) {
+      for (ps_t ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	pg_t pgid(ps, p.first);
+	vector<int> up, acting, mup, macting;
+	int up_primary, acting_primary, mup_primary, macting_primary;
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+	ASSERT_TRUE(mapping.get(pgid, &mup, &mup_primary,
+				&macting, &macting_primary));
+	ASSERT_EQ(up, mup);
+	ASSERT_EQ(up_primary, mup_primary);
+	ASSERT_EQ(acting, macting);
+	ASSERT_EQ(acting_primary, macting_primary);
+      }
+    }
+  };
+  auto apply = [&](OSDMap::Incremental& inc) {
+    osdmap.apply_incremental(inc);
+    mapping.update(g_ceph_context, osdmap, inc, 2);
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+  };
+
+  mapping.update(g_ceph_context, osdmap, 4);
+  check();
+  uint64_t all = mapping.get_num_pgs();
+  ASSERT_EQ(all, mapping.get_num_mapped());
+  ASSERT_FALSE(mapping.get(pg_t(0, 1234), nullptr, nullptr, nullptr, nullptr));
+
+  // down: only the pgs mapped to osd.0
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[0] = CEPH_OSD_UP;
+    apply(inc);
+    check();
+    ASSERT_LT(0u, mapping.get_num_mapped());
+    ASSERT_GT(all, mapping.get_num_mapped());
+  }
+  // out: still only those
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[0] = CEPH_OSD_OUT;
+    apply(inc);
+    check();
+    ASSERT_GT(all, mapping.get_num_mapped());
+  }
+  // pg_temp, longer than the pool is wide
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pg_t(1, 0)] = {1, 2, 3, 4};
+    inc.new_primary_temp[pg_t(2, 0)] = 3;
+    apply(inc);
+    check();
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pg_temp[pg_t(1, 0)].clear();
+    inc.new_primary_temp[pg_t(2, 0)] = -1;
+    inc.new_state[4] = CEPH_OSD_UP;
+    apply(inc);
+    check();
+    ASSERT_GT(all, mapping.get_num_mapped());
+  }
+  // back in: anything may move
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[0] = CEPH_OSD_IN;
+    inc.new_state[0] = CEPH_OSD_UP;
+    inc.new_state[4] = CEPH_OSD_UP;
+    apply(inc);
+    check();
+    ASSERT_EQ(all, mapping.get_num_mapped());
+  }
+  // pool changes
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_pool_max = osdmap.get_pool_max();
+    pg_pool_t *p = inc.get_new_pool(0, osdmap.get_pg_pool(0));
+    p->set_pg_num(p->get_pg_num() * 2);
+    p->set_pgp_num(p->get_pgp_num() * 2);
+    apply(inc);
+    check();
+    ASSERT_GT(mapping.get_num_pgs(), all);
+  }
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.old_pools.insert(1);
+    apply(inc);
+    check();
+    ASSERT_FALSE(mapping.get(pg_t(0, 1), nullptr, nullptr, nullptr, nullptr));
+  }
+  // out of sequence: full rebuild
+  {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[2] = CEPH_OSD_UP;
+    osdmap.apply_incremental(inc);
+    OSDMap::Incremental inc2(osdmap.get_epoch() + 1);
+    inc2.new_state[2] = CEPH_OSD_UP;
+    apply(inc2);
+    check();
+    ASSERT_EQ(mapping.get_num_pgs(), mapping.get_num_mapped());
+  }
+}
+
+TEST_F(OSDMapTest, ShallowCopyShares) {
+  set_up_map();
+
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, 0));
+  vector<int> up;
+  int up_primary;
+  osdmap.pg_to_raw_up(pgid, &up, &up_primary);
+  ASSERT_LT(1u, up.size());
+
+  // a pg_temp change leaves crush, addrs and uuids alone
+  OSDMap next;
+  next.shallow_copy_from(osdmap);
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  vector<int> temp(up.rbegin(), up.rend());
+  inc.new_pg_temp[pgid] = temp;
+  ASSERT_EQ(0, next.apply_incremental(inc));
+  ASSERT_EQ(osdmap.crush, next.crush);
+  ASSERT_EQ(&osdmap.get_addr(0), &next.get_addr(0));
+  ASSERT_EQ(&osdmap.get_uuid(0), &next.get_uuid(0));
+
+  // ... and the previous map does not see the change
+  vector<int> acting;
+  next.pg_to_acting_osds(pgid, acting);
+  ASSERT_EQ(temp, acting);
+  osdmap.pg_to_acting_osds(pgid, acting);
+  ASSERT_EQ(up, acting);
+
+  // marking an osd down copies the addrs, but not the entries for the
+  // other osds
+  OSDMap last;
+  last.shallow_copy_from(next);
+  OSDMap::Incremental inc2(next.get_epoch() + 1);
+  inc2.fsid = next.get_fsid();
+  inc2.new_state[1] = CEPH_OSD_UP;
+  ASSERT_EQ(0, last.apply_incremental(inc2));
+  ASSERT_TRUE(next.is_up(1));
+  ASSERT_FALSE(last.is_up(1));
+  ASSERT_EQ(next.crush, last.crush);
+  ASSERT_EQ(&next.get_addr(0), &last.get_addr(0));
+
+  // a full decode replaces what it would otherwise overwrite
+  bufferlist bl;
+  osdmap.encode(bl, CEPH_FEATURES_SUPPORTED_DEFAULT | CEPH_FEATURE_RESERVED);
+  OSDMap::Incremental inc3(last.get_epoch() + 1);
+  inc3.fsid = last.get_fsid();
+  inc3.fullmap = bl;
+  OSDMap full;
+  full.shallow_copy_from(last);
+  ASSERT_EQ(0, full.apply_incremental(inc3));
+  ASSERT_NE(last.crush, full.crush);
+  ASSERT_FALSE(last.is_up(1));
+  last.pg_to_acting_osds(pgid, acting);
+  ASSERT_EQ(temp, acting);
+
+  // dedup shares it all again
+  OSDMap::dedup(&last, &full);
+  ASSERT_EQ(last.crush, full.crush);
+}
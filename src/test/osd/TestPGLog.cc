@@ -2071,7 +2071,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.get(oid);
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2085,7 +2085,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.get(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2098,7 +2098,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.get(oid);
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2106,6 +2106,52 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   EXPECT_EQ(del.reqid, entry->reqid);
 }
 
+TEST_F(PGLogTest, index_follows_newest_entry) {
+  clear();
+
+  hobject_t oid(object_t("objname"), "key", 123, 456, 0, "");
+  osd_reqid_t reqid(entity_name_t::CLIENT(777), 8, 1);
+  size_t before = mempool::osd_pglog::allocated_items();
+
+  // a resent op is logged twice under the same reqid
+  log.add(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(6,2),
+		   eversion_t(3,4), 1, reqid, utime_t(0,1), 0));
+  log.add(
+    pg_log_entry_t(pg_log_entry_t::MODIFY, oid, eversion_t(6,3),
+		   eversion_t(6,2), 2, reqid, utime_t(1,2), 0));
+  EXPECT_LT(before, mempool::osd_pglog::allocated_items());
+
+  ASSERT_EQ(1U, log.objects.size());
+  ASSERT_EQ(1U, log.caller_ops.size());
+  EXPECT_EQ(&log.log.back(), log.objects.get(oid));
+  EXPECT_EQ(&log.log.back(), log.caller_ops.get(reqid));
+
+  // trimming the older entry must leave both indexes intact
+  log.skip_can_rollback_to_to_head();
+  log.trim(g_ceph_context, eversion_t(6,2), nullptr);
+  ASSERT_EQ(1U, log.log.size());
+  EXPECT_TRUE(log.logged_object(oid));
+  EXPECT_TRUE(log.logged_req(reqid));
+  // lookups by a copy of the key
+  hobject_t copy = oid;
+  EXPECT_EQ(eversion_t(6,3), log.objects.get(copy)->version);
+
+  eversion_t replay_version;
+  version_t user_version;
+  int return_code = 0;
+  EXPECT_TRUE(log.get_request(
+    reqid, &replay_version, &user_version, &return_code));
+  EXPECT_EQ(eversion_t(6,3), replay_version);
+  EXPECT_EQ(2U, user_version);
+
+  log.skip_can_rollback_to_to_head();
+  log.trim(g_ceph_context, eversion_t(6,3), nullptr);
+  EXPECT_FALSE(log.logged_object(oid));
+  EXPECT_FALSE(log.logged_req(reqid));
+  EXPECT_TRUE(log.objects.empty());
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
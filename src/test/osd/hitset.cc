@@ -122,6 +122,106 @@ TEST_F(BloomHitSetTest, RejectsNoMatch) {
   EXPECT_LT(matches, 2);
 }
 
+class BlockedBloomHitSetTest : public testing::Test, public HitSetTestStrap {
+public:
+
+  BlockedBloomHitSetTest() : HitSetTestStrap(new HitSet(new BlockedBloomHitSet)) {}
+
+  void rebuild(double fp, uint64_t target, uint64_t seed) {
+    BloomHitSet::Params *bparams =
+      new BloomHitSet::Params(fp, target, seed, true);
+    HitSet::Params param(bparams);
+    HitSet new_set(param);
+    *hitset = new_set;
+  }
+};
+
+TEST_F(BlockedBloomHitSetTest, Params) {
+  BloomHitSet::Params *bparams = new BloomHitSet::Params(0.01, 100, 5, true);
+  HitSet::Params params(bparams);
+  EXPECT_EQ(HitSet::TYPE_BLOCKED_BLOOM, params.get_type());
+
+  // goes out as bloom params, so older OSDs can decode the pool
+  bufferlist bl;
+  ::encode(params, bl);
+  bufferlist::iterator iter = bl.begin();
+  iter.advance(6);  // ENCODE_START header
+  __u8 type;
+  ::decode(type, iter);
+  EXPECT_EQ(HitSet::TYPE_BLOOM, type);
+
+  HitSet::Params p2;
+  iter = bl.begin();
+  ::decode(p2, iter);
+  EXPECT_EQ(HitSet::TYPE_BLOCKED_BLOOM, p2.get_type());
+  BloomHitSet::Params *bp2 = static_cast<BloomHitSet::Params*>(p2.impl.get());
+  EXPECT_EQ(.01, bp2->get_fpp());
+  EXPECT_EQ((unsigned)100, bp2->target_size);
+  EXPECT_EQ((unsigned)5, bp2->seed);
+
+  // a copy keeps the flag
+  HitSet::Params p3(p2);
+  EXPECT_EQ(HitSet::TYPE_BLOCKED_BLOOM, p3.get_type());
+}
+
+TEST_F(BlockedBloomHitSetTest, Construct) {
+  ASSERT_EQ(hitset->impl->get_type(), HitSet::TYPE_BLOCKED_BLOOM);
+  rebuild(0.1, 100, 1);
+  ASSERT_EQ(hitset->impl->get_type(), HitSet::TYPE_BLOCKED_BLOOM);
+}
+
+TEST_F(BlockedBloomHitSetTest, InsertsMatch) {
+  rebuild(0.1, 100, 1);
+  fill(50);
+  EXPECT_TRUE(hitset->approx_unique_insert_count() >= 45 &&
+	      hitset->approx_unique_insert_count() <= 50);
+  verify_fill(50);
+  EXPECT_FALSE(hitset->is_full());
+}
+
+TEST_F(BlockedBloomHitSetTest, FillsUp) {
+  rebuild(0.1, 20, 1);
+  fill(20);
+  verify_fill(20);
+  EXPECT_TRUE(hitset->is_full());
+}
+
+TEST_F(BlockedBloomHitSetTest, RejectsNoMatch) {
+  rebuild(0.001, 100, 1);
+  fill(100);
+  verify_fill(100);
+  EXPECT_TRUE(hitset->is_full());
+
+  char buf[50];
+  int matches = 0;
+  for (int i = 100; i < 200; ++i) {
+    sprintf(buf, "hitsettest_%d", i);
+    hobject_t obj(object_t(buf), "", 0, i, 0, "");
+    if (hitset->contains(obj))
+      ++matches;
+  }
+  // we set a 1 in 1000 false positive; allow one in our 100
+  EXPECT_LT(matches, 2);
+}
+
+TEST_F(BlockedBloomHitSetTest, EncodeDecode) {
+  rebuild(0.01, 100, 1);
+  fill(50);
+  hitset->seal();
+
+  bufferlist bl;
+  ::encode(*hitset, bl);
+  HitSet h2;
+  bufferlist::iterator iter = bl.begin();
+  ::decode(h2, iter);
+  ASSERT_EQ(HitSet::TYPE_BLOCKED_BLOOM, h2.impl->get_type());
+  EXPECT_EQ(50u, h2.insert_count());
+  HitSet *orig = hitset;
+  hitset = &h2;
+  verify_fill(50);
+  hitset = orig;
+}
+
 class ExplicitHashHitSetTest : public testing::Test, public HitSetTestStrap {
 public:
 
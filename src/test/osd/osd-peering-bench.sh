@@ -0,0 +1,70 @@
+#!/bin/bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+# Time how long the PGs of a local cluster take to get back to
+# active+clean after an OSD is marked down, once per setting of
+# osd_peering_wq_max_events_per_pg.  This is a benchmark, not a test:
+# it is not run by make check.
+#
+#   PGS=1024 OSDS=4 ROUNDS=3 test/osd/osd-peering-bench.sh
+#
+
+source $(dirname $0)/../detect-build-env-vars.sh
+source $CEPH_ROOT/qa/workunits/ceph-helpers.sh
+
+: ${PGS:=256}
+: ${OSDS:=4}
+: ${ROUNDS:=3}
+: ${EVENTS_PER_PG:="1 10"}
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7127" # git grep '\<7127\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+
+    setup $dir || return 1
+    run_mon $dir a --osd_pool_default_size=3 || return 1
+    for id in $(seq 0 $(($OSDS - 1))) ; do
+        run_osd $dir $id || return 1
+    done
+    ceph osd pool create bench $PGS $PGS || return 1
+    wait_for_clean || return 1
+
+    local events
+    for events in $EVENTS_PER_PG ; do
+        ceph tell osd.* injectargs \
+            "--osd_peering_wq_max_events_per_pg $events" || return 1
+        local round
+        for round in $(seq $ROUNDS) ; do
+            local victim=$(($round % $OSDS))
+            local start=$(date +%s.%N)
+            ceph osd down $victim || return 1
+            wait_for_osd up $victim || return 1
+            wait_for_clean || return 1
+            local end=$(date +%s.%N)
+            echo "events_per_pg $events round $round:" \
+                "$(echo "$end - $start" | bc) seconds to clean"
+        done
+    done
+
+    teardown $dir || return 1
+}
+
+main osd-peering-bench "$@"
+
+# Local Variables:
+# compile-command: "cd ../.. ; make -j4 && test/osd/osd-peering-bench.sh"
+# End:
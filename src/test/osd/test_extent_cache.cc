@@ -278,3 +278,89 @@ TEST(extentcache, write_write_overlap2)
 
   c.release_write_pin(pin3);
 }
+
+TEST(extentcache, lru_write_write)
+{
+  hobject_t oid;
+
+  ExtentCache c;
+  ExtentCache::write_pin pin;
+  c.open_write_pin(pin);
+
+  // write 1 reads and writes 0~8
+  auto to_read = iset_from_vector({{0, 8}});
+  auto to_write = iset_from_vector({{0, 8}});
+  auto must_read = c.reserve_extents_for_rmw(
+    oid, pin, to_write, to_read);
+  ASSERT_EQ(must_read, to_read);
+  c.present_rmw_update(oid, pin, imap_from_iset(to_write));
+  c.release_write_pin_to_lru(pin, 1024);
+  ASSERT_EQ(8u, c.get_cached_bytes());
+
+  c.print(std::cerr);
+
+  // write 2 finds 0~8 cached and only reads 8~8
+  ExtentCache::write_pin pin2;
+  c.open_write_pin(pin2);
+  auto to_read2 = iset_from_vector({{4, 12}});
+  auto to_write2 = iset_from_vector({{4, 12}});
+  auto must_read2 = c.reserve_extents_for_rmw(
+    oid, pin2, to_write2, to_read2);
+  ASSERT_EQ(must_read2, iset_from_vector({{8, 8}}));
+  // 0~4 is still cached, 4~4 moved to pin2
+  ASSERT_EQ(4u, c.get_cached_bytes());
+
+  auto pending_read2 = to_read2;
+  pending_read2.subtract(must_read2);
+  auto pending2 = c.get_remaining_extents_for_rmw(
+    oid, pin2, pending_read2);
+  ASSERT_EQ(pending2, imap_from_iset(pending_read2));
+  c.present_rmw_update(oid, pin2, imap_from_iset(to_write2));
+  c.release_write_pin_to_lru(pin2, 1024);
+  ASSERT_EQ(16u, c.get_cached_bytes());
+
+  c.print(std::cerr);
+
+  c.drop_unpinned();
+  ASSERT_EQ(0u, c.get_cached_bytes());
+}
+
+TEST(extentcache, lru_evict)
+{
+  hobject_t oid1, oid2;
+  oid2.pool = 1;
+
+  ExtentCache c;
+  for (auto &&oid: {oid1, oid2}) {
+    ExtentCache::write_pin pin;
+    c.open_write_pin(pin);
+    auto to_write = iset_from_vector({{0, 8}, {16, 8}});
+    c.reserve_extents_for_rmw(oid, pin, to_write, extent_set());
+    c.present_rmw_update(oid, pin, imap_from_iset(to_write));
+    c.release_write_pin_to_lru(pin, 24);
+  }
+  // the first extent of oid1 went
+  ASSERT_EQ(24u, c.get_cached_bytes());
+
+  ExtentCache::write_pin pin;
+  c.open_write_pin(pin);
+  auto to_read = iset_from_vector({{0, 24}});
+  ASSERT_EQ(
+    c.reserve_extents_for_rmw(oid1, pin, to_read, to_read),
+    iset_from_vector({{0, 16}}));
+  c.release_write_pin(pin);
+
+  // what pin took has been dropped along with it
+  ASSERT_EQ(16u, c.get_cached_bytes());
+  c.drop_unpinned(oid2);
+  ASSERT_EQ(0u, c.get_cached_bytes());
+
+  // not caching at all
+  ExtentCache::write_pin pin2;
+  c.open_write_pin(pin2);
+  auto to_write2 = iset_from_vector({{0, 8}});
+  c.reserve_extents_for_rmw(oid1, pin2, to_write2, extent_set());
+  c.present_rmw_update(oid1, pin2, imap_from_iset(to_write2));
+  c.release_write_pin_to_lru(pin2, 0);
+  ASSERT_EQ(0u, c.get_cached_bytes());
+}
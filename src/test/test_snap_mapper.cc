@@ -364,6 +364,32 @@ public:
       cur = next.first;
     }
   }
+  void get_next_n() {
+    string cur;
+    unsigned max = 1 + rand() % 10;
+    while (true) {
+      vector<pair<string, bufferlist> > next;
+      int r = cache->get_next_n(cur, max, &next);
+
+      vector<pair<string, bufferlist> > next_truth;
+      for (map<string, bufferlist>::iterator i = truth.upper_bound(cur);
+	   i != truth.end() && next_truth.size() < max;
+	   ++i)
+	next_truth.push_back(*i);
+      int r_truth = next_truth.empty() ? -ENOENT : 0;
+
+      ASSERT_EQ(r, r_truth);
+      if (r == -ENOENT)
+	break;
+
+      ASSERT_EQ(next.size(), next_truth.size());
+      for (unsigned i = 0; i < next.size(); ++i) {
+	ASSERT_EQ(next[i].first, next_truth[i].first);
+	assert_bl_eq(next[i].second, next_truth[i].second);
+      }
+      cur = next.back().first;
+    }
+  }
   virtual void SetUp() {
     driver.reset(new PausyAsyncMap());
     cache.reset(new MapCacher::MapCacher<string, bufferlist>(driver.get()));
@@ -412,13 +438,53 @@ TEST_F(MapCacherTest, Simple)
   assert_bl_map_eq(got, truth);
 }
 
+TEST_F(MapCacherTest, GetNextNPending)
+{
+  // removals still in flight must not make get_next_n come up short
+  map<string, bufferlist> keys;
+  bufferlist bl;
+  ::encode(string("v"), bl);
+  for (char c = 'a'; c <= 'h'; ++c)
+    keys[string(1, c)] = bl;
+  {
+    PausyAsyncMap::Transaction t;
+    cache->set_keys(keys, &t);
+    driver->submit(&t);
+  }
+  sleep(1); // let the keys reach the store
+  driver->pause();
+  {
+    PausyAsyncMap::Transaction t;
+    set<string> to_remove;
+    to_remove.insert("b");
+    to_remove.insert("c");
+    to_remove.insert("d");
+    cache->remove_keys(to_remove, &t);
+    driver->submit(&t);
+  }
+
+  vector<pair<string, bufferlist> > got;
+  ASSERT_EQ(0, cache->get_next_n(string(), 3, &got));
+  ASSERT_EQ(3u, got.size());
+  ASSERT_EQ("a", got[0].first);
+  ASSERT_EQ("e", got[1].first);
+  ASSERT_EQ("f", got[2].first);
+
+  got.clear();
+  ASSERT_EQ(0, cache->get_next_n("f", 3, &got));
+  ASSERT_EQ(2u, got.size());
+  ASSERT_EQ(-ENOENT, cache->get_next_n("h", 3, &got));
+
+  driver->resume();
+}
+
 TEST_F(MapCacherTest, Random)
 {
   for (size_t i = 0; i < 5000; ++i) {
     if (!(i % 50)) {
       std::cout << "On iteration " << i << std::endl;
     }
-    switch (rand() % 4) {
+    switch (rand() % 5) {
     case 0:
       get();
       break;
@@ -431,6 +497,9 @@ TEST_F(MapCacherTest, Random)
     case 3:
       remove();
       break;
+    case 4:
+      get_next_n();
+      break;
     }
   }
 }
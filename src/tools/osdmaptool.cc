@@ -20,6 +20,7 @@
 
 #include "global/global_init.h"
 #include "osd/OSDMap.h"
+#include "osd/OSDMapMapping.h"
 
 using namespace std;
 
@@ -36,6 +37,9 @@ void usage()
   cout << "   --test-map-pg <pgid>    map a pgid to osds" << std::endl;
   cout << "   --test-map-object <objectname> [--pool <poolid>] map an object to osds"
        << std::endl;
+  cout << "   --test-mapping-bench [--mapping-threads <n>]" << std::endl
+       << "                           time building the pg mapping table, lookups," << std::endl
+       << "                           and updating it for an osd going down" << std::endl;
   exit(1);
 }
 
@@ -74,6 +78,8 @@ int main(int argc, const char **argv)
   bool test_map_pgs = false;
   bool test_map_pgs_dump = false;
   bool test_random = false;
+  bool test_mapping_bench = false;
+  int mapping_threads = 4;
   int64_t pg_num = -1;
 
   std::string val;
@@ -113,6 +119,13 @@ int main(int argc, const char **argv)
       test_map_pgs_dump = true;
     } else if (ceph_argparse_flag(args, i, "--test-random", (char*)NULL)) {
       test_random = true;
+    } else if (ceph_argparse_flag(args, i, "--test-mapping-bench", (char*)NULL)) {
+      test_mapping_bench = true;
+    } else if (ceph_argparse_witharg(args, i, &mapping_threads, err, "--mapping-threads", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << err.str() << std::endl;
+	exit(EXIT_FAILURE);
+      }
     } else if (ceph_argparse_flag(args, i, "--clobber", (char*)NULL)) {
       clobber = true;
     } else if (ceph_argparse_witharg(args, i, &pg_bits, err, "--pg_bits", (char*)NULL)) {
@@ -437,6 +450,78 @@ int main(int argc, const char **argv)
       cout << "size " << i << "\t" << size[i] << std::endl;
     }
   }
+  if (test_mapping_bench) {
+    OSDMapMapping mapping;
+    set<int> thread_counts = {1, mapping_threads};
+    for (int threads : thread_counts) {
+      utime_t start = ceph_clock_now();
+      mapping.update(g_ceph_context, osdmap, threads);
+      utime_t dur = ceph_clock_now() - start;
+      cout << "build " << mapping.get_num_pgs() << " pgs, " << threads
+	   << " threads: " << dur << " s" << std::endl;
+    }
+
+    vector<pg_t> pgs;
+    for (auto& p : osdmap.get_pools())
+      for (ps_t ps = 0; ps < p.second.get_pg_num(); ++ps)
+	pgs.push_back(pg_t(ps, p.first));
+    vector<int> up, acting;
+    int up_primary, acting_primary;
+    const int rounds = 10;
+    utime_t start = ceph_clock_now();
+    for (int r = 0; r < rounds; ++r)
+      for (auto& pgid : pgs)
+	osdmap.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				    &acting, &acting_primary);
+    utime_t crush_dur = ceph_clock_now() - start;
+    start = ceph_clock_now();
+    for (int r = 0; r < rounds; ++r)
+      for (auto& pgid : pgs)
+	mapping.get(pgid, &up, &up_primary, &acting, &acting_primary);
+    utime_t table_dur = ceph_clock_now() - start;
+    double n = (double)pgs.size() * rounds;
+    if (n > 0)
+      cout << "lookup: pg_to_up_acting_osds "
+	   << (double)crush_dur * 1000000000.0 / n << " ns, table "
+	   << (double)table_dur * 1000000000.0 / n << " ns" << std::endl;
+
+    // take the first up osd down and update the table for it
+    int victim = -1;
+    for (int o = 0; o < osdmap.get_max_osd() && victim < 0; ++o)
+      if (osdmap.is_up(o))
+	victim = o;
+    if (victim >= 0) {
+      OSDMap next;
+      next.deepish_copy_from(osdmap);
+      OSDMap::Incremental inc(next.get_epoch() + 1);
+      inc.fsid = next.get_fsid();
+      inc.new_state[victim] = CEPH_OSD_UP;
+      next.apply_incremental(inc);
+      start = ceph_clock_now();
+      mapping.update(g_ceph_context, next, inc, mapping_threads);
+      utime_t dur = ceph_clock_now() - start;
+      cout << "osd." << victim << " down: remapped "
+	   << mapping.get_num_mapped() << " of " << mapping.get_num_pgs()
+	   << " pgs in " << dur << " s" << std::endl;
+
+      unsigned wrong = 0;
+      for (auto& pgid : pgs) {
+	vector<int> mup, macting;
+	int mup_primary, macting_primary;
+	next.pg_to_up_acting_osds(pgid, &up, &up_primary,
+				  &acting, &acting_primary);
+	mapping.get(pgid, &mup, &mup_primary, &macting, &macting_primary);
+	if (up != mup || acting != macting ||
+	    up_primary != mup_primary || acting_primary != macting_primary)
+	  ++wrong;
+      }
+      if (wrong) {
+	cerr << me << ": " << wrong << " pgs mapped differently by the table"
+	     << std::endl;
+	exit(1);
+      }
+    }
+  }
   if (test_crush) {
     int pass = 0;
     while (1) {
@@ -471,7 +556,7 @@ int main(int argc, const char **argv)
   if (!print && !tree && !modified &&
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
-      !test_map_pgs && !test_map_pgs_dump) {
+      !test_map_pgs && !test_map_pgs_dump && !test_mapping_bench) {
     cerr << me << ": no action specified?" << std::endl;
     usage();
   }